@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#include <common.h>
+#include <crc.h>
+#include <asm/unaligned.h>
+
+/*
+ * CRC32 using the ARMv8 CRC32 instructions, which are optional in
+ * ARMv8.0 and mandatory from ARMv8.1 on. They implement the same reflected
+ * polynomial as crc32_no_comp().
+ */
+
+static int crc32_insn = -1;
+
+bool arch_crc32_le_supported(void)
+{
+	u64 isar0;
+
+	if (crc32_insn < 0) {
+		asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+		crc32_insn = ((isar0 >> 16) & 0xf) != 0;
+	}
+
+	return crc32_insn;
+}
+
+uint32_t arch_crc32_le(uint32_t crc, const void *_buf, unsigned int len)
+{
+	const u8 *buf = _buf;
+	u64 x;
+	u32 w;
+	u16 h;
+	u8 b;
+
+	while (len >= 8) {
+		x = get_unaligned_le64(buf);
+		asm(".arch_extension crc\n\tcrc32x %w0, %w0, %x1"
+		    : "+r" (crc) : "r" (x));
+		buf += 8;
+		len -= 8;
+	}
+
+	if (len & 4) {
+		w = get_unaligned_le32(buf);
+		asm(".arch_extension crc\n\tcrc32w %w0, %w0, %w1"
+		    : "+r" (crc) : "r" (w));
+		buf += 4;
+	}
+
+	if (len & 2) {
+		h = get_unaligned_le16(buf);
+		asm(".arch_extension crc\n\tcrc32h %w0, %w0, %w1"
+		    : "+r" (crc) : "r" (h));
+		buf += 2;
+	}
+
+	if (len & 1) {
+		b = *buf;
+		asm(".arch_extension crc\n\tcrc32b %w0, %w0, %w1"
+		    : "+r" (crc) : "r" (b));
+	}
+
+	return crc;
+}
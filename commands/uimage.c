@@ -58,7 +58,12 @@ static int do_uimage(int argc, char *argv[])
 		uimage_print_contents(handle);
 	}
 
-	if (verify) {
+	if (verify && extract) {
+		/* check the crc while extracting instead of reading twice */
+		ret = uimage_verify_on_load(handle);
+		if (ret)
+			goto err;
+	} else if (verify) {
 		printf("verifying data CRC... ");
 		ret = uimage_verify(handle);
 		if (ret)
@@ -78,6 +83,8 @@ static int do_uimage(int argc, char *argv[])
 		if (ret) {
 			printf("loading uImage failed with %d\n", ret);
 			close(fd);
+			/* don't leave a truncated or corrupt image behind */
+			unlink(extract);
 			goto err;
 		}
 
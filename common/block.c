@@ -9,7 +9,12 @@
 #include <malloc.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/sizes.h>
+#include <linux/log2.h>
 #include <dma.h>
+#include <param.h>
+#include <sched.h>
 
 #define BLOCKSIZE(blk)	(1 << blk->blockbits)
 
@@ -22,9 +27,22 @@ struct chunk {
 	int dirty; /* need to write back to device */
 	int num; /* number of chunk, debugging only */
 	struct list_head list;
+	struct rb_node node; /* in blk->chunk_tree while buffered */
 };
 
 #define BUFSIZE (PAGE_SIZE * 16)
+#define BUFNUM 8
+#define RANUM (BUFNUM / 2)
+
+/*
+ * Reads spanning at least one full chunk bypass the cache and go straight
+ * into the caller's buffer. They are still split into requests of at most
+ * this size, as not all drivers cope with arbitrarily large transfers.
+ */
+#define DIRECT_IO_MAXSIZE SZ_4M
+
+/* number of direct requests kept in flight on drivers supporting it */
+#define DIRECT_IO_INFLIGHT 4
 
 static int writebuffer_io_len(struct block_device *blk, struct chunk *chunk)
 {
@@ -60,6 +78,48 @@ static int writebuffer_flush(struct block_device *blk)
 	return 0;
 }
 
+/*
+ * Buffered chunks are indexed by their first block in blk->chunk_tree.
+ * Chunks always start at a multiple of the chunk size, so a lookup is an
+ * exact match on the block number with the chunk offset masked out.
+ */
+static void chunk_tree_insert(struct block_device *blk, struct chunk *chunk)
+{
+	struct rb_node **p = &blk->chunk_tree.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		struct chunk *c = rb_entry(*p, struct chunk, node);
+
+		parent = *p;
+		if (chunk->block_start < c->block_start)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&chunk->node, parent, p);
+	rb_insert_color(&chunk->node, &blk->chunk_tree);
+}
+
+static struct chunk *chunk_tree_find(struct block_device *blk, sector_t block_start)
+{
+	struct rb_node *n = blk->chunk_tree.rb_node;
+
+	while (n) {
+		struct chunk *c = rb_entry(n, struct chunk, node);
+
+		if (block_start < c->block_start)
+			n = n->rb_left;
+		else if (block_start > c->block_start)
+			n = n->rb_right;
+		else
+			return c;
+	}
+
+	return NULL;
+}
+
 /*
  * get the chunk containing a given block. Will return NULL if the
  * block is not cached, the chunk otherwise.
@@ -68,20 +128,18 @@ static struct chunk *chunk_get_cached(struct block_device *blk, sector_t block)
 {
 	struct chunk *chunk;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
-			dev_dbg(blk->dev, "%s: found %llu in %d\n", __func__,
-				block, chunk->num);
-			/*
-			 * move most recently used entry to the head of the list
-			 */
-			list_move(&chunk->list, &blk->buffered_blocks);
-			return chunk;
-		}
-	}
+	chunk = chunk_tree_find(blk, block & ~(sector_t)blk->blkmask);
+	if (!chunk)
+		return NULL;
 
-	return NULL;
+	dev_dbg(blk->dev, "%s: found %llu in %d\n", __func__,
+		block, chunk->num);
+	/*
+	 * move most recently used entry to the head of the list
+	 */
+	list_move(&chunk->list, &blk->buffered_blocks);
+
+	return chunk;
 }
 
 /*
@@ -121,6 +179,7 @@ static struct chunk *get_chunk(struct block_device *blk)
 
 			chunk->dirty = 0;
 		}
+		rb_erase(&chunk->node, &blk->chunk_tree);
 	} else {
 		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
 	}
@@ -130,14 +189,111 @@ static struct chunk *get_chunk(struct block_device *blk)
 	return chunk;
 }
 
+/*
+ * Sequential stream detection. A cache miss on the chunk directly following
+ * the last one read from the device doubles the readahead window, any other
+ * miss resets it. Returns the number of chunks to read in addition to the
+ * one starting at @start. Readahead stops at the end of the device, at the
+ * first chunk that is already cached and at the discarded range.
+ */
+static unsigned int block_readahead_max(struct block_device *blk)
+{
+	return min(blk->cache_readahead, blk->cache_chunks - 1);
+}
+
+static unsigned int block_readahead_chunks(struct block_device *blk,
+					   sector_t start)
+{
+	unsigned int max = block_readahead_max(blk);
+	unsigned int i;
+
+	if (start != blk->ra_next || !max) {
+		blk->ra_window = 0;
+		return 0;
+	}
+
+	blk->ra_window = clamp(blk->ra_window * 2, 1U, max);
+
+	for (i = 1; i <= blk->ra_window; i++) {
+		sector_t b = start + i * blk->rdbufsize;
+		loff_t pos = (loff_t)b << blk->blockbits;
+
+		if (b >= blk->num_blocks || chunk_tree_find(blk, b))
+			break;
+
+		if (blk->discard_size &&
+		    pos + blk->cache_chunk_size > blk->discard_start &&
+		    pos < blk->discard_start + blk->discard_size)
+			break;
+	}
+
+	return i - 1;
+}
+
+/*
+ * Read @first and the @num chunks following it with a single request into
+ * the readahead buffer and distribute the data to the cache. The prefetched
+ * chunks are queued behind @first in LRU order. Returns the number of
+ * chunks prefetched, which is less than @num when no more chunks could be
+ * freed up, or a negative error code if nothing has been read.
+ */
+static int block_cache_readahead(struct block_device *blk, struct chunk *first,
+				 unsigned int num)
+{
+	struct list_head *prev = &blk->buffered_blocks;
+	sector_t start = first->block_start;
+	blkcnt_t count;
+	int ret, i;
+
+	if (!blk->ra_buf) {
+		blk->ra_buf = dma_alloc((size_t)(block_readahead_max(blk) + 1) *
+					blk->cache_chunk_size);
+		if (!blk->ra_buf)
+			return -ENOMEM;
+	}
+
+	count = min_t(blkcnt_t, (blkcnt_t)(num + 1) * blk->rdbufsize,
+		      blk->num_blocks - start);
+
+	dev_dbg(blk->dev, "%s: %llu blocks at %llu\n", __func__, count, start);
+
+	ret = blk->ops->read(blk, blk->ra_buf, start, count);
+	if (ret)
+		return ret;
+
+	memcpy(first->data, blk->ra_buf,
+	       writebuffer_io_len(blk, first) << blk->blockbits);
+
+	for (i = 1; i <= num; i++) {
+		struct chunk *chunk = get_chunk(blk);
+
+		if (IS_ERR(chunk)) {
+			dev_warn(blk->dev, "readahead stopped: %pe\n", chunk);
+			break;
+		}
+
+		chunk->block_start = start + i * blk->rdbufsize;
+		memcpy(chunk->data, blk->ra_buf + i * blk->cache_chunk_size,
+		       writebuffer_io_len(blk, chunk) << blk->blockbits);
+		list_add(&chunk->list, prev);
+		chunk_tree_insert(blk, chunk);
+		prev = &chunk->list;
+	}
+
+	return i - 1;
+}
+
 /*
  * read a block into the cache. This assumes that the block is
  * not cached already. By definition block_get_cached() for
- * the same block will succeed after this call.
+ * the same block will succeed after this call. Sequential reads
+ * also prefetch the following chunks if @readahead is set.
  */
-static int block_cache(struct block_device *blk, sector_t block)
+static int block_cache(struct block_device *blk, sector_t block,
+		       bool readahead)
 {
 	struct chunk *chunk;
+	unsigned int ra;
 	int ret;
 
 	chunk = get_chunk(blk);
@@ -154,25 +310,42 @@ static int block_cache(struct block_device *blk, sector_t block)
 	    <= blk->discard_start + blk->discard_size) {
 		memset(chunk->data, 0, writebuffer_io_len(blk, chunk));
 		list_add(&chunk->list, &blk->buffered_blocks);
+		chunk_tree_insert(blk, chunk);
 		return 0;
 	}
 
-	ret = blk->ops->read(blk, chunk->data, chunk->block_start,
-			     writebuffer_io_len(blk, chunk));
-	if (ret) {
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-		return ret;
+	ra = readahead ? block_readahead_chunks(blk, chunk->block_start) : 0;
+	if (ra)
+		ret = block_cache_readahead(blk, chunk, ra);
+
+	/* on failure fall back to a plain read of the requested chunk */
+	if (ra && ret >= 0) {
+		blk->ra_next = chunk->block_start + (ret + 1) * blk->rdbufsize;
+	} else {
+		ret = blk->ops->read(blk, chunk->data, chunk->block_start,
+				     writebuffer_io_len(blk, chunk));
+		if (ret) {
+			blk->ra_window = 0;
+			list_add_tail(&chunk->list, &blk->idle_blocks);
+			return ret;
+		}
+
+		blk->ra_next = chunk->block_start + blk->rdbufsize;
 	}
+
 	list_add(&chunk->list, &blk->buffered_blocks);
+	chunk_tree_insert(blk, chunk);
 
 	return 0;
 }
 
 /*
  * Get the data for a block, either from the cache or from
- * the device.
+ * the device. Only reads should set @readahead, writes
+ * would prefetch data they overwrite anyway.
  */
-static void *block_get(struct block_device *blk, sector_t block)
+static void *block_get(struct block_device *blk, sector_t block,
+		       bool readahead)
 {
 	void *outdata;
 	int ret;
@@ -184,7 +357,7 @@ static void *block_get(struct block_device *blk, sector_t block)
 	if (outdata)
 		return outdata;
 
-	ret = block_cache(blk, block);
+	ret = block_cache(blk, block, readahead);
 	if (ret)
 		return ERR_PTR(ret);
 
@@ -195,6 +368,107 @@ static void *block_get(struct block_device *blk, sector_t block)
 	return outdata;
 }
 
+/*
+ * Check if a read of @num_blocks blocks starting at @block into @buf can
+ * bypass the cache. This is the case for reads that span at least one full
+ * chunk into a buffer suitable for DMA and which do not touch the currently
+ * discarded range, which would have to read back as zeroes.
+ */
+static bool block_can_read_direct(struct block_device *blk, const void *buf,
+				  sector_t block, blkcnt_t num_blocks)
+{
+	loff_t start = (loff_t)block << blk->blockbits;
+	loff_t end = (loff_t)(block + num_blocks) << blk->blockbits;
+
+	if (num_blocks < blk->rdbufsize)
+		return false;
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT))
+		return false;
+
+	if (block + num_blocks > blk->num_blocks)
+		return false;
+
+	if (blk->discard_size && start < blk->discard_start + blk->discard_size &&
+	    end > blk->discard_start)
+		return false;
+
+	return true;
+}
+
+/*
+ * Read blocks directly into @buf, bypassing the cache. Dirty chunks which
+ * overlap the range contain newer data than the device, so they are copied
+ * over the freshly read data afterwards.
+ */
+static int block_read_direct(struct block_device *blk, void *buf,
+			     sector_t block, blkcnt_t num_blocks)
+{
+	struct block_request reqs[DIRECT_IO_INFLIGHT] = {};
+	blkcnt_t max = DIRECT_IO_MAXSIZE >> blk->blockbits;
+	struct chunk *chunk;
+	blkcnt_t done = 0;
+	int i, n = 0, ret = 0;
+
+	dev_dbg(blk->dev, "%s: %llu blocks at %llu\n", __func__,
+		num_blocks, block);
+
+	while (done < num_blocks && !ret) {
+		struct block_request *req = &reqs[n++ % DIRECT_IO_INFLIGHT];
+		blkcnt_t now = min(num_blocks - done, max);
+
+		if (req->blk) {
+			ret = block_wait(req);
+			if (ret)
+				break;
+		}
+
+		req->buf = buf + (done << blk->blockbits);
+		req->block = block + done;
+		req->num_blocks = now;
+
+		ret = block_submit(blk, req);
+		/* synchronous devices have completed the request already */
+		if (!ret && req->status != -EINPROGRESS)
+			ret = req->status;
+
+		done += now;
+	}
+
+	for (i = 0; i < DIRECT_IO_INFLIGHT; i++) {
+		int err;
+
+		if (!reqs[i].blk)
+			continue;
+
+		err = block_wait(&reqs[i]);
+		if (!ret)
+			ret = err;
+	}
+
+	if (ret)
+		return ret;
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		sector_t start, end;
+
+		if (!chunk->dirty)
+			continue;
+
+		start = max(chunk->block_start, block);
+		end = min(chunk->block_start + writebuffer_io_len(blk, chunk),
+			  block + num_blocks);
+		if (start >= end)
+			continue;
+
+		memcpy(buf + ((start - block) << blk->blockbits),
+		       chunk->data + ((start - chunk->block_start) << blk->blockbits),
+		       (end - start) << blk->blockbits);
+	}
+
+	return 0;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -206,7 +480,7 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, true);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -221,8 +495,20 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 	blocks = count >> blk->blockbits;
 
+	if (block_can_read_direct(blk, buf, block, blocks)) {
+		int ret = block_read_direct(blk, buf, block, blocks);
+
+		if (ret)
+			return ret;
+
+		buf += blocks << blk->blockbits;
+		block += blocks;
+		count -= blocks << blk->blockbits;
+		blocks = 0;
+	}
+
 	while (blocks) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, true);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -235,7 +521,7 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	}
 
 	if (count) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, true);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -260,7 +546,7 @@ static int block_put(struct block_device *blk, const void *buf, sector_t block)
 	if (block >= blk->num_blocks)
 		return -EINVAL;
 
-	data = block_get(blk, block);
+	data = block_get(blk, block, false);
 	if (IS_ERR(data))
 		return PTR_ERR(data);
 
@@ -284,7 +570,7 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, false);
 
 		now = min(count, now);
 
@@ -315,7 +601,7 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	}
 
 	if (count) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, false);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -369,31 +655,237 @@ struct block_device *cdev_get_block_device(const struct cdev *cdev)
 	return cdev->priv;
 }
 
+/**
+ * block_submit - queue an asynchronous request
+ * @blk: The block device
+ * @req: The request
+ *
+ * Drivers without the asynchronous interface execute the request right
+ * away. Either way @req must stay valid until block_wait() returned or its
+ * complete callback has been called.
+ *
+ * Return: 0 if the request has been queued, negative error code otherwise.
+ * On error the request is not completed and block_wait() returns the error.
+ */
+int block_submit(struct block_device *blk, struct block_request *req)
+{
+	int ret;
+
+	req->blk = blk;
+	req->status = -EINPROGRESS;
+
+	if (!blk->ops->submit) {
+		blk->inflight++;
+
+		if (req->write)
+			ret = IS_ENABLED(CONFIG_BLOCK_WRITE) && blk->ops->write ?
+				blk->ops->write(blk, req->buf, req->block,
+						req->num_blocks) : -EROFS;
+		else
+			ret = blk->ops->read(blk, req->buf, req->block,
+					     req->num_blocks);
+
+		block_request_complete(req, ret);
+
+		return 0;
+	}
+
+	blk->inflight++;
+
+	/* the queue is full, wait for requests to finish like block_wait() */
+	while ((ret = blk->ops->submit(blk, req)) == -EBUSY) {
+		blk->ops->poll(blk);
+		resched();
+	}
+
+	if (ret) {
+		blk->inflight--;
+		req->status = ret;
+	}
+
+	return ret;
+}
+
+/**
+ * block_request_complete - report the end of a request
+ * @req: The request
+ * @status: 0 for success, negative error code otherwise
+ *
+ * Called by drivers when a request submitted through their submit
+ * callback has finished.
+ */
+void block_request_complete(struct block_request *req, int status)
+{
+	req->blk->inflight--;
+	req->status = status;
+
+	if (req->complete)
+		req->complete(req);
+}
+
+/**
+ * block_poll - reap finished requests of a block device
+ * @blk: The block device
+ */
+void block_poll(struct block_device *blk)
+{
+	if (blk->inflight && blk->ops->poll)
+		blk->ops->poll(blk);
+}
+
+/**
+ * block_wait - wait for an asynchronous request to finish
+ * @req: The request
+ *
+ * Return: The status of the request
+ */
+int block_wait(struct block_request *req)
+{
+	while (req->status == -EINPROGRESS) {
+		block_poll(req->blk);
+
+		if (req->status == -EINPROGRESS)
+			resched();
+	}
+
+	return req->status;
+}
+
+static void block_poller(struct poller_struct *poller)
+{
+	struct block_device *blk = container_of(poller, struct block_device, poller);
+
+	block_poll(blk);
+}
+
+static void block_cache_alloc(struct block_device *blk)
+{
+	int i;
+
+	blk->rdbufsize = blk->cache_chunk_size >> blk->blockbits;
+	blk->blkmask = blk->rdbufsize - 1;
+	blk->chunk_tree = RB_ROOT;
+
+	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x chunks: %u\n",
+		blk->rdbufsize, blk->blockbits, blk->blkmask, blk->cache_chunks);
+
+	for (i = 0; i < blk->cache_chunks; i++) {
+		struct chunk *chunk = xzalloc(sizeof(*chunk));
+		chunk->data = dma_alloc(blk->cache_chunk_size);
+		chunk->num = i;
+		list_add_tail(&chunk->list, &blk->idle_blocks);
+	}
+}
+
+static void block_cache_free(struct block_device *blk)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	INIT_LIST_HEAD(&blk->buffered_blocks);
+	INIT_LIST_HEAD(&blk->idle_blocks);
+	blk->chunk_tree = RB_ROOT;
+
+	/* sized by the cache geometry, reallocated on next use */
+	dma_free(blk->ra_buf);
+	blk->ra_buf = NULL;
+	blk->ra_window = 0;
+}
+
+static int block_cache_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+	int ret;
+
+	if (!blk->cache_chunks)
+		return -EINVAL;
+
+	if (!is_power_of_2(blk->cache_chunk_size) ||
+	    blk->cache_chunk_size < BLOCKSIZE(blk))
+		return -EINVAL;
+
+	/* dirty chunks are written back with the old geometry */
+	ret = writebuffer_flush(blk);
+	if (ret)
+		return ret;
+
+	block_cache_free(blk);
+	block_cache_alloc(blk);
+
+	return 0;
+}
+
+static int block_readahead_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+
+	dma_free(blk->ra_buf);
+	blk->ra_buf = NULL;
+	blk->ra_window = 0;
+
+	return 0;
+}
+
+/*
+ * Block devices share their struct device with other block devices in
+ * some drivers (e.g. MMC hardware partitions), so prefix the parameter
+ * with the cdev name unless both are the same.
+ */
+static struct param_d *block_add_cache_param(struct block_device *blk,
+					     const char *name,
+					     int (*set)(struct param_d *p, void *priv),
+					     uint32_t *value)
+{
+	const char *cdevname = blk->cdev.name;
+	struct param_d *p;
+	char *pname, *c;
+
+	if (!cdevname || !strcmp(cdevname, dev_name(blk->dev)))
+		pname = xstrdup(name);
+	else
+		pname = xasprintf("%s_%s", cdevname, name);
+
+	for (c = pname; *c; c++)
+		if (*c == '.')
+			*c = '_';
+
+	p = dev_add_param_uint32(blk->dev, pname, set, NULL, value, "%u", blk);
+
+	free(pname);
+
+	return IS_ERR(p) ? NULL : p;
+}
+
 int blockdevice_register(struct block_device *blk)
 {
 	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
 	int ret;
-	int i;
 
 	blk->cdev.size = size;
 	blk->cdev.dev = blk->dev;
 	blk->cdev.ops = &block_ops;
 	blk->cdev.priv = blk;
-	blk->rdbufsize = BUFSIZE >> blk->blockbits;
 
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
-	blk->blkmask = blk->rdbufsize - 1;
 
-	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x\n",
-		blk->rdbufsize, blk->blockbits, blk->blkmask);
+	if (!blk->cache_chunk_size)
+		blk->cache_chunk_size = max(BUFSIZE, BLOCKSIZE(blk));
+	if (!blk->cache_chunks)
+		blk->cache_chunks = BUFNUM;
+	if (!blk->cache_readahead)
+		blk->cache_readahead = RANUM;
 
-	for (i = 0; i < 8; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
-		chunk->num = i;
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-	}
+	block_cache_alloc(blk);
 
 	ret = devfs_create(&blk->cdev);
 	if (ret)
@@ -401,6 +893,22 @@ int blockdevice_register(struct block_device *blk)
 
 	list_add_tail(&blk->list, &block_device_list);
 
+	blk->param_chunk_size = block_add_cache_param(blk, "cache_chunk_size",
+						      block_cache_set,
+						      &blk->cache_chunk_size);
+	blk->param_chunks = block_add_cache_param(blk, "cache_chunks",
+						  block_cache_set,
+						  &blk->cache_chunks);
+	blk->param_readahead = block_add_cache_param(blk, "cache_readahead",
+						     block_readahead_set,
+						     &blk->cache_readahead);
+
+	/* completes requests submitted by others while they do other work */
+	if (IS_ENABLED(CONFIG_POLLER) && blk->ops->submit && blk->ops->poll) {
+		blk->poller.func = block_poller;
+		poller_register(&blk->poller, blk->cdev.name);
+	}
+
 	cdev_create_default_automount(&blk->cdev);
 
 	return 0;
@@ -408,19 +916,19 @@ int blockdevice_register(struct block_device *blk)
 
 int blockdevice_unregister(struct block_device *blk)
 {
-	struct chunk *chunk, *tmp;
-
 	writebuffer_flush(blk);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	if (IS_ENABLED(CONFIG_POLLER) && blk->poller.registered)
+		poller_unregister(&blk->poller);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	if (blk->param_chunk_size)
+		dev_remove_param(blk->param_chunk_size);
+	if (blk->param_chunks)
+		dev_remove_param(blk->param_chunks);
+	if (blk->param_readahead)
+		dev_remove_param(blk->param_readahead);
+
+	block_cache_free(blk);
 
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
@@ -110,6 +110,18 @@ int bootm_load_os(struct image_data *data, unsigned long load_address)
 		const void *kernel = data->fit_kernel;
 		unsigned long kernel_size = data->fit_kernel_size;
 
+		if (data->fit_kernel_res) {
+			/* already loaded by bootm_open_fit() */
+			if (data->fit_kernel_res->start == load_address) {
+				data->os_res = data->fit_kernel_res;
+				data->fit_kernel_res = NULL;
+				return 0;
+			}
+
+			release_sdram_region(data->fit_kernel_res);
+			data->fit_kernel_res = NULL;
+		}
+
 		data->os_res = request_sdram_region("kernel",
 				load_address, kernel_size);
 		if (!data->os_res) {
@@ -119,19 +131,22 @@ int bootm_load_os(struct image_data *data, unsigned long load_address)
 				(unsigned long long)load_address + kernel_size - 1);
 			return -ENOMEM;
 		}
-		memcpy((void *)load_address, kernel, kernel_size);
+		memmove((void *)load_address, kernel, kernel_size);
+		data->fit_kernel = (void *)load_address;
 		return 0;
 	}
 
 	if (data->os) {
+		struct resource *res;
 		int num;
 
 		num = uimage_part_num(data->os_part);
 
-		data->os_res = uimage_load_to_sdram(data->os,
-			num, load_address);
-		if (!data->os_res)
-			return -ENOMEM;
+		res = uimage_load_to_sdram(data->os, num, load_address);
+		if (IS_ERR(res))
+			return PTR_ERR(res);
+
+		data->os_res = res;
 
 		return 0;
 	}
@@ -175,7 +190,7 @@ static int bootm_open_initrd_uimage(struct image_data *data)
 			return -EINVAL;
 
 		if (bootm_get_verify_mode() > BOOTM_VERIFY_NONE) {
-			ret = uimage_verify(data->initrd);
+			ret = uimage_verify_on_load(data->initrd);
 			if (ret) {
 				pr_err("Checking data crc failed with %s\n",
 					strerror(-ret));
@@ -222,6 +237,19 @@ int bootm_load_initrd(struct image_data *data, unsigned long load_address)
 		const void *initrd;
 		unsigned long initrd_size;
 
+		ret = fit_load_image(data->os_fit, data->fit_config, "ramdisk",
+				     load_address, &data->initrd_res,
+				     &initrd_size);
+		if (!ret) {
+			pr_info("Loaded initrd from FIT image\n");
+			goto done1;
+		}
+		if (ret != -ENOTSUPP) {
+			pr_err("Cannot load ramdisk image in FIT image: %s\n",
+					strerror(-ret));
+			return ret;
+		}
+
 		ret = fit_open_image(data->os_fit, data->fit_config, "ramdisk",
 				     &initrd, &initrd_size);
 		if (ret) {
@@ -253,6 +281,7 @@ int bootm_load_initrd(struct image_data *data, unsigned long load_address)
 	}
 
 	if (type == filetype_uimage) {
+		struct resource *res;
 		int num;
 		ret = bootm_open_initrd_uimage(data);
 		if (ret) {
@@ -263,10 +292,11 @@ int bootm_load_initrd(struct image_data *data, unsigned long load_address)
 
 		num = uimage_part_num(data->initrd_part);
 
-		data->initrd_res = uimage_load_to_sdram(data->initrd,
-			num, load_address);
-		if (!data->initrd_res)
-			return -ENOMEM;
+		res = uimage_load_to_sdram(data->initrd, num, load_address);
+		if (IS_ERR(res))
+			return PTR_ERR(res);
+
+		data->initrd_res = res;
 
 		goto done;
 	}
@@ -497,7 +527,7 @@ static int bootm_open_os_uimage(struct image_data *data)
 		return -EINVAL;
 
 	if (bootm_get_verify_mode() > BOOTM_VERIFY_NONE) {
-		ret = uimage_verify(data->os);
+		ret = uimage_verify_on_load(data->os);
 		if (ret) {
 			pr_err("Checking data crc failed with %s\n",
 					strerror(-ret));
@@ -544,10 +574,6 @@ static int bootm_open_fit(struct image_data *data)
 		return PTR_ERR(data->fit_config);
 	}
 
-	ret = fit_open_image(data->os_fit, data->fit_config, kernel_img,
-			     &data->fit_kernel, &data->fit_kernel_size);
-	if (ret)
-		return ret;
 	if (data->os_address == UIMAGE_SOME_ADDRESS) {
 		ret = fit_get_image_address(data->os_fit,
 					    data->fit_config,
@@ -558,6 +584,29 @@ static int bootm_open_fit(struct image_data *data)
 				kernel_img, data->os_address);
 		/* Note: Error case uses default value. */
 	}
+
+	/*
+	 * With a known load address the kernel can be read to its final
+	 * location directly instead of being copied there later.
+	 */
+	if (data->os_address != UIMAGE_SOME_ADDRESS &&
+	    data->os_address != UIMAGE_INVALID_ADDRESS) {
+		ret = fit_load_image(data->os_fit, data->fit_config, kernel_img,
+				     data->os_address, &data->fit_kernel_res,
+				     &data->fit_kernel_size);
+		if (!ret)
+			data->fit_kernel = (void *)data->os_address;
+		else if (ret != -ENOTSUPP)
+			return ret;
+	}
+
+	if (!data->fit_kernel) {
+		ret = fit_open_image(data->os_fit, data->fit_config, kernel_img,
+				     &data->fit_kernel, &data->fit_kernel_size);
+		if (ret)
+			return ret;
+	}
+
 	if (data->os_entry == UIMAGE_SOME_ADDRESS) {
 		unsigned long entry;
 		ret = fit_get_image_address(data->os_fit,
@@ -814,6 +863,8 @@ int bootm_boot(struct bootm_data *bootm_data)
 err_out:
 	if (data->os_res)
 		release_sdram_region(data->os_res);
+	if (data->fit_kernel_res)
+		release_sdram_region(data->fit_kernel_res);
 	if (data->initrd_res)
 		release_sdram_region(data->initrd_res);
 	if (data->oftree_res)
@@ -923,6 +974,12 @@ static struct image_handler xz_bootm_handler = {
 	.filetype = filetype_xz_compressed,
 };
 
+static struct image_handler zstd_bootm_handler = {
+	.name = "ZSTD compressed file",
+	.bootm = do_bootm_compressed,
+	.filetype = filetype_zstd_compressed,
+};
+
 static int bootm_init(void)
 {
 	globalvar_add_simple("bootm.image", NULL);
@@ -957,6 +1014,8 @@ static int bootm_init(void)
 		register_image_handler(&lz4_bootm_handler);
 	if (IS_ENABLED(CONFIG_XZ_DECOMPRESS))
 		register_image_handler(&xz_bootm_handler);
+	if (IS_ENABLED(CONFIG_ZSTD_DECOMPRESS))
+		register_image_handler(&zstd_bootm_handler);
 
 	return 0;
 }
@@ -645,7 +645,9 @@ int globalvar_add_simple_bitmask(const char *name, unsigned long *value,
 	return PTR_ERR_OR_ZERO(p);
 }
 
-int globalvar_add_simple_ip(const char *name, IPaddr_t *ip)
+int globalvar_add_ip(const char *name,
+		     int (*set)(struct param_d *, void *),
+		     IPaddr_t *ip, void *priv)
 {
 	struct param_d *p;
 	int ret;
@@ -654,8 +656,8 @@ int globalvar_add_simple_ip(const char *name, IPaddr_t *ip)
 	if (ret)
 		return ret;
 
-	p = dev_add_param_ip(&global_device, name, NULL, NULL,
-		ip, NULL);
+	p = dev_add_param_ip(&global_device, name, set, NULL,
+		ip, priv);
 
 	if (IS_ERR(p))
 		return PTR_ERR(p);
@@ -665,6 +667,11 @@ int globalvar_add_simple_ip(const char *name, IPaddr_t *ip)
 	return 0;
 }
 
+int globalvar_add_simple_ip(const char *name, IPaddr_t *ip)
+{
+	return globalvar_add_ip(name, NULL, ip, NULL);
+}
+
 static int globalvar_init(void)
 {
 	const char *endianness;
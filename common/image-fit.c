@@ -23,10 +23,17 @@
 #include <rsa.h>
 #include <uncompress.h>
 #include <image-fit.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory.h>
+#include <linux/sizes.h>
 
 #define FDT_MAX_DEPTH 32
 #define FDT_MAX_PATH_LEN 200
 
+/* chunk size for reading image data from the FIT file */
+#define FIT_READ_CHUNK SZ_1M
+
 #define CHECK_LEVEL_NONE 0
 #define CHECK_LEVEL_HASH 1
 #define CHECK_LEVEL_SIG 2
@@ -329,6 +336,10 @@ static int fit_verify_signature(struct device_node *sig_node, const void *fit)
 	}
 
 	string_list_add(&exc_props, "data");
+	/* where the data is stored is not part of the signature either */
+	string_list_add(&exc_props, "data-size");
+	string_list_add(&exc_props, "data-position");
+	string_list_add(&exc_props, "data-offset");
 
 	digest = fit_alloc_digest(sig_node, &algo);
 	if (IS_ERR(digest)) {
@@ -357,8 +368,20 @@ static int fit_verify_signature(struct device_node *sig_node, const void *fit)
 	return ret;
 }
 
-static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
-			   const void *data, int data_len)
+/*
+ * State of the verification of an image's data, so that the data can be
+ * hashed piecewise while it is loaded.
+ */
+struct fit_image_verify {
+	struct device_node *node;	/* hash or signature node */
+	struct digest *digest;		/* NULL if there is nothing to check */
+	const void *value;		/* expected hash, for hash nodes */
+	enum hash_algo algo;		/* for signature nodes */
+};
+
+static int fit_verify_hash_start(struct fit_handle *handle,
+				 struct device_node *image,
+				 struct fit_image_verify *v)
 {
 	struct digest *d;
 	const char *algo;
@@ -405,35 +428,40 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 
 	if (hash_len != digest_length(d)) {
 		pr_err("%s: invalid hash length %d\n", hash->full_name, hash_len);
-		ret = -EINVAL;
-		goto err_digest_free;
+		digest_free(d);
+		return -EINVAL;
 	}
 
 	digest_init(d);
-	digest_update(d, data, data_len);
 
-	if (digest_verify(d, value_read)) {
-		pr_info("%s: hash BAD\n", hash->full_name);
+	v->node = hash;
+	v->digest = d;
+	v->value = value_read;
+
+	return 0;
+}
+
+static int fit_verify_hash_finish(struct fit_image_verify *v)
+{
+	int ret;
+
+	if (digest_verify(v->digest, v->value)) {
+		pr_info("%s: hash BAD\n", v->node->full_name);
 		ret =  -EBADMSG;
 	} else {
-		pr_info("%s: hash OK\n", hash->full_name);
+		pr_info("%s: hash OK\n", v->node->full_name);
 		ret = 0;
 	}
 
-err_digest_free:
-	digest_free(d);
-
 	return ret;
 }
 
-static int fit_image_verify_signature(struct fit_handle *handle,
-				      struct device_node *image,
-				      const void *data, int data_len)
+static int fit_image_verify_signature_start(struct fit_handle *handle,
+					    struct device_node *image,
+					    struct fit_image_verify *v)
 {
 	struct digest *digest;
 	struct device_node *sig_node;
-	enum hash_algo algo = 0;
-	void *hash;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE))
@@ -457,19 +485,76 @@ static int fit_image_verify_signature(struct fit_handle *handle,
 		return ret;
 	}
 
-	digest = fit_alloc_digest(sig_node, &algo);
+	digest = fit_alloc_digest(sig_node, &v->algo);
 	if (IS_ERR(digest))
 		return PTR_ERR(digest);
 
-	digest_update(digest, data, data_len);
-	hash = xzalloc(digest_length(digest));
-	digest_final(digest, hash);
+	v->node = sig_node;
+	v->digest = digest;
 
-	ret = fit_check_rsa_signature(sig_node, algo, hash);
+	return 0;
+}
+
+static int fit_image_verify_signature_finish(struct fit_image_verify *v)
+{
+	void *hash;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE))
+		return 0;
+
+	hash = xzalloc(digest_length(v->digest));
+	digest_final(v->digest, hash);
+
+	ret = fit_check_rsa_signature(v->node, v->algo, hash);
 
 	free(hash);
 
-	digest_free(digest);
+	return ret;
+}
+
+/*
+ * Images opened as part of a configuration only have their hash checked,
+ * the configuration signature covers them. Other images need a signature.
+ */
+static int fit_image_verify_start(struct fit_handle *handle,
+				  struct device_node *image,
+				  bool configuration,
+				  struct fit_image_verify *v)
+{
+	memset(v, 0, sizeof(*v));
+
+	if (configuration)
+		return fit_verify_hash_start(handle, image, v);
+	else
+		return fit_image_verify_signature_start(handle, image, v);
+}
+
+static void fit_image_verify_update(struct fit_image_verify *v,
+				    const void *data, unsigned long len)
+{
+	if (v->digest)
+		digest_update(v->digest, data, len);
+}
+
+/*
+ * Check the result of the verification. This also cleans up, so it must
+ * be called once for every successful fit_image_verify_start().
+ */
+static int fit_image_verify_finish(struct fit_image_verify *v)
+{
+	int ret;
+
+	if (!v->digest)
+		return 0;
+
+	if (v->value)
+		ret = fit_verify_hash_finish(v);
+	else
+		ret = fit_image_verify_signature_finish(v);
+
+	digest_free(v->digest);
+	v->digest = NULL;
 
 	return ret;
 }
@@ -560,6 +645,78 @@ int fit_get_image_address(struct fit_handle *handle, void *configuration,
 	return ret;
 }
 
+/*
+ * Find the data of an image. It is either embedded in the structure of the
+ * FIT or, for FITs with external data, stored behind it. @data is set if
+ * the data is available in memory, otherwise it has to be read from the
+ * FIT file at @pos.
+ */
+static int fit_find_image_data(struct fit_handle *handle,
+			       struct device_node *image,
+			       const void **data, loff_t *pos, int *data_len)
+{
+	u32 ofs, size;
+
+	*data = of_get_property(image, "data", data_len);
+	if (*data)
+		return 0;
+
+	if (of_property_read_u32(image, "data-size", &size))
+		goto notfound;
+
+	if (!of_property_read_u32(image, "data-position", &ofs))
+		*pos = ofs;
+	else if (!of_property_read_u32(image, "data-offset", &ofs))
+		*pos = handle->data_base + ofs;
+	else
+		goto notfound;
+
+	*data_len = size;
+
+	if (handle->fd >= 0)
+		return 0;
+
+	if (*pos + size > handle->size) {
+		pr_err("data of %s exceeds the image\n", image->full_name);
+		return -EINVAL;
+	}
+
+	*data = handle->fit + *pos;
+
+	return 0;
+
+notfound:
+	pr_err("data not found\n");
+	return -EINVAL;
+}
+
+static int fit_read_image_data(struct fit_handle *handle, loff_t pos,
+			       void *buf, unsigned long len,
+			       struct fit_image_verify *v)
+{
+	int ret;
+
+	while (len) {
+		unsigned long now = min_t(unsigned long, len, FIT_READ_CHUNK);
+
+		ret = pread_full(handle->fd, buf, now, pos);
+		if (ret < 0)
+			return ret;
+		if (ret < now) {
+			pr_err("unexpected end of image\n");
+			return -EIO;
+		}
+
+		fit_image_verify_update(v, buf, now);
+
+		buf += now;
+		pos += now;
+		len -= now;
+	}
+
+	return 0;
+}
+
 static void fit_uncompress_error_fn(char *x)
 {
 	pr_err("%s\n", x);
@@ -589,7 +746,10 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 	struct device_node *image;
 	const char *unit = name, *type = NULL, *compression = NULL,
 	      *desc= "(no description)";
+	struct fit_image_verify v;
 	const void *data;
+	void *buf = NULL;
+	loff_t pos;
 	int data_len;
 	int ret = 0;
 
@@ -606,19 +766,36 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 		return -EINVAL;
 	}
 
-	data = of_get_property(image, "data", &data_len);
-	if (!data) {
-		pr_err("data not found\n");
-		return -EINVAL;
+	ret = fit_find_image_data(handle, image, &data, &pos, &data_len);
+	if (ret)
+		return ret;
+
+	ret = fit_image_verify_start(handle, image, configuration, &v);
+	if (ret < 0)
+		return ret;
+
+	if (data) {
+		fit_image_verify_update(&v, data, data_len);
+	} else {
+		data = buf = malloc(data_len);
+		if (!buf)
+			ret = -ENOMEM;
+		else
+			ret = fit_read_image_data(handle, pos, buf, data_len, &v);
 	}
 
-	if (configuration)
-		ret = fit_verify_hash(handle, image, data, data_len);
-	else
-		ret = fit_image_verify_signature(handle, image, data, data_len);
+	if (ret) {
+		fit_image_verify_finish(&v);
+		goto err_free;
+	}
 
+	ret = fit_image_verify_finish(&v);
 	if (ret < 0)
-		return ret;
+		goto err_free;
+
+	/* keep the data with the FIT, so it's not read again or leaked */
+	if (buf)
+		__of_new_property(image, "data", buf, data_len);
 
 	of_property_read_string(image, "compression", &compression);
 	if (compression && strcmp(compression, "none") != 0) {
@@ -647,6 +824,87 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 	*outsize = data_len;
 
 	return 0;
+
+err_free:
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * fit_load_image - Load an image in a FIT image to its final location
+ * @handle: The FIT image handle
+ * @configuration: The configuration cookie or NULL, see fit_open_image()
+ * @name: The name of the image to load
+ * @load_address: The address to load the image to
+ * @res: Returns the SDRAM region requested for the image
+ * @outsize: Returns the size of the image
+ *
+ * Unlike fit_open_image() this reads the image data from the FIT file
+ * straight to @load_address, verifying it on the way, instead of keeping a
+ * copy of it on the heap. This only works for uncompressed images of FITs
+ * which are not mapped to memory, -ENOTSUPP is returned for others so that
+ * the caller can fall back to fit_open_image().
+ *
+ * Return: 0 for success, negative error code otherwise
+ */
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, unsigned long load_address,
+		   struct resource **res, unsigned long *outsize)
+{
+	struct device_node *image;
+	const char *unit = name, *compression = NULL;
+	struct fit_image_verify v;
+	const void *data;
+	loff_t pos;
+	int data_len;
+	int ret;
+
+	ret = fit_get_image(handle, configuration, &unit, &image);
+	if (ret)
+		return ret;
+
+	of_property_read_string(image, "compression", &compression);
+	if (compression && strcmp(compression, "none") != 0)
+		return -ENOTSUPP;
+
+	ret = fit_find_image_data(handle, image, &data, &pos, &data_len);
+	if (ret)
+		return ret;
+
+	if (data)
+		return -ENOTSUPP;
+
+	*res = request_sdram_region(unit, load_address, data_len);
+	if (!*res)
+		return -ENOTSUPP;
+
+	pr_info("image '%s': loading to 0x%08lx\n", unit, load_address);
+
+	ret = fit_image_verify_start(handle, image, configuration, &v);
+	if (ret < 0)
+		goto err_release;
+
+	ret = fit_read_image_data(handle, pos, (void *)load_address, data_len,
+				  &v);
+	if (ret) {
+		fit_image_verify_finish(&v);
+		goto err_release;
+	}
+
+	ret = fit_image_verify_finish(&v);
+	if (ret < 0)
+		goto err_release;
+
+	*outsize = data_len;
+
+	return 0;
+
+err_release:
+	release_sdram_region(*res);
+	*res = NULL;
+
+	return ret;
 }
 
 static int fit_config_verify_signature(struct fit_handle *handle, struct device_node *conf_node)
@@ -812,6 +1070,8 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	handle->fit = buf;
 	handle->size = size;
 	handle->verify = verify;
+	handle->fd = -1;
+	handle->data_base = ALIGN(fdt32_to_cpu(((struct fdt_header *)buf)->totalsize), 4);
 
 	ret = fit_do_open(handle);
 	if (ret) {
@@ -822,6 +1082,252 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	return handle;
 }
 
+struct fit_reader {
+	int fd;
+	loff_t pos;		/* current position in the file */
+	loff_t buf_pos;		/* file position of buf */
+	size_t buf_len;
+	void *buf;
+};
+
+#define FIT_READER_BUFSIZE	SZ_64K
+
+static int fit_reader_get(struct fit_reader *r, void *dest, size_t len)
+{
+	int ret;
+
+	while (len) {
+		size_t now;
+
+		if (r->pos < r->buf_pos || r->pos >= r->buf_pos + r->buf_len) {
+			ret = pread(r->fd, r->buf, FIT_READER_BUFSIZE, r->pos);
+			if (ret < 0)
+				return ret;
+			if (!ret)
+				return -EINVAL;
+
+			r->buf_pos = r->pos;
+			r->buf_len = ret;
+		}
+
+		now = min_t(size_t, len, r->buf_pos + r->buf_len - r->pos);
+		memcpy(dest, r->buf + (r->pos - r->buf_pos), now);
+
+		dest += now;
+		r->pos += now;
+		len -= now;
+	}
+
+	return 0;
+}
+
+static void fit_put_u32_prop(void *dt, uint32_t nameoff, uint32_t val)
+{
+	struct fdt_property *prop = dt;
+
+	prop->tag = cpu_to_fdt32(FDT_PROP);
+	prop->len = cpu_to_fdt32(sizeof(val));
+	prop->nameoff = cpu_to_fdt32(nameoff);
+	*(fdt32_t *)prop->data = cpu_to_fdt32(val);
+}
+
+#define FIT_U32_PROP_SIZE	(sizeof(struct fdt_property) + sizeof(uint32_t))
+
+/* whether @n more bytes at @pos stay within @end */
+static bool fit_struct_room(u64 pos, u64 n, u64 end)
+{
+	return pos <= end && n <= end - pos;
+}
+
+/*
+ * Read the structure of a FIT without the image data. The image "data"
+ * properties are replaced with "data-position" and "data-size" properties
+ * referring to the file, as if the FIT had been created with external data.
+ * This leaves the signed regions of the structure unchanged, as these
+ * properties are excluded from configuration signatures.
+ */
+static int fit_read_structure(struct fit_handle *handle)
+{
+	static const char extra_strings[] = "data-position\0data-size";
+	struct fit_reader r = { .fd = handle->fd };
+	struct fdt_header hdr, *fdt;
+	uint32_t size_dt_struct, size_dt_strings, off_dt_strings;
+	uint32_t nameoff_pos, nameoff_size, tag;
+	void *dt_struct, *dt_strings;
+	size_t len = 0;
+	loff_t in_end;
+	int ret;
+
+	ret = pread_full(handle->fd, &hdr, sizeof(hdr), 0);
+	if (ret < 0)
+		return ret;
+	if (ret < sizeof(hdr) || fdt32_to_cpu(hdr.magic) != FDT_MAGIC)
+		return -EINVAL;
+
+	size_dt_struct = fdt32_to_cpu(hdr.size_dt_struct);
+	size_dt_strings = fdt32_to_cpu(hdr.size_dt_strings);
+	off_dt_strings = sizeof(hdr) + sizeof(struct fdt_reserve_entry) +
+			 size_dt_struct;
+
+	fdt = malloc(off_dt_strings + size_dt_strings + sizeof(extra_strings));
+	if (!fdt)
+		return -ENOMEM;
+
+	dt_struct = (void *)fdt + sizeof(hdr) + sizeof(struct fdt_reserve_entry);
+	dt_strings = (void *)fdt + off_dt_strings;
+
+	ret = pread_full(handle->fd, dt_strings, size_dt_strings,
+			 fdt32_to_cpu(hdr.off_dt_strings));
+	if (ret < 0)
+		goto err;
+	if (ret < size_dt_strings) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	memcpy(dt_strings + size_dt_strings, extra_strings,
+	       sizeof(extra_strings));
+	nameoff_pos = size_dt_strings;
+	nameoff_size = size_dt_strings + strlen(extra_strings) + 1;
+
+	r.buf = xmalloc(FIT_READER_BUFSIZE);
+	r.pos = fdt32_to_cpu(hdr.off_dt_struct);
+	in_end = r.pos + size_dt_struct;
+
+	do {
+		struct fdt_property *prop;
+		uint32_t proplen, nameoff;
+		char *c;
+
+		if (!fit_struct_room(r.pos, FDT_TAGSIZE, in_end) ||
+		    !fit_struct_room(len, FDT_TAGSIZE, size_dt_struct)) {
+			ret = -EINVAL;
+			goto err;
+		}
+
+		ret = fit_reader_get(&r, dt_struct + len, FDT_TAGSIZE);
+		if (ret)
+			goto err;
+
+		tag = fdt32_to_cpu(*(fdt32_t *)(dt_struct + len));
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			len += FDT_TAGSIZE;
+			do {
+				if (!fit_struct_room(r.pos, FDT_TAGSIZE, in_end) ||
+				    !fit_struct_room(len, FDT_TAGSIZE,
+						     size_dt_struct)) {
+					ret = -EINVAL;
+					goto err;
+				}
+				ret = fit_reader_get(&r, dt_struct + len,
+						     FDT_TAGSIZE);
+				if (ret)
+					goto err;
+				c = dt_struct + len;
+				len += FDT_TAGSIZE;
+			} while (!memchr(c, 0, FDT_TAGSIZE));
+			break;
+
+		case FDT_PROP:
+			prop = dt_struct + len;
+			if (!fit_struct_room(r.pos, sizeof(*prop) - FDT_TAGSIZE,
+					     in_end) ||
+			    !fit_struct_room(len, sizeof(*prop),
+					     size_dt_struct)) {
+				ret = -EINVAL;
+				goto err;
+			}
+
+			ret = fit_reader_get(&r, &prop->len,
+					     sizeof(*prop) - FDT_TAGSIZE);
+			if (ret)
+				goto err;
+
+			proplen = fdt32_to_cpu(prop->len);
+			nameoff = fdt32_to_cpu(prop->nameoff);
+			if (nameoff >= size_dt_strings ||
+			    !fit_struct_room(r.pos, ALIGN((u64)proplen, 4),
+					     in_end)) {
+				ret = -EINVAL;
+				goto err;
+			}
+
+			if (!strcmp(dt_strings + nameoff, "data") &&
+			    proplen > 2 * FIT_U32_PROP_SIZE) {
+				if (!fit_struct_room(len, 2 * FIT_U32_PROP_SIZE,
+						     size_dt_struct)) {
+					ret = -EINVAL;
+					goto err;
+				}
+				fit_put_u32_prop(prop, nameoff_pos, r.pos);
+				fit_put_u32_prop(dt_struct + len + FIT_U32_PROP_SIZE,
+						 nameoff_size, proplen);
+				len += 2 * FIT_U32_PROP_SIZE;
+				r.pos += ALIGN(proplen, 4);
+				break;
+			}
+
+			len += sizeof(*prop);
+			if (!fit_struct_room(len, ALIGN(proplen, 4),
+					     size_dt_struct)) {
+				ret = -EINVAL;
+				goto err;
+			}
+
+			ret = fit_reader_get(&r, dt_struct + len,
+					     ALIGN(proplen, 4));
+			if (ret)
+				goto err;
+			len += ALIGN(proplen, 4);
+			break;
+
+		case FDT_END_NODE:
+		case FDT_NOP:
+		case FDT_END:
+			len += FDT_TAGSIZE;
+			break;
+
+		default:
+			pr_err("%s: Unknown tag 0x%08X\n", __func__, tag);
+			ret = -EINVAL;
+			goto err;
+		}
+	} while (tag != FDT_END);
+
+	/* move the strings up to the shortened structure */
+	memmove(dt_struct + len, dt_strings,
+		size_dt_strings + sizeof(extra_strings));
+	off_dt_strings -= size_dt_struct - len;
+	size_dt_strings += sizeof(extra_strings);
+
+	memset(fdt, 0, sizeof(*fdt) + sizeof(struct fdt_reserve_entry));
+	fdt->magic = cpu_to_fdt32(FDT_MAGIC);
+	fdt->totalsize = cpu_to_fdt32(off_dt_strings + size_dt_strings);
+	fdt->off_dt_struct = cpu_to_fdt32(sizeof(*fdt) +
+					  sizeof(struct fdt_reserve_entry));
+	fdt->off_dt_strings = cpu_to_fdt32(off_dt_strings);
+	fdt->off_mem_rsvmap = cpu_to_fdt32(sizeof(*fdt));
+	fdt->version = cpu_to_fdt32(17);
+	fdt->last_comp_version = cpu_to_fdt32(16);
+	fdt->size_dt_strings = cpu_to_fdt32(size_dt_strings);
+	fdt->size_dt_struct = cpu_to_fdt32(len);
+
+	free(r.buf);
+
+	handle->fit = handle->fit_alloc = fdt;
+	handle->size = off_dt_strings + size_dt_strings;
+	handle->data_base = ALIGN(fdt32_to_cpu(hdr.totalsize), 4);
+
+	return 0;
+err:
+	free(r.buf);
+	free(fdt);
+
+	return ret;
+}
+
 /**
  * fit_open - open a FIT image
  * @filename:	The filename of the FIT image
@@ -831,12 +1337,18 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
  * This opens a FIT image found in @filename. The returned handle is used as
  * context for the other FIT functions.
  *
+ * The FIT is used in place if the file can be mapped to memory. Otherwise
+ * only its structure is read, the image data is read when the images are
+ * opened.
+ *
  * Return: A handle to a FIT image or a ERR_PTR
  */
 struct fit_handle *fit_open(const char *filename, bool verbose,
 			    enum bootm_verify verify)
 {
 	struct fit_handle *handle;
+	struct stat s;
+	void *map;
 	int ret;
 
 	handle = xzalloc(sizeof(struct fit_handle));
@@ -844,14 +1356,29 @@ struct fit_handle *fit_open(const char *filename, bool verbose,
 	handle->verbose = verbose;
 	handle->verify = verify;
 
-	ret = read_file_2(filename, &handle->size, &handle->fit_alloc,
-			  FILESIZE_MAX);
-	if (ret) {
-		pr_err("unable to read %s: %s\n", filename, strerror(-ret));
+	handle->fd = open(filename, O_RDONLY);
+	if (handle->fd < 0) {
+		ret = -errno;
+		pr_err("unable to open %s: %s\n", filename, strerror(-ret));
+		free(handle);
 		return ERR_PTR(ret);
 	}
 
-	handle->fit = handle->fit_alloc;
+	map = memmap(handle->fd, PROT_READ);
+	if (map != MAP_FAILED && !fstat(handle->fd, &s)) {
+		handle->fit = map;
+		handle->size = s.st_size;
+		handle->data_base = ALIGN(fdt32_to_cpu(((struct fdt_header *)map)->totalsize), 4);
+		close(handle->fd);
+		handle->fd = -1;
+	} else {
+		ret = fit_read_structure(handle);
+		if (ret) {
+			pr_err("unable to read %s: %s\n", filename, strerror(-ret));
+			fit_close(handle);
+			return ERR_PTR(ret);
+		}
+	}
 
 	ret = fit_do_open(handle);
 	if (ret) {
@@ -867,6 +1394,9 @@ void fit_close(struct fit_handle *handle)
 	if (handle->root)
 		of_delete_node(handle->root);
 
+	if (handle->fd >= 0)
+		close(handle->fd);
+
 	free(handle->fit_alloc);
 	free(handle);
 }
@@ -875,20 +1405,17 @@ void fit_close(struct fit_handle *handle)
 static int do_bootm_sandbox_fit(struct image_data *data)
 {
 	struct fit_handle *handle;
-	int ret;
-	void *kernel;
-	unsigned long kernel_size;
+	void *config;
+	int ret = 0;
 
-	handle = fit_open(data->os_file, data->verbose);
+	handle = fit_open(data->os_file, data->verbose, data->verify);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
 
-	ret = fit_open_configuration(handle, data->os_part);
-	if (ret)
-		goto out;
+	config = fit_open_configuration(handle, data->os_part);
+	if (IS_ERR(config))
+		ret = PTR_ERR(config);
 
-	ret = 0;
-out:
 	fit_close(handle);
 
 	return ret;
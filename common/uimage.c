@@ -215,10 +215,25 @@ void uimage_close(struct uimage_handle *handle)
 EXPORT_SYMBOL(uimage_close);
 
 static int uimage_fd;
+static int uimage_crc_active;
+static u32 uimage_crc;
+static ulong uimage_crc_len;
+static ulong uimage_consumed;
 
 static int uimage_fill(void *buf, unsigned int len)
 {
-	return read_full(uimage_fd, buf, len);
+	int ret;
+
+	ret = read_full(uimage_fd, buf, len);
+	if (ret > 0 && uimage_crc_active) {
+		/* decompressors may read beyond the end of the data */
+		ulong now = min_t(ulong, ret, uimage_crc_len - uimage_consumed);
+
+		uimage_crc = crc32(uimage_crc, buf, now);
+		uimage_consumed += now;
+	}
+
+	return ret;
 }
 
 static int uncompress_copy(unsigned char *inbuf_unused, int len,
@@ -248,6 +263,8 @@ err:
 	return ret;
 }
 
+#define BUFSIZ	(PAGE_SIZE * 32)
+
 /*
  * Verify the data crc of an uImage
  */
@@ -262,15 +279,19 @@ int uimage_verify(struct uimage_handle *handle)
 	if (lseek(handle->fd, off, SEEK_SET) != off)
 		return -errno;
 
-	buf = xmalloc(PAGE_SIZE);
+	buf = xmalloc(BUFSIZ);
 
 	len = handle->header.ih_size;
 	while (len) {
-		int now = min(len, PAGE_SIZE);
+		int now = min_t(int, len, BUFSIZ);
 		ret = read(handle->fd, buf, now);
 		if (ret < 0)
 			goto err;
-		crc = crc32(crc, buf, now);
+		if (!ret) {
+			ret = -EIO;
+			goto err;
+		}
+		crc = crc32(crc, buf, ret);
 		len -= ret;
 	}
 
@@ -289,6 +310,60 @@ err:
 }
 EXPORT_SYMBOL(uimage_verify);
 
+/*
+ * Check the data crc while the image is loaded instead of reading it
+ * twice. This only works when the whole data is loaded, so multi images
+ * are verified upfront.
+ */
+int uimage_verify_on_load(struct uimage_handle *handle)
+{
+	if (uimage_is_multi_image(handle))
+		return uimage_verify(handle);
+
+	handle->verify_on_load = 1;
+
+	return 0;
+}
+EXPORT_SYMBOL(uimage_verify_on_load);
+
+/*
+ * Feed the rest of the data into the crc in case the decompressor
+ * stopped before the end of the input and compare the result.
+ */
+static int uimage_finish_crc(struct uimage_handle *handle)
+{
+	void *buf;
+	int ret = 0;
+
+	buf = xmalloc(PAGE_SIZE);
+
+	while (uimage_consumed < uimage_crc_len) {
+		unsigned int now = min_t(ulong, PAGE_SIZE,
+				uimage_crc_len - uimage_consumed);
+
+		ret = uimage_fill(buf, now);
+		if (ret < 0)
+			goto out;
+		if (!ret) {
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	if (uimage_crc != handle->header.ih_dcrc) {
+		printf("Bad Data CRC: 0x%08x != 0x%08x\n",
+				uimage_crc, handle->header.ih_dcrc);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = 0;
+out:
+	free(buf);
+
+	return ret;
+}
+
 /*
  * Load a uimage, flushing output to flush function
  */
@@ -322,10 +397,19 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 		uncompress_fn = uncompress;
 
 	uimage_fd = handle->fd;
+	uimage_crc_active = handle->verify_on_load;
+	uimage_crc = 0;
+	uimage_crc_len = hdr->ih_size;
+	uimage_consumed = 0;
 
 	ret = uncompress_fn(NULL, iha->len, uimage_fill, flush,
 				NULL, NULL,
 				uncompress_err_stdout);
+	if (!ret && uimage_crc_active)
+		ret = uimage_finish_crc(handle);
+
+	uimage_crc_active = 0;
+
 	return ret;
 }
 EXPORT_SYMBOL(uimage_load);
@@ -362,8 +446,6 @@ static int uimage_sdram_flush(void *buf, unsigned int len)
 	return len;
 }
 
-#define BUFSIZ	(PAGE_SIZE * 32)
-
 struct resource *file_to_sdram(const char *filename, unsigned long adr)
 {
 	struct resource *res;
@@ -423,7 +505,8 @@ out:
 
 /*
  * Load an uImage to a dynamically allocated sdram resource.
- * the resource must be freed afterwards with release_sdram_region
+ * the resource must be freed afterwards with release_sdram_region.
+ * Returns an ERR_PTR() on failure.
  */
 struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 		int image_no, unsigned long load_address)
@@ -437,7 +520,7 @@ struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 
 	size = uimage_get_size(handle, image_no);
 	if (size < 0)
-		return NULL;
+		return ERR_PTR(size);
 
 	uimage_resource = request_sdram_region("uimage",
 				start, size);
@@ -445,13 +528,14 @@ struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 		printf("unable to request SDRAM 0x%08llx-0x%08llx\n",
 			(unsigned long long)start,
 			(unsigned long long)start + size - 1);
-		return NULL;
+		return ERR_PTR(-ENOMEM);
 	}
 
 	ret = uimage_load(handle, image_no, uimage_sdram_flush);
 	if (ret) {
-		release_sdram_region(uimage_resource);
-		return NULL;
+		if (uimage_resource)
+			release_sdram_region(uimage_resource);
+		return ERR_PTR(ret < 0 ? ret : -EIO);
 	}
 
 	return uimage_resource;
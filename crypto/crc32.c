@@ -141,7 +141,12 @@ static const ulong crc_table[256] = {
 #define DO8(buf)  DO4(buf); DO4(buf);
 
 /* ========================================================================= */
-STATIC uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
+/*
+ * The implementations below work on the CRC register directly, without the
+ * ones complement done by crc32().
+ */
+STATIC uint32_t crc32_le_bytewise(uint32_t crc, const void *_buf,
+				  unsigned int len)
 {
     const unsigned char *buf = _buf;
 
@@ -149,7 +154,6 @@ STATIC uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
 	if (!crc_table)
 		make_crc_table();
 #endif
-    crc = crc ^ 0xffffffffL;
     while (len >= 8)
     {
       DO8(buf);
@@ -158,33 +162,111 @@ STATIC uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
     if (len) do {
       DO1(buf);
     } while (--len);
-    return crc ^ 0xffffffffL;
+
+    return crc;
 }
 #ifdef __BAREBOX__
-EXPORT_SYMBOL(crc32);
+EXPORT_SYMBOL(crc32_le_bytewise);
 #endif
 
-/* No ones complement version. JFFS2 (and other things ?)
- * don't use ones compliment in their CRC calculations.
+#ifdef CONFIG_CRC32_SLICEBY8
+/*
+ * Slicing-by-8: table k holds the CRC of a byte followed by k zero bytes,
+ * so eight input bytes can be folded into the register with eight
+ * independent lookups.
  */
-STATIC uint32_t crc32_no_comp(uint32_t crc, const void *_buf, unsigned int len)
+static uint32_t (*crc_slice_table)[256];
+
+static void make_crc_slice_table(void)
 {
-   const unsigned char *buf = _buf;
+	uint32_t (*t)[256];
+	int n, k;
 
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
 	if (!crc_table)
 		make_crc_table();
 #endif
-    while (len >= 8)
-    {
-      DO8(buf);
-      len -= 8;
-    }
-    if (len) do {
-      DO1(buf);
-    } while (--len);
+	t = xmalloc(sizeof(uint32_t) * 8 * 256);
 
-    return crc;
+	for (n = 0; n < 256; n++)
+		t[0][n] = crc_table[n];
+
+	for (k = 1; k < 8; k++)
+		for (n = 0; n < 256; n++)
+			t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xff];
+
+	crc_slice_table = t;
+}
+
+uint32_t crc32_le_sliceby8(uint32_t crc, const void *_buf, unsigned int len)
+{
+	const unsigned char *buf = _buf;
+	uint32_t (*t)[256];
+	uint32_t one, two;
+
+	if (!crc_slice_table)
+		make_crc_slice_table();
+
+	t = crc_slice_table;
+
+	while (len && ((unsigned long)buf & 3)) {
+		DO1(buf);
+		len--;
+	}
+
+	while (len >= 8) {
+		one = le32_to_cpup((const __le32 *)buf) ^ crc;
+		two = le32_to_cpup((const __le32 *)(buf + 4));
+
+		crc = t[7][one & 0xff] ^
+		      t[6][(one >> 8) & 0xff] ^
+		      t[5][(one >> 16) & 0xff] ^
+		      t[4][one >> 24] ^
+		      t[3][two & 0xff] ^
+		      t[2][(two >> 8) & 0xff] ^
+		      t[1][(two >> 16) & 0xff] ^
+		      t[0][two >> 24];
+
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		DO1(buf);
+
+	return crc;
+}
+EXPORT_SYMBOL(crc32_le_sliceby8);
+#endif
+
+static inline uint32_t __crc32_le(uint32_t crc, const void *buf, unsigned int len)
+{
+#ifdef CONFIG_HAVE_ARCH_CRC32
+	if (arch_crc32_le_supported())
+		return arch_crc32_le(crc, buf, len);
+#endif
+#ifdef CONFIG_CRC32_SLICEBY8
+	return crc32_le_sliceby8(crc, buf, len);
+#else
+	return crc32_le_bytewise(crc, buf, len);
+#endif
+}
+
+/* ========================================================================= */
+STATIC uint32_t crc32(uint32_t crc, const void *buf, unsigned int len)
+{
+	return __crc32_le(crc ^ 0xffffffffL, buf, len) ^ 0xffffffffL;
+}
+#ifdef __BAREBOX__
+EXPORT_SYMBOL(crc32);
+#endif
+
+/* No ones complement version. JFFS2 (and other things ?)
+ * don't use ones compliment in their CRC calculations.
+ */
+STATIC uint32_t crc32_no_comp(uint32_t crc, const void *buf, unsigned int len)
+{
+	return __crc32_le(crc, buf, len);
 }
 
 STATIC uint32_t crc32_be(uint32_t crc, const void *_buf, unsigned int len)
@@ -24,6 +24,13 @@
 #include <linux/err.h>
 #include <crypto.h>
 #include <crypto/internal.h>
+#include <linux/sizes.h>
+
+/*
+ * Reading in larger chunks keeps the number of read() calls down, which
+ * matters for the block device and filesystem layers underneath.
+ */
+#define DIGEST_FD_BUFSIZE	SZ_64K
 
 static LIST_HEAD(digests);
 
@@ -223,7 +230,7 @@ static int digest_update_interruptible(struct digest *d, const void *data,
 static int digest_update_from_fd(struct digest *d, int fd,
 				 loff_t start, loff_t size)
 {
-	unsigned char *buf = xmalloc(PAGE_SIZE);
+	unsigned char *buf = xmalloc(DIGEST_FD_BUFSIZE);
 	int ret = 0;
 
 	if (lseek(fd, start, SEEK_SET) != start) {
@@ -233,7 +240,7 @@ static int digest_update_from_fd(struct digest *d, int fd,
 	}
 
 	while (size) {
-		unsigned long now = min_t(typeof(size), PAGE_SIZE, size);
+		unsigned long now = min_t(typeof(size), DIGEST_FD_BUFSIZE, size);
 
 		ret = read(fd, buf, now);
 		if (ret < 0) {
@@ -244,7 +251,9 @@ static int digest_update_from_fd(struct digest *d, int fd,
 		if (!ret)
 			break;
 
-		ret = digest_update_interruptible(d, buf, ret);
+		now = ret;
+
+		ret = digest_update_interruptible(d, buf, now);
 		if (ret)
 			goto out_free;
 
@@ -19,21 +19,38 @@ struct virtio_blk_priv {
 	struct block_device blk;
 };
 
-static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
-			     sector_t sector, blkcnt_t blkcnt, u32 type)
+/*
+ * Per request data which has to stay around while the device processes the
+ * request. The out header must come first, virtqueue_get_buf() returns the
+ * address of the first buffer of a finished request.
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct block_request *req;
+};
+
+static int virtio_blk_submit(struct block_device *blk, struct block_request *req)
 {
+	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
+	u32 type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
 	unsigned int num_out = 0, num_in = 0;
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	struct virtio_blk_req *vreq;
 	struct virtio_sg *sgs[3];
-	u8 status;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(priv->vdev, type),
-		.sector = cpu_to_virtio64(priv->vdev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	vreq = xzalloc(sizeof(*vreq));
+	vreq->req = req;
+	vreq->out_hdr.type = cpu_to_virtio32(priv->vdev, type);
+	vreq->out_hdr.sector = cpu_to_virtio64(priv->vdev, req->block);
+
+	hdr_sg.addr = &vreq->out_hdr;
+	hdr_sg.length = sizeof(vreq->out_hdr);
+	data_sg.addr = req->buf;
+	data_sg.length = req->num_blocks * 512;
+	status_sg.addr = &vreq->status;
+	status_sg.length = sizeof(vreq->status);
 
 	sgs[num_out++] = &hdr_sg;
 
@@ -49,36 +66,68 @@ static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
 	sgs[num_out + num_in++] = &status_sg;
 
 	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
+	if (ret) {
+		free(vreq);
+		return ret == -ENOSPC ? -EBUSY : ret;
+	}
 
 	virtqueue_kick(priv->vq);
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+	return 0;
+}
+
+static void virtio_blk_poll(struct block_device *blk)
+{
+	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
+	struct virtio_blk_outhdr *out_hdr;
+
+	while ((out_hdr = virtqueue_get_buf(priv->vq, NULL))) {
+		struct virtio_blk_req *vreq =
+			container_of(out_hdr, struct virtio_blk_req, out_hdr);
+		int status = vreq->status == VIRTIO_BLK_S_OK ? 0 : -EIO;
+
+		block_request_complete(vreq->req, status);
+		free(vreq);
+	}
+}
+
+static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
+			     sector_t sector, blkcnt_t blkcnt, bool write)
+{
+	struct block_request req = {
+		.buf = buffer,
+		.block = sector,
+		.num_blocks = blkcnt,
+		.write = write,
+	};
+	int ret;
+
+	ret = block_submit(&priv->blk, &req);
+	if (ret)
+		return ret;
 
-	return status == VIRTIO_BLK_S_OK ? 0 : -EIO;
+	return block_wait(&req);
 }
 
 static int virtio_blk_read(struct block_device *blk, void *buffer,
 			   sector_t start, blkcnt_t blkcnt)
 {
 	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
-	return virtio_blk_do_req(priv, buffer, start, blkcnt,
-				 VIRTIO_BLK_T_IN);
+	return virtio_blk_do_req(priv, buffer, start, blkcnt, false);
 }
 
 static int virtio_blk_write(struct block_device *blk, const void *buffer,
 			    sector_t start, blkcnt_t blkcnt)
 {
 	struct virtio_blk_priv *priv = container_of(blk, struct virtio_blk_priv, blk);
-	return virtio_blk_do_req(priv, (void *)buffer, start, blkcnt,
-				 VIRTIO_BLK_T_OUT);
+	return virtio_blk_do_req(priv, (void *)buffer, start, blkcnt, true);
 }
 
 static struct block_device_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 static int virtio_blk_probe(struct virtio_device *vdev)
@@ -69,6 +69,7 @@
  *   o Otherwise this is corruption type 2.
  */
 
+#include <clock.h>
 #include <linux/err.h>
 #include <linux/math64.h>
 #include <stdlib.h>
@@ -939,6 +940,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	struct ubi_vid_hdr *vidh = ubi_get_vid_hdr(vidb);
 	long long ec;
 	int err, bitflips = 0, vol_id = -1, ec_err = 0;
+	bool hdrs_read;
+	uint64_t start;
 
 	dbg_bld("scan PEB %d", pnum);
 
@@ -951,7 +954,19 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	/*
+	 * Fetch both headers at once if possible. Bit-flips and read errors
+	 * are rare, so the separate reads are good enough to sort them out.
+	 */
+	start = get_time_ns();
+	hdrs_read = !ubi_io_read_hdrs(ubi, pnum, ech, vidb);
+	if (hdrs_read) {
+		ai->hdrs_reads += 1;
+		err = ubi_io_check_ec_hdr(ubi, pnum, ech, 0, 0);
+	} else {
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	}
+	ai->read_time += get_time_ns() - start;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1034,7 +1049,13 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	if (hdrs_read) {
+		err = ubi_io_check_vid_hdr(ubi, pnum, vidb, 0, 0);
+	} else {
+		start = get_time_ns();
+		err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+		ai->read_time += get_time_ns() - start;
+	}
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1369,6 +1390,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+	uint64_t scan_start, scan_time;
 
 	err = -ENOMEM;
 
@@ -1380,6 +1402,8 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!ai->vidb)
 		goto out_ech;
 
+	scan_start = get_time_ns();
+
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		dbg_gen("process PEB %d", pnum);
 		err = scan_peb(ubi, ai, pnum, false);
@@ -1387,7 +1411,10 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 			goto out_vidh;
 	}
 
-	ubi_msg(ubi, "scanning is finished");
+	scan_time = get_time_ns() - scan_start;
+	ubi_msg(ubi, "scanning is finished, %d PEBs in %llu ms (%llu ms reading headers), %d with a single read",
+		ubi->peb_count - start, div_u64(scan_time, MSECOND),
+		div_u64(ai->read_time, MSECOND), ai->hdrs_reads);
 
 	/* Calculate mean erase counter */
 	if (ai->ec_count)
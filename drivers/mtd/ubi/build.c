@@ -633,6 +633,14 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 			goto out_detach;
 	}
 
+	if (IS_ENABLED(CONFIG_MTD_UBI_FASTMAP_AUTOCONVERT) && !ubi->fm &&
+	    !ubi->fm_disabled && !ubi->ro_mode) {
+		ubi_msg(ubi, "attached by scanning, writing a fastmap");
+		err = ubi_update_fastmap(ubi);
+		if (err)
+			ubi_warn(ubi, "Unable to write a fastmap: %d", err);
+	}
+
 	/* Make device "available" before it becomes accessible via sysfs */
 	ubi_devices[ubi_num] = ubi;
 
@@ -451,8 +451,7 @@ bad:
 int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		       struct ubi_ec_hdr *ec_hdr, int verbose)
 {
-	int err, read_err;
-	uint32_t crc, magic, hdr_crc;
+	int read_err;
 
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
@@ -473,6 +472,27 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		 */
 	}
 
+	return ubi_io_check_ec_hdr(ubi, pnum, ec_hdr, read_err, verbose);
+}
+
+/**
+ * ubi_io_check_ec_hdr - check an erase counter header which has been read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock the header was read from
+ * @ec_hdr: the erase counter header
+ * @read_err: the result of reading the header from the flash
+ * @verbose: be verbose if the header is corrupted or was not found
+ *
+ * This is the checking part of 'ubi_io_read_ec_hdr()' for callers which read
+ * the header themselves. @read_err must be %0, %UBI_IO_BITFLIPS or an ECC
+ * error. The return codes are the same as of 'ubi_io_read_ec_hdr()'.
+ */
+int ubi_io_check_ec_hdr(struct ubi_device *ubi, int pnum,
+			struct ubi_ec_hdr *ec_hdr, int read_err, int verbose)
+{
+	int err;
+	uint32_t crc, magic, hdr_crc;
+
 	magic = be32_to_cpu(ec_hdr->magic);
 	if (magic != UBI_EC_HDR_MAGIC) {
 		if (mtd_is_eccerr(read_err))
@@ -725,9 +745,7 @@ bad:
 int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_io_buf *vidb, int verbose)
 {
-	int err, read_err;
-	uint32_t crc, magic, hdr_crc;
-	struct ubi_vid_hdr *vid_hdr = ubi_get_vid_hdr(vidb);
+	int read_err;
 	void *p = vidb->buffer;
 
 	dbg_io("read VID header from PEB %d", pnum);
@@ -738,6 +756,27 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
+	return ubi_io_check_vid_hdr(ubi, pnum, vidb, read_err, verbose);
+}
+
+/**
+ * ubi_io_check_vid_hdr - check a volume identifier header which has been read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock the header was read from
+ * @vidb: the volume identifier buffer holding the header
+ * @read_err: the result of reading the header from the flash
+ * @verbose: be verbose if the header is corrupted or was not found
+ *
+ * This is the checking part of 'ubi_io_read_vid_hdr()', see
+ * 'ubi_io_check_ec_hdr()'.
+ */
+int ubi_io_check_vid_hdr(struct ubi_device *ubi, int pnum,
+			 struct ubi_vid_io_buf *vidb, int read_err, int verbose)
+{
+	int err;
+	uint32_t crc, magic, hdr_crc;
+	struct ubi_vid_hdr *vid_hdr = ubi_get_vid_hdr(vidb);
+
 	magic = be32_to_cpu(vid_hdr->magic);
 	if (magic != UBI_VID_HDR_MAGIC) {
 		if (mtd_is_eccerr(read_err))
@@ -791,6 +830,50 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	return read_err ? UBI_IO_BITFLIPS : 0;
 }
 
+/**
+ * ubi_io_read_hdrs - read the EC and the VID header with a single read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ * @ec_hdr: the erase counter header is stored here
+ * @vidb: the volume identifier header is stored here
+ *
+ * When the VID header is located in the same minimal I/O unit as the EC
+ * header, which is the case for NAND with sub-pages, both headers can be
+ * fetched with one flash read instead of two. This is used while attaching,
+ * where reading the headers of every PEB dominates the time needed. The data
+ * is read through @ubi->peb_buf, so this must not be used concurrently with
+ * other users of that buffer.
+ *
+ * Returns %0 if both headers were read without bit-flips or ECC errors. They
+ * still have to be checked with 'ubi_io_check_ec_hdr()' and
+ * 'ubi_io_check_vid_hdr()'. In all other cases the caller has to fall back to
+ * 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()', which tell which header
+ * is affected. %-EOPNOTSUPP is returned if the headers do not share a minimal
+ * I/O unit.
+ */
+int ubi_io_read_hdrs(struct ubi_device *ubi, int pnum,
+		     struct ubi_ec_hdr *ec_hdr, struct ubi_vid_io_buf *vidb)
+{
+	int vid_len = ubi->vid_hdr_shift + UBI_VID_HDR_SIZE;
+	void *buf = ubi->peb_buf;
+	int err;
+
+	if (ubi->vid_hdr_aloffset + vid_len > ubi->min_io_size)
+		return -EOPNOTSUPP;
+
+	dbg_io("read EC and VID header from PEB %d", pnum);
+	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
+
+	err = ubi_io_read(ubi, buf, pnum, 0, ubi->vid_hdr_aloffset + vid_len);
+	if (err)
+		return err;
+
+	memcpy(ec_hdr, buf, UBI_EC_HDR_SIZE);
+	memcpy(vidb->buffer, buf + ubi->vid_hdr_aloffset, vid_len);
+
+	return 0;
+}
+
 /**
  * ubi_io_write_vid_hdr - write a volume identifier header.
  * @ubi: UBI device description object
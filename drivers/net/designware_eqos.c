@@ -172,7 +172,7 @@ struct eqos_dma_regs {
 #define EQOS_DESCRIPTOR_SIZE	(EQOS_DESCRIPTOR_WORDS * 4)
 /* We assume ARCH_DMA_MINALIGN >= 16; 16 is the EQOS HW minimum */
 #define EQOS_DESCRIPTOR_ALIGN	64
-#define EQOS_DESCRIPTORS_TX	4
+#define EQOS_DESCRIPTORS_TX	8
 #define EQOS_DESCRIPTORS_RX	64
 #define EQOS_DESCRIPTORS_NUM	(EQOS_DESCRIPTORS_TX + EQOS_DESCRIPTORS_RX)
 #define EQOS_DESCRIPTORS_SIZE	ALIGN(EQOS_DESCRIPTORS_NUM * \
@@ -606,6 +606,10 @@ static int eqos_start(struct eth_device *edev)
 
 	eqos->tx_currdescnum = eqos->rx_currdescnum = 0;
 
+	/* frames still queued when the DMA was stopped are dropped */
+	for (i = 0; i < EQOS_DESCRIPTORS_TX; i++)
+		writel(0, &eqos->tx_descs[i].des3);
+
 	for (i = 0; i < EQOS_DESCRIPTORS_RX; i++) {
 		struct eqos_desc *rx_desc = &eqos->rx_descs[i];
 
@@ -692,14 +696,32 @@ static int eqos_send(struct eth_device *edev, void *packet, int length)
 	u32 des3;
 	int ret;
 
+	if (length > EQOS_MAX_PACKET_SIZE)
+		return -EMSGSIZE;
+
 	tx_desc = &eqos->tx_descs[eqos->tx_currdescnum];
+
+	/*
+	 * Frames are copied into a buffer per descriptor, so we return
+	 * without waiting for the transmission. Only when the ring is full
+	 * wait for the hardware to release the descriptor.
+	 */
+	ret = readl_poll_timeout(&tx_desc->des3, des3,
+				  !(des3 & EQOS_DESC3_OWN),
+				  100 * USEC_PER_MSEC);
+	if (ret == -ETIMEDOUT) {
+		eqos_dbg(eqos, "TX timeout\n");
+		return ret;
+	}
+
+	dma = eqos->tx_bufs_dma + eqos->tx_currdescnum * EQOS_MAX_PACKET_SIZE;
+	memcpy(eqos->tx_bufs + eqos->tx_currdescnum * EQOS_MAX_PACKET_SIZE,
+	       packet, length);
+	dma_sync_single_for_device(dma, length, DMA_TO_DEVICE);
+
 	eqos->tx_currdescnum++;
 	eqos->tx_currdescnum %= EQOS_DESCRIPTORS_TX;
 
-	dma = dma_map_single(edev->parent, packet, length, DMA_TO_DEVICE);
-	if (dma_mapping_error(edev->parent, dma))
-		return -EFAULT;
-
 	tx_desc->des0 = (unsigned long)dma;
 	tx_desc->des1 = 0;
 	tx_desc->des2 = length;
@@ -712,16 +734,7 @@ static int eqos_send(struct eth_device *edev, void *packet, int length)
 	writel(EQOS_DESC3_OWN | EQOS_DESC3_FD | EQOS_DESC3_LD | length, &tx_desc->des3);
 	writel((ulong)(tx_desc + 1), &eqos->dma_regs->ch0_txdesc_tail_pointer);
 
-	ret = readl_poll_timeout(&tx_desc->des3, des3,
-				  !(des3 & EQOS_DESC3_OWN),
-				  100 * USEC_PER_MSEC);
-
-	dma_unmap_single(edev->parent, dma, length, DMA_TO_DEVICE);
-
-	if (ret == -ETIMEDOUT)
-		eqos_dbg(eqos, "TX timeout\n");
-
-	return ret;
+	return 0;
 }
 
 static int eqos_recv(struct eth_device *edev)
@@ -795,8 +808,22 @@ static int eqos_init_resources(struct eqos *eqos)
 		p += EQOS_MAX_PACKET_SIZE;
 	}
 
+	eqos->tx_bufs = dma_alloc(EQOS_DESCRIPTORS_TX * EQOS_MAX_PACKET_SIZE);
+	if (!eqos->tx_bufs)
+		goto err_free_rx_bufs;
+
+	eqos->tx_bufs_dma = dma_map_single(edev->parent, eqos->tx_bufs,
+					   EQOS_DESCRIPTORS_TX * EQOS_MAX_PACKET_SIZE,
+					   DMA_TO_DEVICE);
+	if (dma_mapping_error(edev->parent, eqos->tx_bufs_dma)) {
+		ret = -EFAULT;
+		goto err_free_tx_bufs;
+	}
+
 	return 0;
 
+err_free_tx_bufs:
+	dma_free(eqos->tx_bufs);
 err_free_rx_bufs:
 	dma_free(phys_to_virt(eqos->rx_descs[0].des0));
 err_free_desc:
@@ -909,6 +936,9 @@ void eqos_remove(struct device *dev)
 
 	mdiobus_unregister(&eqos->miibus);
 
+	dma_unmap_single(dev, eqos->tx_bufs_dma,
+			 EQOS_DESCRIPTORS_TX * EQOS_MAX_PACKET_SIZE, DMA_TO_DEVICE);
+	dma_free(eqos->tx_bufs);
 	dma_free(phys_to_virt(eqos->rx_descs[0].des0));
 	dma_free_coherent(eqos->tx_descs, 0, EQOS_DESCRIPTORS_SIZE);
 }
@@ -49,6 +49,8 @@ struct eqos {
 	u32 tx_currdescnum, rx_currdescnum;
 
 	struct eqos_desc *tx_descs, *rx_descs;
+	void *tx_bufs;
+	dma_addr_t tx_bufs_dma;
 
 	void __iomem *regs;
 	struct eqos_mac_regs __iomem *mac_regs;
@@ -142,19 +142,17 @@ static int fec_tx_task_disable(struct fec_priv *fec)
 
 /**
  * Swap endianess to send data on an i.MX28 based platform
+ * @param data Pointer to the big endian destination
  * @param buf Pointer to little endian data
  * @param len Size in words (max. 1500 bytes)
- * @return Pointer to the big endian data
  */
-static void *imx28_fix_endianess_wr(uint32_t *buf, unsigned wlen)
+static void imx28_fix_endianess_wr(uint32_t *data, const uint32_t *buf,
+				   unsigned wlen)
 {
 	unsigned u;
-	static uint32_t data[376];	/* = 1500 bytes + 4 bytes */
 
 	for (u = 0; u < wlen; u++, buf++)
 		data[u] = __swab32(*buf);
-
-	return data;
 }
 
 /**
@@ -205,18 +203,22 @@ static int fec_rbd_init(struct fec_priv *fec, int count, int size)
  * Initialize transmit task's buffer descriptors
  * @param[in] fec all we know about the device yet
  *
- * Transmit buffers are created externally. We only have to init the BDs here.\n
+ * Transmit buffers are allocated at probe time. We only have to init the BDs
+ * here.\n
  * Note: There is a race condition in the hardware. When only one BD is in
  * use it must be marked with the WRAP bit to use it for every transmit.
  * This bit in combination with the READY bit results into double transmit
  * of each data buffer. It seems the state machine checks READY earlier then
  * resetting it after the first transfer.
- * Using two BDs solves this issue.
+ * Using a ring of several BDs avoids this issue.
  */
 static void fec_tbd_init(struct fec_priv *fec)
 {
-	writew(0x0000, &fec->tbd_base[0].status);
-	writew(FEC_TBD_WRAP, &fec->tbd_base[1].status);
+	int i;
+
+	for (i = 0; i < FEC_TBD_NUM - 1; i++)
+		writew(0x0000, &fec->tbd_base[i].status);
+	writew(FEC_TBD_WRAP, &fec->tbd_base[FEC_TBD_NUM - 1].status);
 	fec->tbd_index = 0;
 }
 
@@ -461,8 +463,10 @@ static void fec_halt(struct eth_device *dev)
  */
 static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 {
+	struct buffer_descriptor __iomem *tbd;
 	unsigned int status;
 	dma_addr_t dma;
+	void *buf;
 
 	/*
 	 * This routine transmits one frame.  This routine only accepts
@@ -476,24 +480,34 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 		return -1;
 	}
 
-	if (!IS_ALIGNED((unsigned long)eth_data, DB_DATA_ALIGNMENT))
-		dev_warn(&dev->dev, "Transmit data not aligned: %p!\n", eth_data);
+	tbd = &fec->tbd_base[fec->tbd_index];
+
+	/*
+	 * The frame is copied, so there is nothing to clean up after a
+	 * transmission. Only wait when the ring is full and the hardware
+	 * still owns this BD.
+	 */
+	if (readw_poll_timeout(&tbd->status, status, !(status & FEC_TBD_READY),
+			       USEC_PER_SEC)) {
+		dev_err(&dev->dev, "transmission timeout\n");
+		return -ETIMEDOUT;
+	}
 
 	/*
 	 * Setup the transmit buffer
-	 * Note: We are always using the first buffer for transmission,
-	 * the second will be empty and only used to stop the DMA engine
 	 */
-	if (fec_is_imx28(fec))
-		eth_data = imx28_fix_endianess_wr(eth_data, (data_length + 3) >> 2);
+	buf = fec->tx_buf + fec->tbd_index * FEC_MAX_PKT_SIZE;
+	dma = fec->tx_buf_dma + fec->tbd_index * FEC_MAX_PKT_SIZE;
 
-	writew(data_length, &fec->tbd_base[fec->tbd_index].data_length);
+	if (fec_is_imx28(fec))
+		imx28_fix_endianess_wr(buf, eth_data, (data_length + 3) >> 2);
+	else
+		memcpy(buf, eth_data, data_length);
 
-	dma = dma_map_single(fec->dev, eth_data, data_length, DMA_TO_DEVICE);
-	if (dma_mapping_error(fec->dev, dma))
-		return -EFAULT;
+	dma_sync_single_for_device(dma, data_length, DMA_TO_DEVICE);
 
-	writel((uint32_t)(dma), &fec->tbd_base[fec->tbd_index].data_pointer);
+	writew(data_length, &tbd->data_length);
+	writel((uint32_t)(dma), &tbd->data_pointer);
 
 	/*
 	 * update BD's status now
@@ -503,38 +517,29 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 	 * - might be the last BD in the list, so the address counter should
 	 *   wrap (-> keep the WRAP flag)
 	 */
-	status = readw(&fec->tbd_base[fec->tbd_index].status) & FEC_TBD_WRAP;
+	status = readw(&tbd->status) & FEC_TBD_WRAP;
 	status |= FEC_TBD_LAST | FEC_TBD_TC | FEC_TBD_READY;
-	writew(status, &fec->tbd_base[fec->tbd_index].status);
+	writew(status, &tbd->status);
 	/* Enable SmartDMA transmit task */
 	fec_tx_task_enable(fec);
 
-	if (readw_poll_timeout(&fec->tbd_base[fec->tbd_index].status,
-			       status, !(status & FEC_TBD_READY), USEC_PER_SEC))
-		dev_err(&dev->dev, "transmission timeout\n");
-
-	dma_unmap_single(fec->dev, dma, data_length, DMA_TO_DEVICE);
-
-	/* for next transmission use the other buffer */
-	if (fec->tbd_index)
-		fec->tbd_index = 0;
-	else
-		fec->tbd_index = 1;
+	fec->tbd_index = (fec->tbd_index + 1) % FEC_TBD_NUM;
 
 	return 0;
 }
 
 /**
- * Pull one frame from the card
+ * Pull the received frames from the card
  * @param[in] dev Our ethernet device to handle
- * @return Length of packet read
+ * @param[in] budget Maximum number of frames to process
+ * @return Number of buffer descriptors processed, budget if there may be more
  */
-static int fec_recv(struct eth_device *dev)
+static int fec_recv(struct eth_device *dev, int budget)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
-	struct buffer_descriptor __iomem *rbd = &fec->rbd_base[fec->rbd_index];
+	struct buffer_descriptor __iomem *rbd;
 	uint32_t ievent;
-	int len = 0;
+	int len, n;
 	uint16_t bd_status;
 
 	/*
@@ -568,53 +573,57 @@ static int fec_recv(struct eth_device *dev)
 		}
 	}
 
-	/*
-	 * ensure reading the right buffer status
-	 */
-	bd_status = readw(&rbd->status);
+	for (n = 0; n < budget; n++) {
+		rbd = &fec->rbd_base[fec->rbd_index];
 
-	if (bd_status & FEC_RBD_EMPTY)
-		return 0;
-
-	if (bd_status & FEC_RBD_ERR) {
-		dev_warn(&dev->dev, "error frame: 0x%p 0x%08x\n",
-			 rbd, bd_status);
-	} else if (bd_status & FEC_RBD_LAST) {
-		const uint16_t data_length = readw(&rbd->data_length);
-
-		if (data_length - 4 > 14) {
-			void *frame = phys_to_virt(readl(&rbd->data_pointer));
-			/*
-			 * Sync the data for CPU so that endianness
-			 * fixup and net_receive below would get
-			 * proper data
-			 */
-			dma_sync_single_for_cpu((unsigned long)frame,
-						data_length,
-						DMA_FROM_DEVICE);
-			if (fec_is_imx28(fec))
-				imx28_fix_endianess_rd(frame,
-						       (data_length + 3) >> 2);
-
-			/*
-			 * Get buffer address and size
-			 */
-			len = data_length - 4;
-			net_receive(dev, frame, len);
-			dma_sync_single_for_device((unsigned long)frame,
-						   data_length,
-						   DMA_FROM_DEVICE);
+		/*
+		 * ensure reading the right buffer status
+		 */
+		bd_status = readw(&rbd->status);
+
+		if (bd_status & FEC_RBD_EMPTY)
+			break;
+
+		if (bd_status & FEC_RBD_ERR) {
+			dev_warn(&dev->dev, "error frame: 0x%p 0x%08x\n",
+				 rbd, bd_status);
+		} else if (bd_status & FEC_RBD_LAST) {
+			const uint16_t data_length = readw(&rbd->data_length);
+
+			if (data_length - 4 > 14) {
+				void *frame = phys_to_virt(readl(&rbd->data_pointer));
+				/*
+				 * Sync the data for CPU so that endianness
+				 * fixup and net_receive below would get
+				 * proper data
+				 */
+				dma_sync_single_for_cpu((unsigned long)frame,
+							data_length,
+							DMA_FROM_DEVICE);
+				if (fec_is_imx28(fec))
+					imx28_fix_endianess_rd(frame,
+							       (data_length + 3) >> 2);
+
+				/*
+				 * Get buffer address and size
+				 */
+				len = data_length - 4;
+				net_receive(dev, frame, len);
+				dma_sync_single_for_device((unsigned long)frame,
+							   data_length,
+							   DMA_FROM_DEVICE);
+			}
 		}
+		/*
+		 * free the current buffer, restart the engine
+		 * and move forward to the next buffer
+		 */
+		fec_rbd_clean(fec->rbd_index == (FEC_RBD_NUM - 1) ? 1 : 0, rbd);
+		fec_rx_task_enable(fec);
+		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
 	}
-	/*
-	 * free the current buffer, restart the engine
-	 * and move forward to the next buffer
-	 */
-	fec_rbd_clean(fec->rbd_index == (FEC_RBD_NUM - 1) ? 1 : 0, rbd);
-	fec_rx_task_enable(fec);
-	fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
 
-	return len;
+	return n;
 }
 
 static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
@@ -651,6 +660,31 @@ static void fec_free_receive_packets(struct fec_priv *fec, int count, int size)
 	dma_free(p);
 }
 
+static int fec_alloc_transmit_packets(struct fec_priv *fec)
+{
+	size_t size = FEC_TBD_NUM * FEC_MAX_PKT_SIZE;
+
+	fec->tx_buf = dma_alloc(size);
+	if (!fec->tx_buf)
+		return -ENOMEM;
+
+	fec->tx_buf_dma = dma_map_single(fec->dev, fec->tx_buf, size,
+					 DMA_TO_DEVICE);
+	if (dma_mapping_error(fec->dev, fec->tx_buf_dma)) {
+		dma_free(fec->tx_buf);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static void fec_free_transmit_packets(struct fec_priv *fec)
+{
+	dma_unmap_single(fec->dev, fec->tx_buf_dma,
+			 FEC_TBD_NUM * FEC_MAX_PKT_SIZE, DMA_TO_DEVICE);
+	dma_free(fec->tx_buf);
+}
+
 #ifdef CONFIG_OFDEVICE
 static int fec_probe_dt(struct device *dev, struct fec_priv *fec)
 {
@@ -785,7 +819,7 @@ static int fec_probe(struct device *dev)
 	edev->priv = fec;
 	edev->open = fec_open;
 	edev->send = fec_send;
-	edev->recv = fec_recv;
+	edev->recv_budget = fec_recv;
 	edev->halt = fec_halt;
 	edev->get_ethaddr = fec_get_hwaddr;
 	edev->set_ethaddr = fec_set_hwaddr;
@@ -863,7 +897,7 @@ static int fec_probe(struct device *dev)
 	 * reserve memory for both buffer descriptor chains at once
 	 * Datasheet forces the startaddress of each chain is 16 byte aligned
 	 */
-#define FEC_XBD_SIZE ((2 + FEC_RBD_NUM) * sizeof(struct buffer_descriptor))
+#define FEC_XBD_SIZE ((FEC_TBD_NUM + FEC_RBD_NUM) * sizeof(struct buffer_descriptor))
 
 	base = dma_alloc_coherent(FEC_XBD_SIZE, DMA_ADDRESS_BROKEN);
 	fec->rbd_base = base;
@@ -874,6 +908,10 @@ static int fec_probe(struct device *dev)
 	if (ret < 0)
 		goto free_xbd;
 
+	ret = fec_alloc_transmit_packets(fec);
+	if (ret < 0)
+		goto free_receive_packets;
+
 	if (dev->of_node) {
 		ret = fec_probe_dt(dev, fec);
 		fec->phy_addr = -1;
@@ -887,7 +925,7 @@ static int fec_probe(struct device *dev)
 	}
 
 	if (ret)
-		goto free_receive_packets;
+		goto free_transmit_packets;
 
 	fec->miibus.read = fec_miibus_read;
 	fec->miibus.write = fec_miibus_write;
@@ -897,7 +935,7 @@ static int fec_probe(struct device *dev)
 
 	ret = mdiobus_register(&fec->miibus);
 	if (ret)
-		goto free_receive_packets;
+		goto free_transmit_packets;
 
 	ret = eth_register(edev);
 	if (ret)
@@ -907,6 +945,8 @@ static int fec_probe(struct device *dev)
 
 unregister_mdio:
 	mdiobus_unregister(&fec->miibus);
+free_transmit_packets:
+	fec_free_transmit_packets(fec);
 free_receive_packets:
 	fec_free_receive_packets(fec, FEC_RBD_NUM, FEC_MAX_PKT_SIZE);
 free_xbd:
@@ -145,6 +145,8 @@ struct fec_priv {
 	int rbd_index;				/* next receive BD to read   */
 	struct buffer_descriptor __iomem *tbd_base;	/* TBD ring                  */
 	int tbd_index;				/* next transmit BD to write */
+	void *tx_buf;				/* buffers for the TBD ring  */
+	dma_addr_t tx_buf_dma;
 	int phy_addr;
 	phy_interface_t interface;
 	u32 phy_flags;
@@ -179,6 +181,14 @@ static inline int fec_is_imx6(struct fec_priv *priv)
  */
 #define FEC_RBD_NUM		64
 
+/**
+ * @brief Number of transmit buffer descriptors
+ *
+ * Frames are copied into a buffer per descriptor, so sending does not have
+ * to wait for the transmission unless all of them are in use.
+ */
+#define FEC_TBD_NUM		8
+
 /**
  * @brief Define the ethernet packet size limit in memory
  *
@@ -15,7 +15,7 @@
 struct tap_priv {
 	int fd;
 	char *name;
-	char *rx_buf;
+	struct net_pktbuf *rx_pb;
 };
 
 static int tap_eth_send(struct eth_device *edev, void *packet, int length)
@@ -26,17 +26,24 @@ static int tap_eth_send(struct eth_device *edev, void *packet, int length)
 	return 0;
 }
 
-static int tap_eth_rx(struct eth_device *edev)
+static int tap_eth_rx(struct eth_device *edev, int budget)
 {
 	struct tap_priv *priv = edev->priv;
-	int length;
+	struct net_pktbuf *pb;
+	int length, n;
 
-	length = linux_read_nonblock(priv->fd, priv->rx_buf, PKTSIZE);
+	for (n = 0; n < budget; n++) {
+		pb = priv->rx_pb;
 
-	if (length > 0)
-		net_receive(edev, priv->rx_buf, length);
+		length = linux_read_nonblock(priv->fd, pb->data, PKTSIZE);
+		if (length <= 0)
+			break;
 
-	return 0;
+		pb->len = length;
+		priv->rx_pb = net_receive_pktbuf(edev, pb);
+	}
+
+	return n;
 }
 
 static int tap_eth_open(struct eth_device *edev)
@@ -74,21 +81,31 @@ static int tap_probe(struct device *dev)
 		goto out;
 	}
 
-	priv->rx_buf = xmalloc(PKTSIZE);
-
 	edev = xzalloc(sizeof(struct eth_device));
 	edev->priv = priv;
 	edev->parent = dev;
 
+	priv->rx_pb = net_pktbuf_alloc(edev);
+	if (!priv->rx_pb) {
+		free(edev);
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	edev->init = tap_eth_open;
 	edev->open = tap_eth_open;
 	edev->send = tap_eth_send;
-	edev->recv = tap_eth_rx;
+	edev->recv_budget = tap_eth_rx;
 	edev->halt = tap_eth_halt;
 	edev->get_ethaddr = tap_get_ethaddr;
 	edev->set_ethaddr = tap_set_ethaddr;
 
-	eth_register(edev);
+	ret = eth_register(edev);
+	if (ret) {
+		net_pktbuf_put(priv->rx_pb);
+		free(edev);
+		goto out;
+	}
 
 	return 0;
 
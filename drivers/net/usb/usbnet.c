@@ -115,30 +115,115 @@ static int usbnet_send(struct eth_device *edev, void *eth_data, int data_length)
 	return ret;
 }
 
-static int usbnet_recv(struct eth_device *edev)
+static int usbnet_recv_sync(struct eth_device *edev)
 {
 	struct usbnet		*dev = (struct usbnet*) edev->priv;
 	struct driver_info	*info = dev->driver_info;
+	void *buf = dev->rx_urb[0].transfer_buffer;
 	int len, ret, alen = 0;
 
 	dev_dbg(&edev->dev, "%s\n",__func__);
 
 	len = dev->rx_urb_size;
 
-	ret = usb_bulk_msg(dev->udev, dev->in, dev->rx_buf, len, &alen, 2);
+	ret = usb_bulk_msg(dev->udev, dev->in, buf, len, &alen, 2);
 	if (ret)
 		return ret;
 
 	if (alen) {
 		if (info->rx_fixup)
-			return info->rx_fixup(dev, dev->rx_buf, alen);
+			return info->rx_fixup(dev, buf, alen);
 		else
-			net_receive(edev, dev->rx_buf, alen);
+			net_receive(edev, buf, alen);
 	}
 
         return 0;
 }
 
+static void usbnet_rx_complete(struct usb_urb *urb)
+{
+	struct usbnet		*dev = urb->context;
+	struct driver_info	*info = dev->driver_info;
+
+	if (urb->status) {
+		dev_dbg(&dev->edev.dev, "rx urb status %d\n", urb->status);
+		if (urb->status == -EPIPE)
+			set_bit(EVENT_RX_HALT, &dev->flags);
+		return;
+	}
+
+	if (!urb->actual_length)
+		return;
+
+	if (info->rx_fixup)
+		info->rx_fixup(dev, urb->transfer_buffer, urb->actual_length);
+	else
+		net_receive(&dev->edev, urb->transfer_buffer,
+			    urb->actual_length);
+}
+
+static int usbnet_kill_rx_urbs(struct usbnet *dev)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < USBNET_RX_URBS; i++) {
+		int err = usb_kill_urb(&dev->rx_urb[i]);
+
+		if (err)
+			ret = err;
+	}
+
+	return ret;
+}
+
+/*
+ * With several receive URBs queued the adapter can hand over frames while
+ * we are busy elsewhere, so a poll only collects what arrived meanwhile
+ * instead of waiting for a single URB to time out.
+ */
+static int usbnet_recv(struct eth_device *edev)
+{
+	struct usbnet		*dev = (struct usbnet*) edev->priv;
+	int i, ret;
+
+	if (dev->rx_sync)
+		return usbnet_recv_sync(edev);
+
+	if (test_and_clear_bit(EVENT_RX_HALT, &dev->flags))
+		usb_clear_halt(dev->udev, dev->in);
+
+	ret = usb_poll_urbs(dev->udev);
+	if (ret < 0)
+		return ret;
+
+	/* the completed URBs have been processed, queue them again */
+	for (i = 0; i < USBNET_RX_URBS; i++) {
+		struct usb_urb *urb = &dev->rx_urb[i];
+
+		if (urb->status == -EINPROGRESS)
+			continue;
+
+		ret = usb_submit_urb(urb);
+		if (!ret)
+			continue;
+		if (ret == -EAGAIN)
+			break;
+
+		dev_dbg(&edev->dev, "cannot queue rx urbs (%d), polling\n",
+			ret);
+		/* polling receives into the buffer of the first URB */
+		ret = usbnet_kill_rx_urbs(dev);
+		if (ret)
+			return ret;
+
+		dev->rx_sync = true;
+
+		return usbnet_recv_sync(edev);
+	}
+
+	return 0;
+}
+
 static int usbnet_init(struct eth_device *edev)
 {
 	struct usbnet		*dev = (struct usbnet*) edev->priv;
@@ -180,7 +265,13 @@ static int usbnet_open(struct eth_device *edev)
 
 static void usbnet_halt(struct eth_device *edev)
 {
+	struct usbnet		*dev = (struct usbnet*)edev->priv;
+
 	dev_dbg(&edev->dev, "%s\n",__func__);
+
+	/* try to queue URBs again when the device is opened next */
+	if (!usbnet_kill_rx_urbs(dev))
+		dev->rx_sync = false;
 }
 
 int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
@@ -188,7 +279,7 @@ int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
 	struct usbnet *undev;
 	struct eth_device *edev;
 	struct driver_info *info;
-	int status;
+	int status, i;
 
 	dev_dbg(&usbdev->dev, "%s\n", __func__);
 
@@ -220,16 +311,27 @@ int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
 		undev->rx_urb_size = 1514; /* FIXME: What to put here? */
 	undev->maxpacket = usb_maxpacket(undev->udev, undev->out);
 
-	undev->rx_buf = dma_alloc(undev->rx_urb_size);
-	if (!undev->rx_buf) {
-		status = -ENOMEM;
-		goto out1;
+	/*
+	 * xHCI can't queue a buffer crossing a 64KiB boundary, usbnet_recv()
+	 * falls back to polling then.
+	 */
+	for (i = 0; i < USBNET_RX_URBS; i++) {
+		void *buf = dma_alloc(undev->rx_urb_size);
+
+		if (!buf) {
+			status = -ENOMEM;
+			goto out2;
+		}
+
+		usb_fill_bulk_urb(&undev->rx_urb[i], usbdev, undev->in, buf,
+				  undev->rx_urb_size, usbnet_rx_complete,
+				  undev);
 	}
 
 	undev->tx_buf = dma_alloc(4096);
 	if (!undev->tx_buf) {
 		status = -ENOMEM;
-		goto out1;
+		goto out2;
 	}
 
 	eth_register(edev);
@@ -238,6 +340,9 @@ int usbnet_probe(struct usb_device *usbdev, const struct usb_device_id *prod)
 	slice_depends_on(mdiobus_slice(&undev->miibus), usb_device_slice(usbdev));
 
 	return 0;
+out2:
+	for (i = 0; i < USBNET_RX_URBS; i++)
+		free(undev->rx_urb[i].transfer_buffer);
 out1:
 	dev_dbg(&edev->dev, "err: %d\n", status);
 	return status;
@@ -248,6 +353,9 @@ void usbnet_disconnect(struct usb_device *usbdev)
 	struct usbnet *undev = usbdev->drv_data;
 	struct eth_device *edev = &undev->edev;
 	struct driver_info *info;
+	int i, ret;
+
+	ret = usbnet_kill_rx_urbs(undev);
 
 	info = undev->driver_info;
 	if (info->unbind)
@@ -255,7 +363,19 @@ void usbnet_disconnect(struct usb_device *usbdev)
 
 	eth_unregister(edev);
 
-	free(undev->rx_buf);
+	/*
+	 * The controller may still receive into the buffers of URBs we
+	 * couldn't cancel, rather leak them than have it write to freed
+	 * memory.
+	 */
+	if (ret) {
+		dev_warn(&usbdev->dev, "cannot cancel rx urbs: %pe\n",
+			 ERR_PTR(ret));
+		return;
+	}
+
+	for (i = 0; i < USBNET_RX_URBS; i++)
+		free(undev->rx_urb[i].transfer_buffer);
 	free(undev->tx_buf);
 	free(undev);
 }
@@ -22,6 +22,14 @@
  */
 #define VIRTIO_NET_RX_BUF_SIZE	1526
 
+/* Amount of frames which may be in flight in the TX virtqueue */
+#define VIRTIO_NET_NUM_TX_BUFS	16
+
+struct virtio_net_tx_buf {
+	struct virtio_net_hdr_v1 hdr;
+	u8 data[PKTSIZE];
+};
+
 struct virtio_net_priv {
 	union {
 		struct virtqueue *vqs[2];
@@ -33,6 +41,9 @@ struct virtio_net_priv {
 
 	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
 	bool rx_running;
+	struct virtio_net_tx_buf tx_buf[VIRTIO_NET_NUM_TX_BUFS];
+	bool tx_busy[VIRTIO_NET_NUM_TX_BUFS];
+	unsigned int tx_next;
 	int net_hdr_len;
 	struct eth_device edev;
 	struct virtio_device *vdev;
@@ -69,61 +80,95 @@ static int virtio_net_start(struct eth_device *edev)
 	return 0;
 }
 
+/* mark the buffers of frames the device has sent as free again */
+static void virtio_net_tx_reclaim(struct virtio_net_priv *priv)
+{
+	struct virtio_net_tx_buf *buf;
+	unsigned int i;
+
+	while ((buf = virtqueue_get_buf(priv->tx_vq, NULL))) {
+		i = buf - priv->tx_buf;
+		if (i < VIRTIO_NET_NUM_TX_BUFS)
+			priv->tx_busy[i] = false;
+	}
+}
+
 static int virtio_net_send(struct eth_device *edev, void *packet, int length)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
-	struct virtio_net_hdr_v1 hdr_v1;
-	struct virtio_net_hdr hdr;
-	struct virtio_sg hdr_sg;
-	struct virtio_sg data_sg = { packet, length };
+	struct virtio_net_tx_buf *buf;
+	struct virtio_sg hdr_sg, data_sg;
 	struct virtio_sg *sgs[] = { &hdr_sg, &data_sg };
+	unsigned int i = priv->tx_next;
 	int ret;
 
-	if (priv->net_hdr_len == sizeof(struct virtio_net_hdr))
-		hdr_sg.addr = &hdr;
-	else
-		hdr_sg.addr = &hdr_v1;
+	if (length > PKTSIZE)
+		return -EMSGSIZE;
+
+	/*
+	 * The frame is copied, so we don't have to wait for the device to
+	 * send it. Only when all buffers are in flight wait for one.
+	 */
+	while (1) {
+		virtio_net_tx_reclaim(priv);
+		if (!priv->tx_busy[i])
+			break;
+	}
 
+	buf = &priv->tx_buf[i];
+
+	memset(&buf->hdr, 0, priv->net_hdr_len);
+	memcpy(buf->data, packet, length);
+
+	hdr_sg.addr = &buf->hdr;
 	hdr_sg.length = priv->net_hdr_len;
-	memset(hdr_sg.addr, 0, priv->net_hdr_len);
+	data_sg.addr = buf->data;
+	data_sg.length = length;
 
 	ret = virtqueue_add(priv->tx_vq, sgs, 2, 0);
 	if (ret)
 		return ret;
 
-	virtqueue_kick(priv->tx_vq);
+	priv->tx_busy[i] = true;
+	priv->tx_next = (i + 1) % VIRTIO_NET_NUM_TX_BUFS;
 
-	while (1) {
-		if (virtqueue_get_buf(priv->tx_vq, NULL))
-			break;
-	}
+	virtqueue_kick(priv->tx_vq);
 
 	return 0;
 }
 
-static int virtio_net_recv(struct eth_device *edev)
+static int virtio_net_recv(struct eth_device *edev, int budget)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
 	struct virtio_sg sg;
 	struct virtio_sg *sgs[] = { &sg };
 	unsigned int len;
 	void *buf;
+	int n;
 
-	sg.addr = virtqueue_get_buf(priv->rx_vq, &len);
-	if (!sg.addr)
-		return -EAGAIN;
+	virtio_net_tx_reclaim(priv);
 
-	sg.length = VIRTIO_NET_RX_BUF_SIZE;
+	for (n = 0; n < budget; n++) {
+		sg.addr = virtqueue_get_buf(priv->rx_vq, &len);
+		if (!sg.addr)
+			break;
 
-	buf = sg.addr + priv->net_hdr_len;
-	len -= priv->net_hdr_len;
+		sg.length = VIRTIO_NET_RX_BUF_SIZE;
 
-	net_receive(edev, buf, len);
+		buf = sg.addr + priv->net_hdr_len;
+		len -= priv->net_hdr_len;
 
-	/* Put the buffer back to the rx ring */
-	virtqueue_add(priv->rx_vq, sgs, 0, 1);
+		net_receive(edev, buf, len);
 
-	return 0;
+		/* Put the buffer back to the rx ring */
+		virtqueue_add(priv->rx_vq, sgs, 0, 1);
+	}
+
+	/* tell the device about the returned buffers, if it is waiting */
+	if (n)
+		virtqueue_kick(priv->rx_vq);
+
+	return n;
 }
 
 static void virtio_net_stop(struct eth_device *dev)
@@ -196,7 +241,7 @@ static int virtio_net_probe(struct virtio_device *vdev)
 
 	edev->open = virtio_net_start;
 	edev->send = virtio_net_send;
-	edev->recv = virtio_net_recv;
+	edev->recv_budget = virtio_net_recv;
 	edev->halt = virtio_net_stop;
 	edev->get_ethaddr = virtio_net_read_rom_hwaddr;
 	edev->set_ethaddr = virtio_net_write_hwaddr;
@@ -262,7 +262,7 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 				break;
 
 			num_blocks -= chunk;
-			buffer += chunk;
+			buffer += chunk << ns->lba_shift;
 			block += chunk;
 		}
 
@@ -314,6 +314,79 @@ nvme_block_device_write(struct block_device *blk, const void *buffer,
 				   num_blocks);
 }
 
+struct nvme_block_request {
+	struct nvme_request req;
+	struct nvme_command cmnd;
+	struct block_request *breq;
+};
+
+static void nvme_block_end_io(struct nvme_request *req)
+{
+	struct nvme_block_request *nreq =
+		container_of(req, struct nvme_block_request, req);
+	struct block_request *breq = nreq->breq;
+	int ret = 0;
+
+	if (req->status) {
+		dev_err(breq->blk->dev,
+			"I/O failed: block: %llu, num blocks: %llu, status code type: %xh, status code %02xh\n",
+			breq->block, breq->num_blocks, (req->status >> 8) & 0xf,
+			req->status & 0xff);
+		ret = -EIO;
+	}
+
+	free(nreq);
+	block_request_complete(breq, ret);
+}
+
+static int nvme_block_device_submit(struct block_device *blk,
+				    struct block_request *breq)
+{
+	struct nvme_ns *ns = to_nvme_ns(blk);
+	const u32 max_hw_sectors =
+		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
+	struct nvme_block_request *nreq;
+	int ret;
+
+	if (breq->write && (!IS_ENABLED(CONFIG_BLOCK_WRITE) || ns->readonly))
+		return -EROFS;
+
+	/* Requests the controller cannot take in one go are done synchronously */
+	if (breq->num_blocks > max_hw_sectors) {
+		struct nvme_command cmnd = { };
+
+		cmnd.rw.opcode = breq->write ? nvme_cmd_write : nvme_cmd_read;
+		ret = nvme_submit_sync_rw(ns, &cmnd, breq->buf, breq->block,
+					  breq->num_blocks);
+		block_request_complete(breq, ret);
+		return 0;
+	}
+
+	nreq = xzalloc(sizeof(*nreq));
+	nreq->breq = breq;
+	nreq->cmnd.rw.opcode = breq->write ? nvme_cmd_write : nvme_cmd_read;
+	nvme_setup_rw(ns, &nreq->cmnd, breq->block, breq->num_blocks);
+
+	nreq->req.cmd = &nreq->cmnd;
+	nreq->req.buffer = breq->buf;
+	nreq->req.buffer_len = breq->num_blocks << ns->lba_shift;
+	nreq->req.end_io = nvme_block_end_io;
+
+	ret = ns->ctrl->ops->submit_async_cmd(ns->ctrl, &nreq->req,
+					      NVME_QID_IO);
+	if (ret)
+		free(nreq);
+
+	return ret;
+}
+
+static void nvme_block_device_poll(struct block_device *blk)
+{
+	struct nvme_ns *ns = to_nvme_ns(blk);
+
+	ns->ctrl->ops->poll(ns->ctrl, NVME_QID_IO);
+}
+
 static int __maybe_unused nvme_block_device_flush(struct block_device *blk)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
@@ -333,6 +406,16 @@ static struct block_device_ops nvme_block_device_ops = {
 #endif
 };
 
+static struct block_device_ops nvme_block_device_async_ops = {
+	.read = nvme_block_device_read,
+#ifdef CONFIG_BLOCK_WRITE
+	.write = nvme_block_device_write,
+	.flush = nvme_block_device_flush,
+#endif
+	.submit = nvme_block_device_submit,
+	.poll = nvme_block_device_poll,
+};
+
 static void nvme_alloc_ns(struct nvme_ctrl *ctrl, unsigned nsid)
 {
 	struct nvme_ns *ns;
@@ -361,7 +444,10 @@ static void nvme_alloc_ns(struct nvme_ctrl *ctrl, unsigned nsid)
 	nvme_set_disk_name(disk_name, ns, ctrl, &flags);
 
 	ns->blk.dev = ctrl->dev;
-	ns->blk.ops = &nvme_block_device_ops;
+	if (ctrl->ops->submit_async_cmd && ctrl->ops->poll)
+		ns->blk.ops = &nvme_block_device_async_ops;
+	else
+		ns->blk.ops = &nvme_block_device_ops;
 	ns->blk.cdev.name = strdup(disk_name);
 
 	__nvme_revalidate_disk(&ns->blk, id);
@@ -21,11 +21,15 @@ struct nvme_request {
 	struct nvme_command	*cmd;
 	union nvme_result	result;
 	u16			status;
+	bool			done;
 
 	void *buffer;
 	unsigned int buffer_len;
 	dma_addr_t buffer_dma_addr;
 	enum dma_data_direction dma_dir;
+
+	/* called on completion of asynchronously submitted requests */
+	void (*end_io)(struct nvme_request *req);
 };
 
 struct nvme_ctrl {
@@ -78,6 +82,15 @@ struct nvme_ctrl_ops {
 			       void *buffer,
 			       unsigned bufflen,
 			       unsigned timeout, int qid);
+
+	/*
+	 * Optional: queue a request without waiting for it, returns -EBUSY
+	 * when the queue is full. Completed requests are reported through
+	 * their end_io callback from poll.
+	 */
+	int (*submit_async_cmd)(struct nvme_ctrl *ctrl,
+				struct nvme_request *req, int qid);
+	void (*poll)(struct nvme_ctrl *ctrl, int qid);
 };
 
 static inline bool nvme_ctrl_ready(struct nvme_ctrl *ctrl)
@@ -99,6 +112,7 @@ static inline void nvme_end_request(struct nvme_request *rq, __le16 status,
 {
 	rq->status = le16_to_cpu(status) >> 1;
 	rq->result = result;
+	rq->done = true;
 }
 
 int nvme_disable_ctrl(struct nvme_ctrl *ctrl, u64 cap);
@@ -15,17 +15,25 @@
 
 #define NVME_MAX_KB_SZ	4096
 
-static int io_queue_depth = 2;
+static int io_queue_depth = 16;
 
 struct nvme_dev;
 
+struct nvme_prp_pool {
+	__le64 *list;
+	unsigned int size;
+	dma_addr_t dma;
+};
+
 /*
  * An NVM Express queue.  Each device has at least two (one for admin
  * commands and one for I/O commands).
  */
 struct nvme_queue {
 	struct nvme_dev *dev;
-	struct nvme_request *req;
+	struct nvme_request **reqs;	/* in flight, indexed by command id */
+	struct nvme_prp_pool *prps;	/* PRP lists, indexed by command id */
+	unsigned int inflight;
 	struct nvme_command *sq_cmds;
 	volatile struct nvme_completion *cqes;
 	dma_addr_t sq_dma_addr;
@@ -53,10 +61,9 @@ struct nvme_dev {
 	u32 db_stride;
 	void __iomem *bar;
 	bool subsystem;
+	bool dead;	/* disabled after a failed reset */
+	bool resetting;
 	struct nvme_ctrl ctrl;
-	__le64 *prp_pool;
-	unsigned int prp_pool_size;
-	dma_addr_t prp_dma;
 };
 
 static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
@@ -65,6 +72,7 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 }
 
 static int nvme_pci_setup_prps(struct nvme_dev *dev,
+			       struct nvme_prp_pool *pool,
 			       const struct nvme_request *req,
 			       struct nvme_rw_command *cmnd)
 {
@@ -92,16 +100,16 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	if (nprps > dev->prp_pool_size) {
-		dma_free_coherent(dev->prp_pool, dev->prp_dma,
-				  dev->prp_pool_size * sizeof(u64));
-		dev->prp_pool_size = nprps;
-		dev->prp_pool = dma_alloc_coherent(nprps * sizeof(u64),
-						   &dev->prp_dma);
+	if (nprps > pool->size) {
+		dma_free_coherent(pool->list, pool->dma,
+				  pool->size * sizeof(u64));
+		pool->size = nprps;
+		pool->list = dma_alloc_coherent(nprps * sizeof(u64),
+						&pool->dma);
 	}
 
-	prp_list = dev->prp_pool;
-	prp_dma  = dev->prp_dma;
+	prp_list = pool->list;
+	prp_dma  = pool->dma;
 
 	i = 0;
 	for (;;) {
@@ -128,7 +136,8 @@ done:
 	return 0;
 }
 
-static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
+static int nvme_map_data(struct nvme_dev *dev, struct nvme_prp_pool *pool,
+			 struct nvme_request *req)
 {
 	if (!req->buffer || !req->buffer_len)
 		return 0;
@@ -138,7 +147,7 @@ static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
 	if (dma_mapping_error(dev->dev, req->buffer_dma_addr))
 		return -EFAULT;
 
-	return nvme_pci_setup_prps(dev, req, &req->cmd->rw);
+	return nvme_pci_setup_prps(dev, pool, req, &req->cmd->rw);
 }
 
 static void nvme_unmap_data(struct nvme_dev *dev, struct nvme_request *req)
@@ -167,6 +176,10 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (!nvmeq->sq_cmds)
 		goto free_cqdma;
 
+	nvmeq->reqs = xzalloc(depth * sizeof(*nvmeq->reqs));
+	nvmeq->prps = xzalloc(depth * sizeof(*nvmeq->prps));
+	nvmeq->inflight = 0;
+
 	nvmeq->dev = dev;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -310,7 +323,7 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
-	struct nvme_request *req = nvmeq->req;
+	struct nvme_request *req;
 
 	if (unlikely(cqe->command_id >= nvmeq->q_depth)) {
 		dev_warn(nvmeq->dev->ctrl.dev,
@@ -319,10 +332,18 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 		return;
 	}
 
-	if (WARN_ON(cqe->command_id != req->cmd->common.command_id))
+	req = nvmeq->reqs[cqe->command_id];
+	if (WARN_ON(!req))
 		return;
 
+	nvmeq->reqs[cqe->command_id] = NULL;
+	nvmeq->inflight--;
+
+	nvme_unmap_data(nvmeq->dev, req);
 	nvme_end_request(req, cqe->status, cqe->result);
+
+	if (req->end_io)
+		req->end_io(req);
 }
 
 static void nvme_complete_cqes(struct nvme_queue *nvmeq, u16 start, u16 end)
@@ -360,34 +381,21 @@ static inline bool nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
 	return found;
 }
 
-static bool nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
+/* complete all requests the controller has finished */
+static void nvme_poll(struct nvme_queue *nvmeq)
 {
 	u16 start, end;
-	bool found;
 
 	if (!nvme_cqe_pending(nvmeq))
-		return false;
+		return;
 
-	found = nvme_process_cq(nvmeq, &start, &end, tag);
+	nvme_process_cq(nvmeq, &start, &end, -1);
 
 	nvme_complete_cqes(nvmeq, start, end);
-	return found;
 }
 
-static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
-				    struct nvme_command *cmd,
-				    union nvme_result *result,
-				    void *buffer,
-				    unsigned int buffer_len,
-				    unsigned timeout, int qid)
+static int nvme_pci_dma_dir(struct nvme_command *cmd, int qid)
 {
-	struct nvme_dev *dev = to_nvme_dev(ctrl);
-	struct nvme_queue *nvmeq = &dev->queues[qid];
-	struct nvme_request req = { };
-	const u16 tag = nvmeq->counter++ & (nvmeq->q_depth - 1);
-	enum dma_data_direction dma_dir;
-	int ret;
-
 	switch (qid) {
 	case NVME_QID_ADMIN:
 		switch (cmd->common.opcode) {
@@ -396,58 +404,252 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		case nvme_admin_delete_sq:
 		case nvme_admin_delete_cq:
 		case nvme_admin_set_features:
-			dma_dir = DMA_TO_DEVICE;
-			break;
+			return DMA_TO_DEVICE;
 		case nvme_admin_identify:
-			dma_dir = DMA_FROM_DEVICE;
-			break;
+			return DMA_FROM_DEVICE;
+		case nvme_admin_abort_cmd:
+			return DMA_NONE;
 		default:
 			return -EINVAL;
 		}
-		break;
 	case NVME_QID_IO:
 		switch (cmd->rw.opcode) {
 		case nvme_cmd_write:
-			dma_dir = DMA_TO_DEVICE;
-			break;
+			return DMA_TO_DEVICE;
 		case nvme_cmd_read:
-			dma_dir = DMA_FROM_DEVICE;
-			break;
+			return DMA_FROM_DEVICE;
 		default:
 			return -EINVAL;
 		}
-		break;
 	default:
 		return -EINVAL;
 	}
+}
 
-	cmd->common.command_id = tag;
+/*
+ * Assign a free command id to @req, map its data and pass it to the
+ * controller. One queue entry is kept unused, as the controller cannot
+ * tell a full from an empty queue otherwise.
+ */
+static int nvme_pci_queue_rq(struct nvme_dev *dev, struct nvme_request *req,
+			     int qid)
+{
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	int dma_dir, ret;
+	u16 tag;
 
-	timeout = timeout ?: ADMIN_TIMEOUT;
+	if (dev->dead)
+		return -ENODEV;
 
-	req.cmd        = cmd;
-	req.buffer     = buffer;
-	req.buffer_len = buffer_len;
-	req.dma_dir    = dma_dir;
+	dma_dir = nvme_pci_dma_dir(req->cmd, qid);
+	if (dma_dir < 0)
+		return dma_dir;
 
-	ret = nvme_map_data(dev, &req);
+	if (nvmeq->inflight >= nvmeq->q_depth - 1)
+		return -EBUSY;
+
+	/* there is at least one free slot, see above */
+	do {
+		tag = nvmeq->counter++ % nvmeq->q_depth;
+	} while (nvmeq->reqs[tag]);
+
+	req->cmd->common.command_id = tag;
+	req->dma_dir = dma_dir;
+	req->done = false;
+
+	ret = nvme_map_data(dev, &nvmeq->prps[tag], req);
 	if (ret) {
 		dev_err(dev->dev, "Failed to map request data\n");
 		return ret;
 	}
 
-	nvme_submit_cmd(nvmeq, cmd);
+	nvmeq->reqs[tag] = req;
+	nvmeq->inflight++;
+
+	nvme_submit_cmd(nvmeq, req->cmd);
+
+	return 0;
+}
+
+/* Fail all requests in flight, the controller must not own them anymore */
+static void nvme_pci_end_all(struct nvme_dev *dev)
+{
+	union nvme_result res = { };
+	struct nvme_request *req;
+	int qid, tag;
+
+	for (qid = 0; qid < NVME_QID_NUM; qid++) {
+		struct nvme_queue *nvmeq = &dev->queues[qid];
+
+		if (!nvmeq->reqs)
+			continue;
 
-	nvmeq->req = &req;
-	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, tag));
-	nvmeq->req = NULL;
+		for (tag = 0; tag < nvmeq->q_depth; tag++) {
+			req = nvmeq->reqs[tag];
+			if (!req)
+				continue;
 
-	nvme_unmap_data(dev, &req);
+			nvmeq->reqs[tag] = NULL;
+			nvmeq->inflight--;
+
+			nvme_unmap_data(dev, req);
+			nvme_end_request(req, cpu_to_le16(NVME_SC_ABORT_REQ << 1),
+					 res);
+
+			if (req->end_io)
+				req->end_io(req);
+		}
+	}
+}
+
+/*
+ * The controller could neither abort a command nor be reset. It may still
+ * complete the command or access its buffer at any time, so stop it from
+ * accessing memory and don't use it anymore.
+ */
+static void nvme_pci_kill(struct nvme_dev *dev)
+{
+	dev_err(dev->dev, "reset failed, disabling controller\n");
+
+	dev->dead = true;
+	pci_clear_master(to_pci_dev(dev->dev));
+	nvme_disable_ctrl(&dev->ctrl, dev->ctrl.cap);
+
+	nvme_pci_end_all(dev);
+}
+
+static int nvme_create_io_queues(struct nvme_dev *dev);
+static int nvme_pci_configure_admin_queue(struct nvme_dev *dev);
+
+/*
+ * Disabling the controller aborts all commands. Fail them and set up the
+ * queues again, so that later commands can be retried.
+ */
+static int nvme_pci_reset(struct nvme_dev *dev)
+{
+	int qid, ret;
+
+	dev_warn(dev->dev, "resetting controller\n");
+
+	ret = nvme_disable_ctrl(&dev->ctrl, dev->ctrl.cap);
+	if (ret)
+		return ret;
+
+	nvme_pci_end_all(dev);
+
+	for (qid = 0; qid < dev->ctrl.queue_count; qid++) {
+		struct nvme_queue *nvmeq = &dev->queues[qid];
+
+		/* stale entries would look like new completions */
+		memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq->q_depth));
+	}
+
+	dev->online_queues = 0;
+	dev->resetting = true;
+
+	ret = nvme_pci_configure_admin_queue(dev);
+	if (!ret)
+		ret = nvme_create_io_queues(dev);
+
+	dev->resetting = false;
+
+	return ret;
+}
+
+static void nvme_pci_abort(struct nvme_dev *dev, struct nvme_request *req,
+			   int qid)
+{
+	struct nvme_command c = { };
+
+	c.abort.opcode = nvme_admin_abort_cmd;
+	c.abort.cid = req->cmd->common.command_id;
+	c.abort.sqid = cpu_to_le16(qid);
+
+	if (nvme_submit_sync_cmd(&dev->ctrl, &c, NULL, 0))
+		return;
+
+	/* the aborted command completes with an error status */
+	wait_on_timeout(ADMIN_TIMEOUT,
+			(nvme_poll(&dev->queues[qid]), req->done));
+}
+
+/*
+ * A command did not complete in time. The controller still owns it and
+ * may complete it or access its buffer at any time, so neither its tag
+ * nor its buffer can be given back before it's aborted. Commands on the
+ * admin queue can't be aborted reliably, the controller is reset for
+ * them right away. Only when the reset fails the controller is given up.
+ */
+static void nvme_pci_timeout(struct nvme_dev *dev, struct nvme_request *req,
+			     int qid)
+{
+	dev_err(dev->dev, "command %d on queue %d timed out\n",
+		req->cmd->common.command_id, qid);
+
+	if (qid != NVME_QID_ADMIN) {
+		nvme_pci_abort(dev, req, qid);
+		if (req->done)
+			return;
+	}
+
+	/* a command of nvme_pci_reset() itself timed out */
+	if (dev->resetting) {
+		nvme_pci_kill(dev);
+		return;
+	}
+
+	if (nvme_pci_reset(dev) && !dev->dead)
+		nvme_pci_kill(dev);
+}
+
+static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
+				    struct nvme_command *cmd,
+				    union nvme_result *result,
+				    void *buffer,
+				    unsigned int buffer_len,
+				    unsigned timeout, int qid)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	struct nvme_request req = { };
+	int ret;
+
+	timeout = timeout ?: ADMIN_TIMEOUT;
+
+	req.cmd        = cmd;
+	req.buffer     = buffer;
+	req.buffer_len = buffer_len;
+
+	/* asynchronous requests may occupy the queue */
+	while ((ret = nvme_pci_queue_rq(dev, &req, qid)) == -EBUSY)
+		nvme_poll(nvmeq);
+	if (ret)
+		return ret;
+
+	ret = wait_on_timeout(timeout, (nvme_poll(nvmeq), req.done));
+	if (ret) {
+		nvme_pci_timeout(dev, &req, qid);
+		/* our request lives on the stack, it must be gone by now */
+		if (WARN_ON(!req.done))
+			nvme_pci_kill(dev);
+		return ret;
+	}
 
 	if (result)
 		*result = req.result;
 
-	return ret ?: req.status;
+	return req.status;
+}
+
+static int nvme_pci_submit_async_cmd(struct nvme_ctrl *ctrl,
+				     struct nvme_request *req, int qid)
+{
+	return nvme_pci_queue_rq(to_nvme_dev(ctrl), req, qid);
+}
+
+static void nvme_pci_poll(struct nvme_ctrl *ctrl, int qid)
+{
+	nvme_poll(&to_nvme_dev(ctrl)->queues[qid]);
 }
 
 static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
@@ -608,6 +810,8 @@ static const struct nvme_ctrl_ops nvme_pci_ctrl_ops = {
 	.reg_write32		= nvme_pci_reg_write32,
 	.reg_read64		= nvme_pci_reg_read64,
 	.submit_sync_cmd	= nvme_pci_submit_sync_cmd,
+	.submit_async_cmd	= nvme_pci_submit_async_cmd,
+	.poll			= nvme_pci_poll,
 };
 
 static void nvme_dev_map(struct nvme_dev *dev)
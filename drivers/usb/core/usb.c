@@ -718,6 +718,115 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 	return (dev->status == 0) ? 0 : -1;
 }
 
+static int usb_giveback_urbs(struct list_head *done)
+{
+	struct usb_urb *urb, *tmp;
+	int n = 0;
+
+	list_for_each_entry_safe(urb, tmp, done, urb_list) {
+		list_del_init(&urb->urb_list);
+		urb->complete(urb);
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * usb_submit_urb - queue an asynchronous bulk transfer
+ * @urb: the transfer, initialized with usb_fill_bulk_urb()
+ *
+ * The transfer runs in the background, its completion function is called
+ * from usb_poll_urbs() once it is done. Several URBs may be queued to the
+ * same endpoint, they complete in the order they were submitted.
+ *
+ * Return: 0 on success, -ENOSYS if the host controller can only do
+ * synchronous transfers or another negative error code
+ */
+int usb_submit_urb(struct usb_urb *urb)
+{
+	struct usb_host *host = urb->dev->host;
+	int ret;
+
+	if (!host->submit_urb)
+		return -ENOSYS;
+
+	if (urb->status == -EINPROGRESS)
+		return -EBUSY;
+
+	ret = usb_host_acquire(host);
+	if (ret)
+		return ret;
+
+	urb->actual_length = 0;
+	ret = host->submit_urb(urb);
+
+	usb_host_release(host);
+
+	return ret;
+}
+
+/**
+ * usb_kill_urb - cancel an asynchronous transfer
+ * @urb: the transfer
+ *
+ * The completion function of @urb is called with a status of -ENOENT
+ * unless the transfer completed before it could be cancelled. Host
+ * controllers may have to cancel the other URBs queued to the same
+ * endpoint as well, these complete with -ECONNRESET.
+ *
+ * Return: 0 when @urb is no longer queued, -EAGAIN if the host controller
+ * is busy. In the latter case the controller may still write to the
+ * transfer buffer, so it must not be freed.
+ */
+int usb_kill_urb(struct usb_urb *urb)
+{
+	struct usb_host *host = urb->dev->host;
+	LIST_HEAD(done);
+	int ret;
+
+	if (urb->status != -EINPROGRESS || !host->kill_urb)
+		return 0;
+
+	ret = usb_host_acquire(host);
+	if (ret)
+		return ret;
+
+	host->kill_urb(urb, &done);
+
+	usb_host_release(host);
+
+	usb_giveback_urbs(&done);
+
+	return 0;
+}
+
+/**
+ * usb_poll_urbs - complete finished asynchronous transfers
+ * @dev: a device on the host controller to poll
+ *
+ * Return: the number of completed URBs or a negative error code
+ */
+int usb_poll_urbs(struct usb_device *dev)
+{
+	struct usb_host *host = dev->host;
+	LIST_HEAD(done);
+	int ret;
+
+	if (!host->poll_urbs)
+		return 0;
+
+	ret = usb_host_acquire(host);
+	if (ret)
+		return ret;
+
+	host->poll_urbs(host, &done);
+
+	usb_host_release(host);
+
+	return usb_giveback_urbs(&done);
+}
+
 
 /*-------------------------------------------------------------------
  * Max Packet stuff
@@ -48,6 +48,7 @@ struct ehci_host {
 	dma_addr_t periodic_queue_dma;
 	uint32_t *periodic_list;
 	dma_addr_t periodic_list_dma;
+	struct list_head urb_queues;
 };
 
 struct int_queue {
@@ -62,6 +63,27 @@ struct int_queue {
 	dma_addr_t tds_dma;
 };
 
+#define EHCI_URB_QUEUE_LEN	16
+
+/*
+ * Asynchronous bulk transfers of one endpoint. The QH stays linked into
+ * the async schedule behind qh_list[1]. Its qTDs form a ring, the
+ * controller stops at the first inactive one and picks it up once it is
+ * activated by ehci_submit_urb(). The data toggle is kept in the QH.
+ */
+struct ehci_urb_queue {
+	struct list_head list;
+	struct usb_device *dev;
+	unsigned long pipe;
+	struct QH *qh;
+	dma_addr_t qh_dma;
+	struct qTD *tds;
+	dma_addr_t tds_dma;
+	struct usb_urb *urbs[EHCI_URB_QUEUE_LEN];
+	unsigned int head;
+	unsigned int count;
+};
+
 #define to_ehci(ptr) container_of(ptr, struct ehci_host, host)
 
 #define NUM_QH	2
@@ -290,40 +312,17 @@ static int ehci_enable_async_schedule(struct ehci_host *ehci, bool enable)
 	return handshake(&ehci->hcor->or_usbsts, STD_ASS, done, 100 * 1000);
 }
 
-static int
-ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
-		   int length, struct devrequest *req, int timeout_ms)
+static int ehci_init_qh_endpt(struct QH *qh, struct usb_device *dev,
+			      unsigned long pipe, int dtc)
 {
-	struct usb_host *host = dev->host;
-	struct ehci_host *ehci = to_ehci(host);
-	const bool dir_in = usb_pipein(pipe);
-	dma_addr_t buffer_dma = DMA_ERROR_CODE, req_dma;
-	struct QH *qh = &ehci->qh_list[1];
-	struct qTD *td;
-	volatile struct qTD *vtd;
-	uint32_t *tdp;
-	uint32_t endpt, token, usbsts;
-	uint32_t status;
-	uint32_t toggle;
+	uint32_t endpt;
 	bool c;
-	int ret;
-	uint64_t start, timeout_val;
-
-
-	dev_dbg(ehci->dev, "pipe=%lx, buffer=%p, length=%d, req=%p\n", pipe,
-	      buffer, length, req);
-	if (req != NULL)
-		dev_dbg(ehci->dev, "(req=%u (%#x), type=%u (%#x), value=%u (%#x), index=%u\n",
-		      req->request, req->request,
-		      req->requesttype, req->requesttype,
-		      le16_to_cpu(req->value), le16_to_cpu(req->value),
-		      le16_to_cpu(req->index));
 
 	c = dev->speed != USB_SPEED_HIGH && !usb_pipeendpoint(pipe);
 	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
 		QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipe)) |
 		QH_ENDPT1_H(0) |
-		QH_ENDPT1_DTC(QH_ENDPT1_DTC_DT_FROM_QTD) |
+		QH_ENDPT1_DTC(dtc) |
 		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
 		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
 
@@ -348,6 +347,49 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		QH_ENDPT2_UFCMASK(0) |
 		QH_ENDPT2_UFSMASK(0);
 	qh->qh_endpt2 = cpu_to_hc32(endpt);
+
+	return 0;
+}
+
+static int
+ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
+		   int length, struct devrequest *req, int timeout_ms)
+{
+	struct usb_host *host = dev->host;
+	struct ehci_host *ehci = to_ehci(host);
+	const bool dir_in = usb_pipein(pipe);
+	dma_addr_t buffer_dma = DMA_ERROR_CODE, req_dma;
+	struct QH *qh = &ehci->qh_list[1];
+	struct qTD *td;
+	volatile struct qTD *vtd;
+	uint32_t *tdp;
+	uint32_t token, usbsts;
+	uint32_t status;
+	uint32_t toggle;
+	int ret;
+	uint64_t start, timeout_val;
+
+
+	dev_dbg(ehci->dev, "pipe=%lx, buffer=%p, length=%d, req=%p\n", pipe,
+	      buffer, length, req);
+	if (req != NULL)
+		dev_dbg(ehci->dev, "(req=%u (%#x), type=%u (%#x), value=%u (%#x), index=%u\n",
+		      req->request, req->request,
+		      req->requesttype, req->requesttype,
+		      le16_to_cpu(req->value), le16_to_cpu(req->value),
+		      le16_to_cpu(req->index));
+
+	if (!list_empty(&ehci->urb_queues)) {
+		/* don't change qh_list[1] under the feet of the controller */
+		ret = ehci_enable_async_schedule(ehci, false);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = ehci_init_qh_endpt(qh, dev, pipe, QH_ENDPT1_DTC_DT_FROM_QTD);
+	if (ret)
+		return ret;
+
 	qh->qh_curtd = 0;
 	qh->qt_token = 0;
 	memzero32(qh->qt_buffer, sizeof(qh->qt_buffer));
@@ -994,6 +1036,293 @@ submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 	return ehci_submit_async(dev, pipe, buffer, length, setup, timeout);
 }
 
+#define EHCI_URB_QUEUE_SIZE \
+	(sizeof(struct QH) + EHCI_URB_QUEUE_LEN * sizeof(struct qTD))
+
+static struct ehci_urb_queue *
+ehci_find_urb_queue(struct ehci_host *ehci, struct usb_device *dev,
+		    unsigned long pipe)
+{
+	struct ehci_urb_queue *q;
+
+	list_for_each_entry(q, &ehci->urb_queues, list) {
+		if (q->dev == dev &&
+		    usb_pipeendpoint(q->pipe) == usb_pipeendpoint(pipe) &&
+		    usb_pipein(q->pipe) == usb_pipein(pipe))
+			return q;
+	}
+
+	return NULL;
+}
+
+static struct ehci_urb_queue *
+ehci_create_urb_queue(struct ehci_host *ehci, struct usb_device *dev,
+		      unsigned long pipe)
+{
+	struct ehci_urb_queue *q;
+	struct QH *qh;
+	uint32_t toggle;
+	int i, ret;
+
+	q = xzalloc(sizeof(*q));
+	q->dev = dev;
+	q->pipe = pipe;
+
+	q->qh = dma_alloc_coherent(EHCI_URB_QUEUE_SIZE, &q->qh_dma);
+	if (!q->qh) {
+		free(q);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	q->tds = (void *)q->qh + sizeof(struct QH);
+	q->tds_dma = q->qh_dma + sizeof(struct QH);
+
+	for (i = 0; i < EHCI_URB_QUEUE_LEN; i++) {
+		struct qTD *td = &q->tds[i];
+		int next = (i + 1) % EHCI_URB_QUEUE_LEN;
+
+		td->qt_next = cpu_to_hc32(EHCI_DMA(q->tds_dma, q->tds,
+						   &q->tds[next]));
+		td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		td->qt_token = 0;
+	}
+
+	qh = q->qh;
+	ret = ehci_init_qh_endpt(qh, dev, pipe, QH_ENDPT1_DTC_IGNORE_QTD_TD);
+	if (ret)
+		goto err_free;
+
+	toggle = usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
+
+	qh->qh_curtd = 0;
+	qh->qt_next = cpu_to_hc32(q->tds_dma);
+	qh->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle));
+	memzero32(qh->qt_buffer, sizeof(qh->qt_buffer));
+
+	/* link it in behind qh_list[1] while the schedule is stopped */
+	ret = ehci_enable_async_schedule(ehci, false);
+	if (ret < 0)
+		goto err_free;
+
+	qh->qh_link = ehci->qh_list[1].qh_link;
+	ehci->qh_list[1].qh_link = cpu_to_hc32(q->qh_dma | QH_LINK_TYPE_QH);
+	list_add(&q->list, &ehci->urb_queues);
+
+	return q;
+
+err_free:
+	dma_free_coherent(q->qh, q->qh_dma, EHCI_URB_QUEUE_SIZE);
+	free(q);
+
+	return ERR_PTR(ret);
+}
+
+static int ehci_urb_status(uint32_t token)
+{
+	uint32_t status = QT_TOKEN_GET_STATUS(token);
+
+	if (!(status & QT_TOKEN_STATUS_HALTED))
+		return 0;
+	if (status & QT_TOKEN_STATUS_BABBLEDET)
+		return -EOVERFLOW;
+	if (status & QT_TOKEN_STATUS_DATBUFERR)
+		return -ENOSR;
+	if (status & QT_TOKEN_STATUS_XACTERR)
+		return -EPROTO;
+
+	return -EPIPE;
+}
+
+static void ehci_giveback_urb(struct ehci_host *ehci, struct ehci_urb_queue *q,
+			      int status, struct list_head *done)
+{
+	struct usb_urb *urb = q->urbs[q->head];
+
+	if (urb->transfer_buffer_length)
+		dma_unmap_single(ehci->dev, urb->transfer_dma,
+				 urb->transfer_buffer_length,
+				 usb_pipein(urb->pipe) ?
+				 DMA_FROM_DEVICE : DMA_TO_DEVICE);
+
+	urb->status = status;
+	list_add_tail(&urb->urb_list, done);
+
+	q->urbs[q->head] = NULL;
+	q->head = (q->head + 1) % EHCI_URB_QUEUE_LEN;
+	q->count--;
+}
+
+/*
+ * Move the completed URBs of a queue to @done. Returns true if the
+ * endpoint halted, the queue must be freed then.
+ */
+static bool ehci_reap_urb_queue(struct ehci_host *ehci,
+				struct ehci_urb_queue *q,
+				struct list_head *done)
+{
+	while (q->count) {
+		volatile struct qTD *vtd = &q->tds[q->head];
+		struct usb_urb *urb = q->urbs[q->head];
+		uint32_t token = hc32_to_cpu(vtd->qt_token);
+		int status;
+
+		if (token & QT_TOKEN_STATUS_ACTIVE)
+			break;
+
+		urb->actual_length = urb->transfer_buffer_length -
+				     QT_TOKEN_GET_TOTALBYTES(token);
+
+		status = ehci_urb_status(token);
+		ehci_giveback_urb(ehci, q, status, done);
+		if (status)
+			return true;
+	}
+
+	return false;
+}
+
+/* must be called with the async schedule stopped */
+static void ehci_free_urb_queue(struct ehci_host *ehci,
+				struct ehci_urb_queue *q,
+				struct usb_urb *killed,
+				struct list_head *done)
+{
+	struct usb_device *dev = q->dev;
+	struct QH *prev;
+	uint32_t token;
+
+	while (q->count) {
+		struct usb_urb *urb = q->urbs[q->head];
+
+		urb->actual_length = 0;
+		ehci_giveback_urb(ehci, q, urb == killed ? -ENOENT : -ECONNRESET,
+				  done);
+	}
+
+	token = hc32_to_cpu(q->qh->qt_token);
+	usb_settoggle(dev, usb_pipeendpoint(q->pipe), usb_pipeout(q->pipe),
+		      QT_TOKEN_GET_DT(token));
+
+	if (list_is_first(&q->list, &ehci->urb_queues))
+		prev = &ehci->qh_list[1];
+	else
+		prev = list_prev_entry(q, list)->qh;
+
+	prev->qh_link = q->qh->qh_link;
+	list_del(&q->list);
+
+	dma_free_coherent(q->qh, q->qh_dma, EHCI_URB_QUEUE_SIZE);
+	free(q);
+}
+
+static int ehci_submit_urb(struct usb_urb *urb)
+{
+	struct usb_device *dev = urb->dev;
+	struct ehci_host *ehci = to_ehci(dev->host);
+	const bool dir_in = usb_pipein(urb->pipe);
+	int length = urb->transfer_buffer_length;
+	struct ehci_urb_queue *q;
+	unsigned int idx;
+	struct qTD *td;
+	int ret;
+
+	if (usb_pipetype(urb->pipe) != PIPE_BULK)
+		return -EINVAL;
+
+	q = ehci_find_urb_queue(ehci, dev, urb->pipe);
+	if (!q) {
+		q = ehci_create_urb_queue(ehci, dev, urb->pipe);
+		if (IS_ERR(q))
+			return PTR_ERR(q);
+	}
+
+	if (q->count == EHCI_URB_QUEUE_LEN)
+		return -EBUSY;
+
+	idx = (q->head + q->count) % EHCI_URB_QUEUE_LEN;
+	td = &q->tds[idx];
+
+	if (length) {
+		enum dma_data_direction dir = dir_in ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+		urb->transfer_dma = dma_map_single(ehci->dev,
+						   urb->transfer_buffer,
+						   length, dir);
+		if (dma_mapping_error(ehci->dev, urb->transfer_dma))
+			return -EFAULT;
+
+		ret = ehci_td_buffer(td, urb->transfer_dma, length);
+		if (ret) {
+			dma_unmap_single(ehci->dev, urb->transfer_dma, length,
+					 dir);
+			return ret;
+		}
+	} else {
+		memzero32(td->qt_buffer, sizeof(td->qt_buffer));
+	}
+
+	q->urbs[idx] = urb;
+	q->count++;
+	urb->hcpriv = q;
+	urb->status = -EINPROGRESS;
+
+	/* the controller may look at the qTD anytime, activate it last */
+	barrier();
+	td->qt_token = cpu_to_hc32(QT_TOKEN_TOTALBYTES(length) |
+				   QT_TOKEN_IOC(1) | QT_TOKEN_CERR(3) |
+				   QT_TOKEN_PID(dir_in ? QT_TOKEN_PID_IN :
+						QT_TOKEN_PID_OUT) |
+				   QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE));
+
+	ret = ehci_enable_async_schedule(ehci, true);
+	if (ret < 0)
+		dev_err(ehci->dev, "fail timeout STD_ASS set\n");
+
+	return 0;
+}
+
+static void ehci_kill_urb(struct usb_urb *urb, struct list_head *done)
+{
+	struct ehci_host *ehci = to_ehci(urb->dev->host);
+	struct ehci_urb_queue *q = urb->hcpriv;
+	bool halted;
+
+	/*
+	 * The ring can't be stopped at a single qTD, so cancelling an URB
+	 * tears down the whole queue of its endpoint.
+	 */
+	if (ehci_enable_async_schedule(ehci, false) < 0)
+		dev_err(ehci->dev, "fail timeout STD_ASS reset\n");
+
+	halted = ehci_reap_urb_queue(ehci, q, done);
+	if (halted || urb->status == -EINPROGRESS)
+		ehci_free_urb_queue(ehci, q, urb, done);
+
+	if (!list_empty(&ehci->urb_queues))
+		ehci_enable_async_schedule(ehci, true);
+}
+
+static void ehci_poll_urbs(struct usb_host *host, struct list_head *done)
+{
+	struct ehci_host *ehci = to_ehci(host);
+	struct ehci_urb_queue *q, *tmp;
+
+	list_for_each_entry_safe(q, tmp, &ehci->urb_queues, list) {
+		if (!ehci_reap_urb_queue(ehci, q, done))
+			continue;
+
+		/* the submitter has to clear the halt before resubmitting */
+		ehci_enable_async_schedule(ehci, false);
+		ehci_free_urb_queue(ehci, q, NULL, done);
+	}
+
+	/* synchronous transfers stop the schedule when they are done */
+	if (!list_empty(&ehci->urb_queues))
+		ehci_enable_async_schedule(ehci, true);
+}
+
 static int
 disable_periodic(struct ehci_host *ehci)
 {
@@ -1369,6 +1698,7 @@ struct ehci_host *ehci_register(struct device *dev, struct ehci_data *data)
 						  &ehci->periodic_queue_dma);
 	ehci->td = dma_alloc_coherent(sizeof(struct qTD) * NUM_TD,
 				      &ehci->td_dma);
+	INIT_LIST_HEAD(&ehci->urb_queues);
 
 	host->hw_dev = dev;
 	host->init = ehci_init;
@@ -1376,6 +1706,11 @@ struct ehci_host *ehci_register(struct device *dev, struct ehci_data *data)
 	host->submit_int_msg = submit_int_msg;
 	host->submit_control_msg = submit_control_msg;
 	host->submit_bulk_msg = submit_bulk_msg;
+	if (IS_ENABLED(CONFIG_USB_HOST_URB)) {
+		host->submit_urb = ehci_submit_urb;
+		host->kill_urb = ehci_kill_urb;
+		host->poll_urbs = ehci_poll_urbs;
+	}
 
 	if (ehci->flags & EHCI_HAS_TT) {
 		ehci_reset(ehci);
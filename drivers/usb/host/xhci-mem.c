@@ -456,6 +456,7 @@ static struct xhci_container_ctx
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 {
 	u64 byte_64 = 0;
+	int i;
 	struct xhci_virt_device *virt_dev;
 
 	/* Slot ID 0 is reserved */
@@ -475,6 +476,9 @@ int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 	memset(ctrl->devs[slot_id], 0, sizeof(struct xhci_virt_device));
 	virt_dev = ctrl->devs[slot_id];
 
+	for (i = 0; i < ARRAY_SIZE(virt_dev->eps); i++)
+		INIT_LIST_HEAD(&virt_dev->eps[i].urb_list);
+
 	/* Allocate the (output) device context that will be used in the HC. */
 	virt_dev->out_ctx = xhci_alloc_container_ctx(ctrl,
 					XHCI_CTX_TYPE_DEVICE);
@@ -427,6 +427,105 @@ static int event_ready(struct xhci_ctrl *ctrl)
 	return 1;
 }
 
+static int xhci_urb_status(union xhci_trb *event)
+{
+	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		return 0;
+	case COMP_STALL:
+		return -EPIPE;
+	case COMP_DB_ERR:
+	case COMP_TRB_ERR:
+		return -ENOSR;
+	case COMP_BABBLE:
+		return -EOVERFLOW;
+	default:
+		return -EPROTO;
+	}
+}
+
+static void xhci_giveback_urb(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			      struct usb_urb *urb, int status)
+{
+	dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma,
+			 urb->transfer_buffer_length,
+			 usb_pipein(urb->pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
+
+	urb->status = status;
+	list_move_tail(&urb->urb_list, &ctrl->urb_done);
+	ep->num_urbs--;
+}
+
+/**
+ * Completes the asynchronous transfer a transfer event belongs to and
+ * acknowledges the event. The URB is put on the list of done URBs which
+ * is handed to the USB core by xhci_poll_urbs().
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	the transfer event
+ * @return false if the event does not belong to an asynchronous transfer
+ */
+static bool xhci_urb_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 flags = le32_to_cpu(event->trans_event.flags);
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	unsigned int slot_id = TRB_TO_SLOT_ID(flags);
+	int ep_index = TRB_TO_EP_INDEX(flags);
+	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *ep;
+	struct usb_urb *urb, *tmp;
+	int status;
+
+	if (slot_id >= MAX_HC_SLOTS || ep_index < 0 ||
+	    ep_index >= ARRAY_SIZE(virt_dev->eps))
+		return false;
+
+	virt_dev = ctrl->devs[slot_id];
+	if (!virt_dev)
+		return false;
+
+	ep = &virt_dev->eps[ep_index];
+	if (list_empty(&ep->urb_list))
+		return false;
+
+	/* abort_td() waits for this one */
+	switch (GET_COMP_CODE(len)) {
+	case COMP_STOP:
+	case COMP_STOP_INVAL:
+		return false;
+	}
+
+	urb = list_first_entry(&ep->urb_list, struct usb_urb, urb_list);
+
+	if (le64_to_cpu(event->trans_event.buffer) != (uintptr_t)urb->hcpriv) {
+		dev_warn(ctrl->dev, "unexpected transfer event for ep %d\n",
+			 ep_index);
+		xhci_acknowledge_event(ctrl);
+		return true;
+	}
+
+	urb->actual_length = max(0, urb->transfer_buffer_length -
+				    (int)EVENT_TRB_LEN(len));
+
+	status = xhci_urb_status(event);
+	xhci_giveback_urb(ctrl, ep, urb, status);
+
+	if (status) {
+		/*
+		 * The endpoint halted, the transfers behind this one won't
+		 * complete. The ring is reset on the next submission.
+		 */
+		ep->ep_state |= EP_HALTED;
+		list_for_each_entry_safe(urb, tmp, &ep->urb_list, urb_list)
+			xhci_giveback_urb(ctrl, ep, urb, -ECONNRESET);
+	}
+
+	xhci_acknowledge_event(ctrl);
+
+	return true;
+}
+
 /**
  * Waits for a specific type of event and returns it. Discards unexpected
  * events. Caller *must* call xhci_acknowledge_event() after it is finished
@@ -449,6 +548,11 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected,
 			continue;
 
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+
+		/* asynchronous transfers may complete anytime */
+		if (type == TRB_TRANSFER && xhci_urb_event(ctrl, event))
+			continue;
+
 		if (type == expected)
 			return event;
 
@@ -479,11 +583,25 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected,
  * (Careful: This will BUG() when there was no transfer in progress. Shouldn't
  * happen in practice for current uses and is too complicated to fix right now.)
  */
-static void abort_td(struct usb_device *udev, int ep_index)
+static void set_deq_to_enqueue(struct usb_device *udev, int ep_index)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
 	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
 	union xhci_trb *event;
+
+	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
+		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
+	event = xhci_wait_for_event(ctrl, TRB_COMPLETION, XHCI_TIMEOUT_DEFAULT);
+	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
+		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
+		event->event_cmd.status)) != COMP_SUCCESS);
+	xhci_acknowledge_event(ctrl);
+}
+
+static void abort_td(struct usb_device *udev, int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	union xhci_trb *event;
 	u32 field;
 
 	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
@@ -502,13 +620,7 @@ static void abort_td(struct usb_device *udev, int ep_index)
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
 
-	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
-		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
-	event = xhci_wait_for_event(ctrl, TRB_COMPLETION, XHCI_TIMEOUT_DEFAULT);
-	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
-		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
-		event->event_cmd.status)) != COMP_SUCCESS);
-	xhci_acknowledge_event(ctrl);
+	set_deq_to_enqueue(udev, ep_index);
 }
 
 static void record_transfer_result(struct usb_device *udev,
@@ -602,6 +714,12 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	ep_index = usb_pipe_ep_index(pipe);
 	virt_dev = ctrl->devs[slot_id];
 
+	/* the transfer event could not be told apart from the queued ones */
+	if (!list_empty(&virt_dev->eps[ep_index].urb_list)) {
+		dma_unmap_single(ctrl->host.hw_dev, map, length, direction);
+		return -EBUSY;
+	}
+
 	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
 			 virt_dev->out_ctx->size);
 
@@ -748,6 +866,195 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
 
+/**** Asynchronous bulk transfers ****/
+
+/*
+ * Restarts a halted endpoint and throws away the TRBs of the transfers
+ * which were queued when it halted.
+ */
+static int xhci_reset_ep(struct usb_device *udev, int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	union xhci_trb *event;
+	u32 comp;
+
+	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_RESET_EP);
+	event = xhci_wait_for_event(ctrl, TRB_COMPLETION, XHCI_TIMEOUT_DEFAULT);
+	comp = GET_COMP_CODE(le32_to_cpu(event->event_cmd.status));
+	xhci_acknowledge_event(ctrl);
+
+	if (comp != COMP_SUCCESS) {
+		dev_err(&udev->dev, "failed to reset ep %d: %u\n", ep_index,
+			comp);
+		return -EIO;
+	}
+
+	set_deq_to_enqueue(udev, ep_index);
+	ep->ep_state &= ~EP_HALTED;
+
+	return 0;
+}
+
+/**
+ * Queues up an asynchronous BULK transfer
+ *
+ * Unlike xhci_bulk_tx() this does not use the bounce buffer, so the
+ * transfer buffer must not cross a 64KiB boundary.
+ *
+ * @param urb	the transfer
+ * @return 0 if successful else error code on failure
+ */
+int xhci_submit_urb(struct usb_urb *urb)
+{
+	struct usb_device *udev = urb->dev;
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	unsigned long pipe = urb->pipe;
+	int length = urb->transfer_buffer_length;
+	int ep_index = usb_pipe_ep_index(pipe);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_virt_ep *ep = &virt_dev->eps[ep_index];
+	struct xhci_ring *ring = ep->ring;
+	enum dma_data_direction direction;
+	struct xhci_generic_trb *start_trb;
+	struct xhci_ep_ctx *ep_ctx;
+	u32 trb_fields[4];
+	u32 remainder = 0;
+	int start_cycle;
+	int ret;
+	u64 addr;
+
+	if (usb_pipetype(pipe) != PIPE_BULK)
+		return -EINVAL;
+
+	if (ep->num_urbs >= XHCI_URBS_PER_EP)
+		return -EBUSY;
+
+	if (ep->ep_state & EP_HALTED) {
+		ret = xhci_reset_ep(udev, ep_index);
+		if (ret)
+			return ret;
+	}
+
+	direction = usb_pipein(pipe) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	addr = urb->transfer_dma = dma_map_single(ctrl->host.hw_dev,
+						  urb->transfer_buffer,
+						  length, direction);
+	if (dma_mapping_error(ctrl->host.hw_dev, urb->transfer_dma))
+		return -EFAULT;
+
+	/* one TRB per transfer, see the comment in xhci_bulk_tx() */
+	if (length > TRB_MAX_BUFF_SIZE -
+		     (lower_32_bits(addr) & (TRB_MAX_BUFF_SIZE - 1))) {
+		ret = -EINVAL;
+		goto err_unmap;
+	}
+
+	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
+
+	ret = prepare_ring(ctrl, ring,
+			   le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK);
+	if (ret < 0)
+		goto err_unmap;
+
+	start_trb = &ring->enqueue->generic;
+	start_cycle = ring->cycle_state;
+
+	/* the TD size of the last TRB is zero since xHCI 1.0 */
+	if (HC_VERSION(xhci_readl(&ctrl->hccr->cr_capbase)) < 0x100)
+		remainder = xhci_td_remainder(length);
+
+	trb_fields[0] = lower_32_bits(addr);
+	trb_fields[1] = upper_32_bits(addr);
+	trb_fields[2] = (length & TRB_LEN_MASK) | remainder;
+	trb_fields[3] = TRB_IOC | (TRB_NORMAL << TRB_TYPE_SHIFT);
+
+	/* Don't give the TRB to the hardware before it is complete */
+	if (start_cycle == 0)
+		trb_fields[3] |= TRB_CYCLE;
+
+	/* Only set interrupt on short packet for IN endpoints */
+	if (usb_pipein(pipe))
+		trb_fields[3] |= TRB_ISP;
+
+	queue_trb(ctrl, ring, false, trb_fields);
+
+	urb->hcpriv = start_trb;
+	urb->status = -EINPROGRESS;
+	list_add_tail(&urb->urb_list, &ep->urb_list);
+	ep->num_urbs++;
+
+	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+
+	return 0;
+
+err_unmap:
+	dma_unmap_single(ctrl->host.hw_dev, urb->transfer_dma, length,
+			 direction);
+
+	return ret;
+}
+
+/**
+ * Moves the completed asynchronous transfers to @done
+ *
+ * @param host	the USB host
+ * @param done	list to add the completed URBs to
+ * @return none
+ */
+void xhci_poll_urbs(struct usb_host *host, struct list_head *done)
+{
+	struct xhci_ctrl *ctrl = to_xhci(host);
+
+	while (event_ready(ctrl)) {
+		union xhci_trb *event = ctrl->event_ring->dequeue;
+		trb_type type;
+
+		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		if (type == TRB_TRANSFER && xhci_urb_event(ctrl, event))
+			continue;
+
+		/* nobody is waiting for it, see xhci_wait_for_event() */
+		xhci_acknowledge_event(ctrl);
+	}
+
+	list_splice_tail_init(&ctrl->urb_done, done);
+}
+
+/**
+ * Cancels an asynchronous transfer. Stopping the endpoint throws away
+ * all TRBs on its ring, so the other queued transfers are cancelled too.
+ *
+ * @param urb	the transfer
+ * @param done	list to add the completed and cancelled URBs to
+ * @return none
+ */
+void xhci_kill_urb(struct usb_urb *urb, struct list_head *done)
+{
+	struct usb_device *udev = urb->dev;
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(urb->pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct usb_urb *u, *tmp;
+
+	xhci_poll_urbs(&ctrl->host, done);
+
+	if (urb->status != -EINPROGRESS)
+		return;
+
+	if (!(ep->ep_state & EP_HALTED))
+		abort_td(udev, ep_index);
+
+	list_for_each_entry_safe(u, tmp, &ep->urb_list, urb_list)
+		xhci_giveback_urb(ctrl, ep, u,
+				  u == urb ? -ENOENT : -ECONNRESET);
+
+	list_splice_tail_init(&ctrl->urb_done, done);
+}
+
 /**
  * Queues up the Control Transfer Request
  *
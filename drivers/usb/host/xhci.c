@@ -1350,6 +1350,7 @@ int xhci_register(struct xhci_ctrl *ctrl)
 	dev_dbg(dev, "%s: hccr=%p, hcor=%p\n", __func__, ctrl->hccr, ctrl->hcor);
 
 	host = &ctrl->host;
+	INIT_LIST_HEAD(&ctrl->urb_done);
 
 	/*
 	 * XHCI needs to issue a Address device command to setup
@@ -1367,6 +1368,11 @@ int xhci_register(struct xhci_ctrl *ctrl)
 	host->submit_int_msg = xhci_submit_int_msg;
 	host->submit_control_msg = xhci_submit_control_msg;
 	host->submit_bulk_msg = xhci_submit_bulk_msg;
+	if (IS_ENABLED(CONFIG_USB_HOST_URB)) {
+		host->submit_urb = xhci_submit_urb;
+		host->kill_urb = xhci_kill_urb;
+		host->poll_urbs = xhci_poll_urbs;
+	}
 	host->alloc_device = xhci_alloc_device;
 	host->update_hub_device = xhci_update_hub_device;
 
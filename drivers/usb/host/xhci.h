@@ -1066,8 +1066,14 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* Asynchronous transfers in the order they are on the ring */
+	struct list_head		urb_list;
+	unsigned int			num_urbs;
 };
 
+/* One TRB each, so they always fit on a single segment ring */
+#define XHCI_URBS_PER_EP	16
+
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
 
 struct xhci_virt_device {
@@ -1218,6 +1224,8 @@ struct xhci_ctrl {
 	struct xhci_virt_device *devs[MAX_HC_SLOTS];
 	void *bounce_buffer;
 	int rootdev;
+	/* completed asynchronous transfers, see xhci_poll_urbs() */
+	struct list_head urb_done;
 };
 
 static inline struct xhci_ctrl *to_xhci(struct usb_host *host)
@@ -1252,6 +1260,9 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer, unsigned int timeout_ms);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer, unsigned int timeout_ms);
+int xhci_submit_urb(struct usb_urb *urb);
+void xhci_kill_urb(struct usb_urb *urb, struct list_head *done);
+void xhci_poll_urbs(struct usb_host *host, struct list_head *done);
 int xhci_check_maxpacket(struct usb_device *udev);
 void xhci_flush_cache(uintptr_t addr, u32 type_len);
 void xhci_inval_cache(uintptr_t addr, u32 type_len);
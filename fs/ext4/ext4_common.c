@@ -145,12 +145,131 @@ static int ext4fs_get_indir_block(struct ext2fs_node *node,
 	if (ret) {
 		dev_err(fs->dev, "** SI ext2fs read block (indir 1)"
 			"failed. **\n");
+		indir->blkno = 0;
 		return ret;
 	}
 
+	indir->blkno = blkno;
+
+	return 0;
+}
+
+/*
+ * Look up the extent covering @fileblock and store it in the extent
+ * cache of @node. Holes are stored as extents starting at block 0.
+ */
+static int ext4fs_lookup_extent(struct ext2fs_node *node, uint32_t fileblock)
+{
+	struct ext4_extent_cache *ec = &node->ext_cache;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	char *buf;
+	int i;
+
+	buf = zalloc(EXT2_BLOCK_SIZE(node->data));
+	if (!buf)
+		return -ENOMEM;
+
+	ext_block = ext4fs_get_extent_block(node->data, buf,
+			(struct ext4_extent_header *)node->inode.b.blocks.dir_blocks,
+			fileblock, LOG2_EXT2_BLOCK_SIZE(node->data));
+	if (!ext_block) {
+		pr_err("invalid extent block\n");
+		free(buf);
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	/* Behind the last extent of this leaf */
+	ec->block = fileblock;
+	ec->len = 1;
+	ec->start = 0;
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		uint32_t startblock = le32_to_cpu(extent[i].ee_block);
+		uint32_t len = le16_to_cpu(extent[i].ee_len);
+		bool uninit = false;
+
+		if (len > EXT4_EXT_INIT_MAX_LEN) {
+			len -= EXT4_EXT_INIT_MAX_LEN;
+			uninit = true;
+		}
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			ec->len = startblock - fileblock;
+			break;
+		}
+
+		if (fileblock - startblock < len) {
+			ec->block = startblock;
+			ec->len = len;
+
+			/* Uninitialized extents read back as zeroes */
+			if (!uninit) {
+				ec->start = le16_to_cpu(extent[i].ee_start_hi);
+				ec->start = (ec->start << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+			}
+			break;
+		}
+	}
+
+	free(buf);
+
 	return 0;
 }
 
+/**
+ * ext4fs_map_blocks - map a run of file blocks to filesystem blocks
+ * @node: The file
+ * @fileblock: The first logical block to map
+ * @maxblocks: The maximum number of blocks to map
+ * @blknr: Returns the filesystem block @fileblock is stored in, 0 for holes
+ *
+ * Return: The number of blocks following @fileblock which are either
+ * contiguous on disk or all part of the same hole, negative error code
+ * otherwise.
+ */
+long ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		       uint32_t maxblocks, sector_t *blknr)
+{
+	long ret, n;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		struct ext4_extent_cache *ec = &node->ext_cache;
+
+		if (!ec->len || fileblock < ec->block ||
+		    fileblock - ec->block >= ec->len) {
+			ret = ext4fs_lookup_extent(node, fileblock);
+			if (ret)
+				return ret;
+		}
+
+		n = ec->len - (fileblock - ec->block);
+		*blknr = ec->start ? ec->start + (fileblock - ec->block) : 0;
+
+		return min_t(long, n, maxblocks);
+	}
+
+	ret = read_allocated_block(node, fileblock);
+	if (ret < 0)
+		return ret;
+
+	*blknr = ret;
+
+	for (n = 1; n < maxblocks; n++) {
+		ret = read_allocated_block(node, fileblock + n);
+		if (ret < 0)
+			break;	/* reported when the caller gets here */
+		if (*blknr ? ret != *blknr + n : ret != 0)
+			break;
+	}
+
+	return n;
+}
+
 long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 {
 	long int blknr;
@@ -159,7 +278,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
 	int ret;
@@ -169,47 +287,13 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (!buf)
-			return -ENOMEM;
-
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
-			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-			}
+		sector_t start;
 
-			if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
+		ret = ext4fs_map_blocks(node, fileblock, 1, &start);
+		if (ret < 0)
+			return ret;
 
-		free(buf);
-		return 0;
+		return start;
 	}
 
 	if (fileblock < INDIRECT_BLOCKS) {
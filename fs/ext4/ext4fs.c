@@ -43,21 +43,19 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Resolves the requested range into runs of blocks which are contiguous
+ * on disk and reads each run with a single device access.
  */
 loff_t ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		unsigned int len, char *buf)
 {
-	loff_t i;
-	blkcnt_t blockcnt;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE(node->data);
 	const int blockshift = log2blocksize + DISK_SECTOR_BITS;
 	const int blocksize = 1 << blockshift;
 	loff_t filesize = ext4_isize(node);
-	ssize_t ret;
 	struct ext_filesystem *fs = node->data->fs;
+	unsigned int done = 0;
+	long ret;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
@@ -66,44 +64,30 @@ loff_t ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	if (filesize <= pos)
 		return -EINVAL;
 
-	blockcnt = ((len + pos) + blocksize - 1) >> blockshift;
-
-	for (i = pos >> blockshift; i < blockcnt; i++) {
+	while (done < len) {
+		loff_t cur = pos + done;
+		unsigned int skip = cur & (blocksize - 1);
+		uint32_t nblocks = DIV_ROUND_UP(skip + len - done, blocksize);
 		sector_t blknr;
-		loff_t blockoff = pos - (blocksize * i);
-		loff_t blockend = blocksize;
-		loff_t skipfirst = 0;
+		size_t now;
 
-		ret = read_allocated_block(node, i);
+		ret = ext4fs_map_blocks(node, cur >> blockshift, nblocks, &blknr);
 		if (ret < 0)
 			return ret;
 
-		blknr = ret << log2blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == pos >> blockshift) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		now = min_t(size_t, ((size_t)ret << blockshift) - skip,
+			    len - done);
 
 		if (blknr) {
-			ret = ext4fs_devread(fs, blknr, skipfirst, blockend, buf);
+			ret = ext4fs_devread(fs, blknr << log2blocksize, skip,
+					     now, buf + done);
 			if (ret)
 				return ret;
 		} else {
-			memset(buf, 0, blockend);
+			memset(buf + done, 0, now);
 		}
 
-		buf += blocksize - skipfirst;
+		done += now;
 	}
 
 	return len;
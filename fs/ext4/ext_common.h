@@ -209,17 +209,25 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* The extent (or hole) ext4fs_map_blocks() found last */
+struct ext4_extent_cache {
+	uint32_t block;		/* first logical block */
+	uint32_t len;		/* number of blocks, 0 if invalid */
+	sector_t start;		/* first physical block, 0 for holes */
+};
+
 struct ext2fs_node {
 	struct inode i;
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext4_extent_cache ext_cache;
 };
 
 struct ext4fs_indir_block {
 	int size;
-	int blkno;
+	sector_t blkno;
 	uint32_t *data;
 };
 
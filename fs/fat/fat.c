@@ -36,7 +36,7 @@ struct fat_priv {
 
 /* ---------------------------------------------------------------*/
 
-DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, UINT count)
 {
 	struct fat_priv *priv = fat->userdata;
 	int ret;
@@ -50,7 +50,7 @@ DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
 	return 0;
 }
 
-DRESULT disk_write(FATFS *fat, const BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_write(FATFS *fat, const BYTE *buf, DWORD sector, UINT count)
 {
 	struct fat_priv *priv = fat->userdata;
 	int ret;
@@ -370,6 +370,122 @@ static DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster
 
 
 
+#if _USE_FASTSEEK
+/*
+ * Create the cluster link map of a file. It holds the runs of contiguous
+ * clusters as (number of clusters, first cluster) pairs and is terminated
+ * by a zero length.
+ */
+static int create_cltbl (
+	FIL *fp		/* Pointer to the file object */
+)
+{
+	FATFS *fs = fp->fs;
+	DWORD *tbl = NULL, *ntbl;
+	DWORD cl, ncl, start, len, left;
+	UINT ulen = 0, size = 0;
+
+	/* Number of clusters the file occupies */
+	left = (fp->fsize + (DWORD)fs->csize * SS(fs) - 1) / fs->csize / SS(fs);
+
+	cl = fp->sclust;
+	while (left && cl >= 2 && cl < fs->n_fatent) {
+		start = cl;
+		len = 0;
+		for (;;) {	/* Follow the chain as long as it is contiguous */
+			len++;
+			if (len == left) {
+				ncl = 0;
+				break;
+			}
+			ncl = get_fat(fs, cl);
+			if (ncl == 0xFFFFFFFF) {
+				free(tbl);
+				return -EIO;
+			}
+			if (ncl != cl + 1)
+				break;
+			cl = ncl;
+		}
+
+		if (ulen + 3 > size) {
+			size = size ? size * 2 : 8;
+			ntbl = realloc(tbl, size * sizeof(*tbl));
+			if (!ntbl) {
+				free(tbl);
+				return -ENOMEM;
+			}
+			tbl = ntbl;
+		}
+
+		tbl[ulen++] = len;
+		tbl[ulen++] = start;
+		left -= len;
+		cl = ncl;
+	}
+
+	if (!tbl)
+		return -EINVAL;
+
+	tbl[ulen] = 0;
+	fp->cltbl = tbl;
+
+	return 0;
+}
+
+/*
+ * Check whether the cluster link map can be used, create it if needed.
+ * It is only used for files not opened for writing, whose cluster chain
+ * stays the same.
+ */
+static int use_cltbl (
+	FIL *fp		/* Pointer to the file object */
+)
+{
+	if (fp->cltbl)
+		return 1;
+	if (fp->cltbl_failed || (fp->flag & FA_WRITE))
+		return 0;
+	if (fp->fsize <= (DWORD)fp->fs->csize * SS(fp->fs))
+		return 0;	/* A single cluster has no chain to follow */
+
+	if (create_cltbl(fp)) {
+		fp->cltbl_failed = 1;	/* Follow the chain from now on */
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Get the cluster of a file offset from the cluster link map
+ */
+static DWORD clmt_clust (	/* 0: offset beyond the map, else: cluster# */
+	FIL *fp,	/* Pointer to the file object */
+	DWORD ofs,	/* File offset */
+	DWORD *ncont	/* Returns the number of contiguous clusters from here on */
+)
+{
+	DWORD cl, ncl, *tbl = fp->cltbl;
+
+	cl = ofs / SS(fp->fs) / fp->fs->csize;	/* Cluster offset from top of the file */
+	for (;;) {
+		ncl = *tbl++;
+		if (!ncl)
+			return 0;
+		if (cl < ncl)
+			break;
+		cl -= ncl;
+		tbl++;
+	}
+
+	if (ncont)
+		*ncont = ncl - cl;
+
+	return cl + *tbl;
+}
+#endif
+
 /*
  * FAT access - Change value of a FAT entry
  */
@@ -1813,6 +1929,10 @@ int f_open (
 		fp->fptr = 0;			/* File pointer */
 		fp->dsect = 0;
 		fp->fs = dj.fs;
+#if _USE_FASTSEEK
+		fp->cltbl = NULL;
+		fp->cltbl_failed = 0;
+#endif
 	}
 
 	return res;
@@ -1853,6 +1973,11 @@ int f_read (
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->sclust;	/* Follow from the origin */
 				} else {			/* Middle or end of the file */
+#if _USE_FASTSEEK
+					if (use_cltbl(fp))
+						clst = clmt_clust(fp, fp->fptr, NULL);	/* Get cluster from the link map */
+					else
+#endif
 						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
 				}
 				if (clst < 2)
@@ -1867,10 +1992,19 @@ int f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);		/* When remaining bytes >= sector size, */
 			if (cc) {			/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs, rbuff, sect, (BYTE)cc) != RES_OK)
+				UINT maxsect = fp->fs->csize;
+#if _USE_FASTSEEK
+				DWORD ncont;
+
+				/* Read across contiguous clusters */
+				if (fp->cltbl && clmt_clust(fp, fp->fptr, &ncont))
+					maxsect *= ncont;
+#endif
+				if (csect + cc > maxsect)	/* Clip at cluster boundary */
+					cc = maxsect - csect;
+				if (disk_read(fp->fs, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
+				fp->clust += (csect + cc - 1) / fp->fs->csize;	/* Last cluster read */
 #if defined FS_FAT_WRITE
 				/* Replace one of the read sectors with cached data if it contains a dirty sector */
 				if ((fp->flag & FA__DIRTY) && fp->dsect - sect < cc)
@@ -2054,18 +2188,21 @@ int f_close (
 	FIL *fp		/* Pointer to the file object to be closed */
 )
 {
-#ifndef FS_FAT_WRITE
-	fp->fs = 0;	/* Discard file object */
-	return 0;
-#else
+#ifdef FS_FAT_WRITE
 	int res;
 
 	/* Flush cached data */
 	res = f_sync(fp);
-	if (res == 0)
-		fp->fs = NULL;	/* Discard file object */
-	return res;
+	if (res)
+		return res;
 #endif
+#if _USE_FASTSEEK
+	free(fp->cltbl);
+	fp->cltbl = NULL;
+#endif
+	fp->fs = NULL;	/* Discard file object */
+
+	return 0;
 }
 
 /*
@@ -2088,6 +2225,29 @@ int f_lseek (
 #endif
 		) ofs = fp->fsize;
 
+#if _USE_FASTSEEK
+	/* Seeks within the first cluster don't need the link map */
+	if (fp->cltbl ||
+	    (ofs > (DWORD)fp->fs->csize * SS(fp->fs) && use_cltbl(fp))) {
+		fp->fptr = ofs;
+		if (!ofs)
+			return 0;
+
+		fp->clust = clmt_clust(fp, ofs - 1, NULL);
+		nsect = clust2sect(fp->fs, fp->clust);
+		if (!nsect)
+			ABORT(fp->fs, -ERESTARTSYS);
+		nsect += (ofs - 1) / SS(fp->fs) & (fp->fs->csize - 1);
+		if (fp->fptr % SS(fp->fs) && nsect != fp->dsect) {
+			/* Fill sector cache, the file is not written to */
+			if (disk_read(fp->fs, fp->buf, nsect, 1) != RES_OK)
+				ABORT(fp->fs, -EIO);
+			fp->dsect = nsect;
+		}
+		return 0;
+	}
+#endif
+
 	ifptr = fp->fptr;
 	fp->fptr = nsect = 0;
 	if (ofs) {
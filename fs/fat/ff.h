@@ -27,6 +27,10 @@
 #define FS_FAT_WRITE 1
 #endif
 
+#ifdef CONFIG_FS_FAT_FASTSEEK
+#define FS_FAT_FASTSEEK 1
+#endif
+
 #endif
 
 #include <asm/unaligned.h>
@@ -109,7 +113,8 @@ typedef struct {
 	BYTE*	dir_ptr;	/* Ponter to the directory entry in the window */
 #endif
 #if _USE_FASTSEEK
-	DWORD*	cltbl;		/* Pointer to the cluster link map table (null on file open) */
+	DWORD*	cltbl;		/* Pointer to the cluster link map table (built on demand) */
+	BYTE	cltbl_failed;	/* Building the link map failed, don't retry */
 #endif
 #if _FS_SHARE
 	UINT	lockid;		/* File lock ID (index of file semaphore table) */
@@ -0,0 +1,520 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * http.c - read-only filesystem on top of HTTP/1.0
+ *
+ * Every opened file is fetched with its own GET request. Seeking forward
+ * by a small amount skips the data, everything else reopens the file with
+ * a Range request.
+ */
+
+#define pr_fmt(fmt) "http: " fmt
+
+#include <common.h>
+#include <net.h>
+#include <driver.h>
+#include <fs.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <init.h>
+#include <malloc.h>
+#include <parseopt.h>
+#include <linux/ctype.h>
+#include <linux/err.h>
+#include <linux/stat.h>
+#include <linux/sizes.h>
+
+#define HTTP_PORT	80
+
+/* buffer for the request and the response headers */
+#define HTTP_BUF_SIZE	SZ_4K
+
+/* seek forward by reading the data up to this distance */
+#define HTTP_SKIP_MAX	SZ_64K
+
+struct http_priv {
+	IPaddr_t server;
+	unsigned short port;
+};
+
+struct file_priv {
+	struct http_priv *hpriv;
+	const char *host;
+	char *path;
+	struct tcp_connection *tcp;
+	loff_t pos;		/* position of the next byte received */
+	loff_t size;		/* FILE_SIZE_STREAM when unknown */
+	char *buf;
+	unsigned int buf_start;	/* body bytes received with the headers */
+	unsigned int buf_len;
+	bool dir_redirect;	/* Location: of a redirect ends in '/' */
+};
+
+static int http_status_to_errno(int status)
+{
+	switch (status) {
+	case 401:
+	case 403:
+		return -EACCES;
+	case 404:
+	case 410:
+		return -ENOENT;
+	default:
+		return -EIO;
+	}
+}
+
+/* percent-encode everything but unreserved characters and slashes */
+static int http_escape_path(char *dst, size_t size, const char *path)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	size_t n = 0;
+
+	for (; *path; path++) {
+		unsigned char c = *path;
+
+		if (isalnum(c) || strchr("/-._~", c)) {
+			if (n + 1 >= size)
+				return -ENAMETOOLONG;
+			dst[n++] = c;
+		} else {
+			if (n + 3 >= size)
+				return -ENAMETOOLONG;
+			dst[n++] = '%';
+			dst[n++] = hex[c >> 4];
+			dst[n++] = hex[c & 0xf];
+		}
+	}
+
+	dst[n] = 0;
+
+	return n;
+}
+
+static void http_disconnect(struct file_priv *priv)
+{
+	if (priv->tcp)
+		tcp_close(priv->tcp);
+	priv->tcp = NULL;
+	priv->buf_len = 0;
+}
+
+/*
+ * Send a request for the file starting at @offset and parse the response
+ * headers. Returns the HTTP status code or a negative error code.
+ */
+static int http_request(struct file_priv *priv, const char *method,
+			loff_t offset)
+{
+	struct http_priv *hpriv = priv->hpriv;
+	char *buf = priv->buf, *p, *end;
+	unsigned int len = 0;
+	int ret, status;
+	loff_t content_length = FILE_SIZE_STREAM;
+
+	http_disconnect(priv);
+
+	len = snprintf(buf, HTTP_BUF_SIZE, "%s ", method);
+	ret = http_escape_path(buf + len, HTTP_BUF_SIZE - len, priv->path);
+	if (ret < 0)
+		return ret;
+	len += ret;
+
+	len += snprintf(buf + len, HTTP_BUF_SIZE - len,
+			" HTTP/1.0\r\nHost: %s", priv->host);
+	if (hpriv->port != HTTP_PORT)
+		len += snprintf(buf + len, HTTP_BUF_SIZE - len, ":%u",
+				hpriv->port);
+	len += snprintf(buf + len, HTTP_BUF_SIZE - len,
+			"\r\n"
+			"User-Agent: barebox\r\n"
+			"Connection: close\r\n");
+	if (offset)
+		len += snprintf(buf + len, HTTP_BUF_SIZE - len,
+				"Range: bytes=%lld-\r\n", offset);
+	len += snprintf(buf + len, HTTP_BUF_SIZE - len, "\r\n");
+	if (len >= HTTP_BUF_SIZE)
+		return -ENAMETOOLONG;
+
+	priv->tcp = tcp_connect(hpriv->server, hpriv->port);
+	if (IS_ERR(priv->tcp)) {
+		ret = PTR_ERR(priv->tcp);
+		priv->tcp = NULL;
+		return ret;
+	}
+
+	ret = tcp_send(priv->tcp, buf, len);
+	if (ret < 0)
+		goto err;
+
+	/* receive until the end of the headers */
+	len = 0;
+	while (1) {
+		ret = tcp_recv(priv->tcp, buf + len, HTTP_BUF_SIZE - 1 - len);
+		if (ret < 0)
+			goto err;
+		if (!ret) {
+			ret = -EPROTO;
+			goto err;
+		}
+
+		len += ret;
+		buf[len] = 0;
+
+		end = strstr(buf, "\r\n\r\n");
+		if (end)
+			break;
+
+		if (len == HTTP_BUF_SIZE - 1) {
+			pr_err("response headers too long\n");
+			ret = -EPROTO;
+			goto err;
+		}
+	}
+
+	*end = 0;
+	priv->buf_start = end + 4 - buf;
+	priv->buf_len = len - priv->buf_start;
+
+	if (strncmp(buf, "HTTP/1.", 7) || !isspace(buf[8])) {
+		ret = -EPROTO;
+		goto err;
+	}
+
+	status = simple_strtoul(buf + 9, NULL, 10);
+
+	for (p = strstr(buf, "\r\n"); p; p = strstr(p, "\r\n")) {
+		p += 2;
+		if (!strncasecmp(p, "Content-Length:", 15))
+			content_length = simple_strtoull(skip_spaces(p + 15),
+							 NULL, 10);
+		if (!strncasecmp(p, "Location:", 9)) {
+			char *eol = strstr(p, "\r\n");
+
+			if (!eol)
+				eol = p + strlen(p);
+			priv->dir_redirect = eol[-1] == '/';
+		}
+	}
+
+	pr_debug("%s %s: %d, length %lld\n", method, priv->path, status,
+		 content_length);
+
+	if (status == 206) {
+		priv->pos = offset;
+	} else {
+		/* the server ignored the range and sends the whole file */
+		priv->pos = 0;
+		offset = 0;
+	}
+
+	if (content_length != FILE_SIZE_STREAM)
+		priv->size = offset + content_length;
+	else
+		priv->size = FILE_SIZE_STREAM;
+
+	return status;
+err:
+	http_disconnect(priv);
+
+	return ret;
+}
+
+/* receive body data, at most @len bytes */
+static int http_recv(struct file_priv *priv, void *buf, size_t len)
+{
+	int ret;
+
+	if (!priv->tcp)
+		return 0;
+
+	if (priv->size != FILE_SIZE_STREAM)
+		len = min_t(loff_t, len, priv->size - priv->pos);
+	if (!len)
+		return 0;
+
+	if (priv->buf_len) {
+		ret = min_t(size_t, len, priv->buf_len);
+		if (buf)
+			memcpy(buf, priv->buf + priv->buf_start, ret);
+		priv->buf_start += ret;
+		priv->buf_len -= ret;
+	} else {
+		ret = tcp_recv(priv->tcp, buf ?: priv->buf,
+			       buf ? len : min_t(size_t, len, HTTP_BUF_SIZE));
+		if (ret < 0)
+			return ret;
+	}
+
+	priv->pos += ret;
+
+	return ret;
+}
+
+/* discard data up to @pos, returns -EINVAL when the file ends before */
+static int http_skip(struct file_priv *priv, loff_t pos)
+{
+	int ret;
+
+	while (priv->pos < pos) {
+		ret = http_recv(priv, NULL, min_t(loff_t, pos - priv->pos,
+						   HTTP_BUF_SIZE));
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int http_seek(struct file_priv *priv, loff_t pos)
+{
+	int ret;
+
+	if (pos == priv->pos)
+		return 0;
+
+	if (priv->size != FILE_SIZE_STREAM && pos >= priv->size) {
+		/* nothing left to receive */
+		http_disconnect(priv);
+		priv->pos = pos;
+		return 0;
+	}
+
+	if (priv->tcp && pos > priv->pos && pos - priv->pos <= HTTP_SKIP_MAX)
+		return http_skip(priv, pos);
+
+	ret = http_request(priv, "GET", pos);
+	if (ret < 0)
+		return ret;
+	if (ret != 200 && ret != 206) {
+		http_disconnect(priv);
+		return http_status_to_errno(ret);
+	}
+
+	return http_skip(priv, pos);
+}
+
+static void http_free(struct file_priv *priv)
+{
+	http_disconnect(priv);
+	free(priv->path);
+	free(priv->buf);
+	free(priv);
+}
+
+static struct file_priv *http_do_open(struct device *dev, struct dentry *dentry,
+				      const char *method, int *status)
+{
+	struct fs_device *fsdev = dev_to_fs_device(dev);
+	struct file_priv *priv;
+	int ret;
+
+	priv = xzalloc(sizeof(*priv));
+	priv->hpriv = dev->priv;
+	priv->host = fsdev->backingstore;
+	priv->path = dpath(dentry, fsdev->vfsmount.mnt_root);
+	priv->buf = xmalloc(HTTP_BUF_SIZE);
+
+	ret = http_request(priv, method, 0);
+	if (ret < 0) {
+		http_free(priv);
+		return ERR_PTR(ret);
+	}
+
+	*status = ret;
+
+	return priv;
+}
+
+static int http_open(struct device *dev, FILE *file, const char *filename)
+{
+	struct file_priv *priv;
+	int status;
+
+	if ((file->flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+
+	priv = http_do_open(dev, file->dentry, "GET", &status);
+	if (IS_ERR(priv))
+		return PTR_ERR(priv);
+
+	if (status != 200) {
+		http_free(priv);
+		return http_status_to_errno(status);
+	}
+
+	file->priv = priv;
+
+	return 0;
+}
+
+static int http_close(struct device *dev, FILE *f)
+{
+	http_free(f->priv);
+
+	return 0;
+}
+
+static int http_read(struct device *dev, FILE *f, void *buf, size_t insize)
+{
+	struct file_priv *priv = f->priv;
+	size_t outsize = 0;
+	int ret;
+
+	/* pread() changes the position without telling us */
+	ret = http_seek(priv, f->pos);
+	if (ret < 0)
+		return ret;
+
+	while (insize) {
+		ret = http_recv(priv, buf, insize);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			break;
+
+		outsize += ret;
+		buf += ret;
+		insize -= ret;
+	}
+
+	return outsize;
+}
+
+static int http_lseek(struct device *dev, FILE *f, loff_t pos)
+{
+	return http_seek(f->priv, pos);
+}
+
+static const struct inode_operations http_dir_inode_operations;
+static const struct file_operations http_file_operations;
+
+static struct inode *http_get_inode(struct super_block *sb, umode_t mode)
+{
+	struct inode *inode = new_inode(sb);
+
+	if (!inode)
+		return NULL;
+
+	inode->i_ino = get_next_ino();
+	inode->i_mode = mode;
+
+	switch (mode & S_IFMT) {
+	default:
+		return NULL;
+	case S_IFREG:
+		inode->i_fop = &http_file_operations;
+		break;
+	case S_IFDIR:
+		inode->i_op = &http_dir_inode_operations;
+		inode->i_fop = &simple_dir_operations;
+		inc_nlink(inode);
+		break;
+	}
+
+	return inode;
+}
+
+static struct dentry *http_lookup(struct inode *dir, struct dentry *dentry,
+				  unsigned int flags)
+{
+	struct super_block *sb = dir->i_sb;
+	struct fs_device *fsdev = container_of(sb, struct fs_device, sb);
+	struct file_priv *priv;
+	struct inode *inode;
+	loff_t size;
+	bool dir_redirect;
+	int status;
+
+	priv = http_do_open(&fsdev->dev, dentry, "HEAD", &status);
+	if (IS_ERR(priv))
+		return NULL;
+
+	size = priv->size;
+	dir_redirect = priv->dir_redirect;
+
+	http_free(priv);
+
+	/* servers redirect directory names to the name with a trailing slash */
+	if (status >= 300 && status < 400 && dir_redirect)
+		inode = http_get_inode(sb, S_IFDIR | 0555);
+	else if (status >= 200 && status < 300)
+		inode = http_get_inode(sb, S_IFREG | 0444);
+	else
+		return NULL;
+
+	if (!inode)
+		return ERR_PTR(-ENOMEM);
+
+	inode->i_size = size;
+
+	d_add(dentry, inode);
+
+	return NULL;
+}
+
+static const struct inode_operations http_dir_inode_operations = {
+	.lookup = http_lookup,
+};
+
+static const struct super_operations http_ops;
+
+static int http_probe(struct device *dev)
+{
+	struct fs_device *fsdev = dev_to_fs_device(dev);
+	struct http_priv *priv = xzalloc(sizeof(struct http_priv));
+	struct super_block *sb = &fsdev->sb;
+	struct inode *inode;
+	int ret;
+
+	dev->priv = priv;
+
+	ret = resolv(fsdev->backingstore, &priv->server);
+	if (ret) {
+		pr_err("Cannot resolve \"%s\": %s\n", fsdev->backingstore, strerror(-ret));
+		goto err;
+	}
+
+	priv->port = HTTP_PORT;
+	parseopt_hu(fsdev->options, "port", &priv->port);
+
+	sb->s_op = &http_ops;
+	sb->s_d_op = &no_revalidate_d_ops;
+
+	inode = http_get_inode(sb, S_IFDIR | 0555);
+	sb->s_root = d_make_root(inode);
+
+	return 0;
+err:
+	free(priv);
+
+	return ret;
+}
+
+static void http_remove(struct device *dev)
+{
+	struct http_priv *priv = dev->priv;
+
+	free(priv);
+}
+
+static struct fs_driver http_driver = {
+	.open      = http_open,
+	.close     = http_close,
+	.read      = http_read,
+	.lseek     = http_lseek,
+	.flags     = 0,
+	.drv = {
+		.probe  = http_probe,
+		.remove = http_remove,
+		.name = "http",
+	}
+};
+
+static int http_init(void)
+{
+	return register_fs_driver(&http_driver);
+}
+coredevice_initcall(http_init);
@@ -73,7 +73,7 @@ struct jffs2_file {
 #ifndef CONFIG_JFFS2_FS_WRITEBUFFER
 
 
-#ifdef CONFIG_JFFS2_SUMMARY
+#ifdef CONFIG_FS_JFFS2_SUMMARY
 #define jffs2_can_mark_obsolete(c) (0)
 #else
 #define jffs2_can_mark_obsolete(c) (1)
@@ -109,7 +109,7 @@ struct jffs2_file {
 
 #define jffs2_is_writebuffered(c) (c->wbuf != NULL)
 
-#ifdef CONFIG_JFFS2_SUMMARY
+#ifdef CONFIG_FS_JFFS2_SUMMARY
 #define jffs2_can_mark_obsolete(c) (0)
 #else
 #define jffs2_can_mark_obsolete(c) (c->mtd->flags & (MTD_BIT_WRITEABLE))
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright © 2004  Ferenc Havasi <havasi@inf.u-szeged.hu>,
+ *		     Zoltan Sogor <weth@inf.u-szeged.hu>,
+ *		     Patrik Kluba <pajko@halom.u-szeged.hu>,
+ *		     University of Szeged, Hungary
+ *	       2006  KaiGai Kohei <kaigai@ak.jp.nec.com>
+ *
+ * Reading of erase block summaries, as written by sumtool or by kernels
+ * with CONFIG_JFFS2_SUMMARY. The summary node at the end of an erase block
+ * lists all nodes in it, so the block can be indexed without reading it.
+ * barebox does not write to JFFS2, so summaries are never collected here.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <common.h>
+#include <crc.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/mtd/mtd.h>
+#include "nodelist.h"
+#include "summary.h"
+#include "debug.h"
+
+static struct jffs2_raw_node_ref *sum_link_node_ref(struct jffs2_sb_info *c,
+						    struct jffs2_eraseblock *jeb,
+						    uint32_t ofs, uint32_t len,
+						    struct jffs2_inode_cache *ic)
+{
+	/* If there was a gap, mark it dirty */
+	if ((ofs & ~3) > c->sector_size - jeb->free_size) {
+		/* Ew. Summary doesn't actually tell us explicitly about dirty space */
+		jffs2_scan_dirty_space(c, jeb, (ofs & ~3) - (c->sector_size - jeb->free_size));
+	}
+
+	return jffs2_link_node_ref(c, jeb, jeb->offset + ofs, len, ic);
+}
+
+/*
+ * Walk the summary records once before anything is linked into the erase
+ * block, so that a summary we cannot use can still be discarded in favour
+ * of a full scan. The kernel undoes the work done so far in that case,
+ * which needs the node ref freeing code of erase.c we do not have.
+ *
+ * Returns 0 if all records are fine, 1 if the block has to be scanned
+ * instead and -EIO if it must not be used at all.
+ */
+static int jffs2_sum_check_sum_data(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+				    struct jffs2_raw_summary *summary, uint32_t sumsize)
+{
+	void *sp = summary->sum;
+	void *end = (void *)summary + sumsize - sizeof(struct jffs2_sum_marker);
+	uint32_t ofs, totlen;
+	uint16_t nodetype;
+	int i;
+
+	for (i = 0; i < je32_to_cpu(summary->sum_num); i++) {
+		if (sp + sizeof(struct jffs2_sum_unknown_flash) > end)
+			goto overrun;
+
+		nodetype = je16_to_cpu(((struct jffs2_sum_unknown_flash *)sp)->nodetype);
+
+		switch (nodetype) {
+		case JFFS2_NODETYPE_INODE: {
+			struct jffs2_sum_inode_flash *spi = sp;
+
+			if (sp + JFFS2_SUMMARY_INODE_SIZE > end)
+				goto overrun;
+
+			ofs = je32_to_cpu(spi->offset);
+			totlen = je32_to_cpu(spi->totlen);
+			sp += JFFS2_SUMMARY_INODE_SIZE;
+			break;
+		}
+
+		case JFFS2_NODETYPE_DIRENT: {
+			struct jffs2_sum_dirent_flash *spd = sp;
+
+			if (sp + JFFS2_SUMMARY_DIRENT_SIZE(0) > end ||
+			    sp + JFFS2_SUMMARY_DIRENT_SIZE(spd->nsize) > end)
+				goto overrun;
+
+			/* This should never happen, but https://dev.laptop.org/ticket/4184 */
+			if (!spd->nsize || !spd->name[0]) {
+				pr_err("Dirent at %08x has zero at start of name. Aborting mount.\n",
+				       jeb->offset + je32_to_cpu(spd->offset));
+				return -EIO;
+			}
+
+			ofs = je32_to_cpu(spd->offset);
+			totlen = je32_to_cpu(spd->totlen);
+			sp += JFFS2_SUMMARY_DIRENT_SIZE(spd->nsize);
+			break;
+		}
+
+		default:
+			JFFS2_WARNING("Unsupported node type %x found in summary!\n",
+				      nodetype);
+			if ((nodetype & JFFS2_COMPAT_MASK) == JFFS2_FEATURE_INCOMPAT)
+				return -EIO;
+
+			/* For compatible node types, just fall back to the full scan */
+			return 1;
+		}
+
+		if (ofs >= c->sector_size || totlen > c->sector_size - ofs) {
+			JFFS2_WARNING("Summary entry 0x%08x-0x%08x outside of eraseblock @0x%08x\n",
+				      ofs, ofs + totlen, jeb->offset);
+			return 1;
+		}
+	}
+
+	return 0;
+
+overrun:
+	JFFS2_WARNING("Summary of eraseblock @0x%08x ends within entry %d\n",
+		      jeb->offset, i);
+	return 1;
+}
+
+/* Process the stored summary information - helper function for jffs2_sum_scan_sumnode() */
+static int jffs2_sum_process_sum_data(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+				      struct jffs2_raw_summary *summary, uint32_t *pseudo_random)
+{
+	struct jffs2_inode_cache *ic;
+	struct jffs2_full_dirent *fd;
+	void *sp;
+	int i, ino;
+	int err;
+
+	sp = summary->sum;
+
+	for (i = 0; i < je32_to_cpu(summary->sum_num); i++) {
+		dbg_summary("processing summary index %d\n", i);
+
+		cond_resched();
+
+		/* Make sure there's a spare ref for dirty space */
+		err = jffs2_prealloc_raw_node_refs(c, jeb, 2);
+		if (err)
+			return err;
+
+		switch (je16_to_cpu(((struct jffs2_sum_unknown_flash *)sp)->nodetype)) {
+		case JFFS2_NODETYPE_INODE: {
+			struct jffs2_sum_inode_flash *spi;
+			spi = sp;
+
+			ino = je32_to_cpu(spi->inode);
+
+			dbg_summary("Inode at 0x%08x-0x%08x\n",
+				    jeb->offset + je32_to_cpu(spi->offset),
+				    jeb->offset + je32_to_cpu(spi->offset) + je32_to_cpu(spi->totlen));
+
+			ic = jffs2_scan_make_ino_cache(c, ino);
+			if (!ic) {
+				JFFS2_NOTICE("scan_make_ino_cache failed\n");
+				return -ENOMEM;
+			}
+
+			sum_link_node_ref(c, jeb, je32_to_cpu(spi->offset) | REF_UNCHECKED,
+					  PAD(je32_to_cpu(spi->totlen)), ic);
+
+			*pseudo_random += je32_to_cpu(spi->version);
+
+			sp += JFFS2_SUMMARY_INODE_SIZE;
+
+			break;
+		}
+
+		case JFFS2_NODETYPE_DIRENT: {
+			struct jffs2_sum_dirent_flash *spd;
+			int checkedlen;
+			spd = sp;
+
+			dbg_summary("Dirent at 0x%08x-0x%08x\n",
+				    jeb->offset + je32_to_cpu(spd->offset),
+				    jeb->offset + je32_to_cpu(spd->offset) + je32_to_cpu(spd->totlen));
+
+			checkedlen = strnlen(spd->name, spd->nsize);
+			if (checkedlen < spd->nsize) {
+				pr_err("Dirent at %08x has zeroes in name. Truncating to %d chars\n",
+				       jeb->offset + je32_to_cpu(spd->offset),
+				       checkedlen);
+			}
+
+			fd = jffs2_alloc_full_dirent(checkedlen+1);
+			if (!fd)
+				return -ENOMEM;
+
+			memcpy(&fd->name, spd->name, checkedlen);
+			fd->name[checkedlen] = 0;
+
+			ic = jffs2_scan_make_ino_cache(c, je32_to_cpu(spd->pino));
+			if (!ic) {
+				jffs2_free_full_dirent(fd);
+				return -ENOMEM;
+			}
+
+			fd->raw = sum_link_node_ref(c, jeb, je32_to_cpu(spd->offset) | REF_UNCHECKED,
+						    PAD(je32_to_cpu(spd->totlen)), ic);
+
+			fd->next = NULL;
+			fd->version = je32_to_cpu(spd->version);
+			fd->ino = je32_to_cpu(spd->ino);
+			fd->nhash = full_name_hash(NULL, fd->name, checkedlen);
+			fd->type = spd->type;
+
+			jffs2_add_fd_to_list(c, fd, &ic->scan_dents);
+
+			*pseudo_random += je32_to_cpu(spd->version);
+
+			sp += JFFS2_SUMMARY_DIRENT_SIZE(spd->nsize);
+
+			break;
+		}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Process the summary node - called from jffs2_scan_eraseblock().
+ *
+ * Returns a BLK_STATE_xxx classification of the block when the summary
+ * was used, 0 if the block has to be scanned and a negative error code
+ * if mounting must fail.
+ */
+int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+			   struct jffs2_raw_summary *summary, uint32_t sumsize,
+			   uint32_t *pseudo_random)
+{
+	struct jffs2_unknown_node crcnode;
+	int ret, ofs;
+	uint32_t crc;
+
+	ofs = c->sector_size - sumsize;
+
+	dbg_summary("summary found for 0x%08x at 0x%08x (0x%x bytes)\n",
+		    jeb->offset, jeb->offset + ofs, sumsize);
+
+	if (sumsize < JFFS2_SUMMARY_FRAME_SIZE) {
+		dbg_summary("Summary node is too short\n");
+		goto crc_err;
+	}
+
+	/* OK, now check for node validity and CRC */
+	crcnode.magic = cpu_to_je16(JFFS2_MAGIC_BITMASK);
+	crcnode.nodetype = cpu_to_je16(JFFS2_NODETYPE_SUMMARY);
+	crcnode.totlen = summary->totlen;
+	crc = crc32(0, &crcnode, sizeof(crcnode)-4);
+
+	if (je32_to_cpu(summary->hdr_crc) != crc) {
+		dbg_summary("Summary node header is corrupt (bad CRC or "
+				"no summary at all)\n");
+		goto crc_err;
+	}
+
+	if (je32_to_cpu(summary->totlen) != sumsize) {
+		dbg_summary("Summary node is corrupt (wrong erasesize?)\n");
+		goto crc_err;
+	}
+
+	crc = crc32(0, summary, sizeof(struct jffs2_raw_summary)-8);
+
+	if (je32_to_cpu(summary->node_crc) != crc) {
+		dbg_summary("Summary node is corrupt (bad CRC)\n");
+		goto crc_err;
+	}
+
+	crc = crc32(0, summary->sum, sumsize - sizeof(struct jffs2_raw_summary));
+
+	if (je32_to_cpu(summary->sum_crc) != crc) {
+		dbg_summary("Summary node data is corrupt (bad CRC)\n");
+		goto crc_err;
+	}
+
+	ret = jffs2_sum_check_sum_data(c, jeb, summary, sumsize);
+	if (ret < 0)
+		return ret;
+	if (ret)
+		return 0;	/* do a full scan of this eraseblock */
+
+	if (je32_to_cpu(summary->cln_mkr)) {
+
+		dbg_summary("Summary : CLEANMARKER node\n");
+
+		ret = jffs2_prealloc_raw_node_refs(c, jeb, 1);
+		if (ret)
+			return ret;
+
+		if (je32_to_cpu(summary->cln_mkr) != c->cleanmarker_size) {
+			dbg_summary("CLEANMARKER node has totlen 0x%x != normal 0x%x\n",
+				je32_to_cpu(summary->cln_mkr), c->cleanmarker_size);
+			if ((ret = jffs2_scan_dirty_space(c, jeb, PAD(je32_to_cpu(summary->cln_mkr)))))
+				return ret;
+		} else if (jeb->first_node) {
+			dbg_summary("CLEANMARKER node not first node in block "
+					"(0x%08x)\n", jeb->offset);
+			if ((ret = jffs2_scan_dirty_space(c, jeb, PAD(je32_to_cpu(summary->cln_mkr)))))
+				return ret;
+		} else {
+			jffs2_link_node_ref(c, jeb, jeb->offset | REF_NORMAL,
+					    je32_to_cpu(summary->cln_mkr), NULL);
+		}
+	}
+
+	ret = jffs2_sum_process_sum_data(c, jeb, summary, pseudo_random);
+	if (ret)
+		return ret;		/* real error */
+
+	/* for PARANOIA_CHECK */
+	ret = jffs2_prealloc_raw_node_refs(c, jeb, 2);
+	if (ret)
+		return ret;
+
+	sum_link_node_ref(c, jeb, ofs | REF_NORMAL, sumsize, NULL);
+
+	if (unlikely(jeb->free_size)) {
+		JFFS2_WARNING("Free size 0x%x bytes in eraseblock @0x%08x with summary?\n",
+			      jeb->free_size, jeb->offset);
+		jeb->wasted_size += jeb->free_size;
+		c->wasted_size += jeb->free_size;
+		c->free_size -= jeb->free_size;
+		jeb->free_size = 0;
+	}
+
+	return jffs2_scan_classify_jeb(c, jeb);
+
+crc_err:
+	JFFS2_WARNING("Summary node crc error, skipping summary information.\n");
+
+	return 0;
+}
@@ -109,7 +109,7 @@ static int __init init_jffs2_fs(void)
 #ifdef CONFIG_JFFS2_FS_WRITEBUFFER
 	       " (NAND)"
 #endif
-#ifdef CONFIG_JFFS2_SUMMARY
+#ifdef CONFIG_FS_JFFS2_SUMMARY
 	       " (SUMMARY) "
 #endif
 	       " © 2001-2006 Red Hat, Inc.\n");
@@ -121,6 +121,17 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(100 * MSECOND)
 #define NFS_MAX_RESEND	100
 
+#define NFS_MAX_WINDOW_SIZE	CONFIG_FS_NFS_MAX_WINDOW_SIZE
+
+static int g_nfs_window_size = 4;
+
+#ifdef CONFIG_NET_IP_REASSEMBLY
+/* leave room for the IP, UDP and RPC headers in the reply */
+#define NFS_READ_SIZE	min(32768, ALIGN_DOWN(CONFIG_NET_IP_REASSEMBLY_MAX_SIZE - 512, 1024))
+#else
+#define NFS_READ_SIZE	1024
+#endif
+
 struct nfs_fh {
 	unsigned short size;
 	unsigned char data[NFS3_FHSIZE];
@@ -145,11 +156,25 @@ struct nfs_priv {
 	struct list_head packets;
 };
 
+struct nfs_read_slot {
+	uint32_t rpc_id;
+	uint64_t offset;
+	uint64_t sent;
+	int tries;
+	struct packet *reply;
+};
+
 struct file_priv {
 	struct kfifo *fifo;
 	void *buf;
 	struct nfs_priv *npriv;
 	struct nfs_fh fh;
+
+	/* outstanding READ requests, a ring of count slots starting at head */
+	struct nfs_read_slot window[NFS_MAX_WINDOW_SIZE];
+	unsigned int head;
+	unsigned int count;
+	uint64_t next_offset;
 };
 
 struct nfs_inode {
@@ -457,22 +482,16 @@ static void nfs_free_packet(struct packet *packet)
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * rpc_send - send an RPC call without waiting for the reply
  */
-static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
-			      int rpc_proc, uint32_t *data, int datalen)
+static int rpc_send(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		    uint32_t rpc_id, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
-	struct packet *packet;
-
-	npriv->rpc_id++;
 
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(rpc_id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -496,11 +515,27 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
+	return net_udp_send(npriv->con,
+			sizeof(pkt) + datalen * sizeof(uint32_t));
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
+			      int rpc_proc, uint32_t *data, int datalen)
+{
+	int ret;
+	int nfserr;
+	int tries = 0;
+	struct packet *packet;
+
+	npriv->rpc_id++;
+
 	nfs_timer_start = get_time_ns();
 
 again:
-	ret = net_udp_send(npriv->con,
-			sizeof(pkt) + datalen * sizeof(uint32_t));
+	ret = rpc_send(npriv, rpc_prog, rpc_proc, npriv->rpc_id, data, datalen);
 	if (ret) {
 		if (is_timeout(nfs_timer_start, NFS_TIMEOUT)) {
 			tries++;
@@ -969,16 +1004,20 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * READ requests are pipelined: up to g_nfs_window_size requests for
+ * consecutive NFS_READ_SIZE chunks of the file are outstanding. Replies are
+ * matched to their request by the RPC id and may arrive in any order, but
+ * are passed to the fifo in file order.
+ */
+
+/*
+ * nfs_read_send - send (or resend) the READ request for a window slot
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static int nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
-	uint32_t *p, status;
-	int len, ret;
-	struct packet *nfs_packet;
-	uint32_t rlen, eof;
+	uint32_t *p;
+	int len;
 
 	/*
 	 * struct READ3args {
@@ -986,7 +1025,85 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, &priv->fh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, NFS_READ_SIZE);
+
+	len = p - &(data[0]);
+
+	slot->sent = get_time_ns();
+
+	return rpc_send(priv->npriv, PROG_NFS, NFSPROC3_READ, slot->rpc_id,
+			data, len);
+}
+
+static struct nfs_read_slot *nfs_read_slot(struct file_priv *priv, int n)
+{
+	return &priv->window[(priv->head + n) % NFS_MAX_WINDOW_SIZE];
+}
+
+static void nfs_read_window_reset(struct file_priv *priv)
+{
+	struct nfs_read_slot *slot;
+
+	while (priv->count) {
+		slot = nfs_read_slot(priv, 0);
+		free(slot->reply);
+		slot->reply = NULL;
+		priv->head = (priv->head + 1) % NFS_MAX_WINDOW_SIZE;
+		priv->count--;
+	}
+}
+
+/*
+ * nfs_read_collect - assign received replies to their window slots
+ */
+static void nfs_read_collect(struct file_priv *priv)
+{
+	struct packet *packet, *tmp;
+	struct rpc_reply rpc;
+	struct nfs_read_slot *slot;
+	int i;
+
+	list_for_each_entry_safe(packet, tmp, &priv->npriv->packets, list) {
+		list_del(&packet->list);
+
+		if (packet->len < sizeof(rpc)) {
+			free(packet);
+			continue;
+		}
+
+		memcpy(&rpc, packet->data, sizeof(rpc));
+
+		for (i = 0; i < priv->count; i++) {
+			slot = nfs_read_slot(priv, i);
+			if (slot->rpc_id == ntoh32(rpc.id) && !slot->reply) {
+				slot->reply = packet;
+				packet = NULL;
+				break;
+			}
+		}
+
+		/* stale reply, e.g. to a request which has been resent */
+		free(packet);
+	}
+}
+
+/*
+ * nfs_read_reply - pass the data of a READ reply to the fifo
+ */
+static int nfs_read_reply(struct file_priv *priv, struct nfs_read_slot *slot)
+{
+	struct packet *nfs_packet = slot->reply;
+	uint32_t *p, status;
+	uint32_t rlen, eof;
+	int ret, nfserr;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -1005,18 +1122,9 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, &priv->fh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
-
-	len = p - &(data[0]);
-
-	nfs_packet = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (IS_ERR(nfs_packet))
-		return PTR_ERR(nfs_packet);
+	ret = rpc_check_reply(nfs_packet, PROG_NFS, slot->rpc_id, &nfserr);
+	if (ret)
+		return ret;
 
 	p = (void *)nfs_packet->data + sizeof(struct rpc_reply);
 	status = ntoh32(net_read_uint32(p++));
@@ -1040,23 +1148,109 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	p += 2;
 
-	if (readlen && !rlen && !eof) {
-		nfs_free_packet(nfs_packet);
+	if (!rlen && !eof)
 		return -EIO;
-	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	if (rlen > NFS_READ_SIZE ||
+	    (void *)p + rlen > (void *)nfs_packet->data + nfs_packet->len)
+		return -EIO;
 
-	nfs_free_packet(nfs_packet);
+	kfifo_put(priv->fifo, (char *)p, rlen);
 
 	return 0;
 }
 
+/*
+ * nfs_read_window - read the chunk at @pos into the fifo
+ */
+static int nfs_read_window(struct file_priv *priv, loff_t pos, loff_t size)
+{
+	struct nfs_read_slot *slot;
+	unsigned int window_size;
+	int i, ret;
+
+	window_size = clamp_t(unsigned int, g_nfs_window_size, 1,
+			      NFS_MAX_WINDOW_SIZE);
+
+	/*
+	 * The outstanding requests are only useful when the reader continues
+	 * where the last chunk ended. This is not the case after a seek or
+	 * after the server returned less data than requested.
+	 */
+	if (priv->count && nfs_read_slot(priv, 0)->offset != pos)
+		nfs_read_window_reset(priv);
+
+	if (!priv->count)
+		priv->next_offset = pos;
+
+	while (priv->count < window_size &&
+	       (!priv->count || priv->next_offset < size)) {
+		slot = nfs_read_slot(priv, priv->count);
+		slot->rpc_id = ++priv->npriv->rpc_id;
+		slot->offset = priv->next_offset;
+		slot->tries = 0;
+		slot->reply = NULL;
+		priv->count++;
+		priv->next_offset += NFS_READ_SIZE;
+
+		ret = nfs_read_send(priv, slot);
+		if (ret) {
+			nfs_read_window_reset(priv);
+			return ret;
+		}
+	}
+
+	slot = nfs_read_slot(priv, 0);
+
+	while (!slot->reply) {
+		net_poll();
+
+		nfs_read_collect(priv);
+
+		for (i = 0; i < priv->count; i++) {
+			struct nfs_read_slot *s = nfs_read_slot(priv, i);
+
+			if (s->reply || !is_timeout(s->sent, NFS_TIMEOUT))
+				continue;
+
+			if (++s->tries == NFS_MAX_RESEND) {
+				nfs_read_window_reset(priv);
+				return -ETIMEDOUT;
+			}
+
+			ret = nfs_read_send(priv, s);
+			if (ret) {
+				nfs_read_window_reset(priv);
+				return ret;
+			}
+		}
+	}
+
+	ret = nfs_read_reply(priv, slot);
+
+	free(slot->reply);
+	slot->reply = NULL;
+	priv->head = (priv->head + 1) % NFS_MAX_WINDOW_SIZE;
+	priv->count--;
+
+	if (ret)
+		nfs_read_window_reset(priv);
+
+	return ret;
+}
+
 static void nfs_handler(void *ctx, char *p, unsigned len)
 {
 	char *pkt = net_eth_to_udp_payload(p);
 	struct nfs_priv *npriv = ctx;
 	struct packet *packet;
+	int ulen = net_eth_to_udplen(p);
+
+	/* the UDP length must fit into what we actually received */
+	if (ulen < 0 || ulen > (int)len - (pkt - p))
+		return;
+
+	len = ulen;
 
 	packet = xmalloc(sizeof(*packet) + len);
 	memcpy(packet->data, pkt, len);
@@ -1072,6 +1266,8 @@ static int nfs_truncate(struct device *dev, FILE *f, loff_t size)
 
 static void nfs_do_close(struct file_priv *priv)
 {
+	nfs_read_window_reset(priv);
+
 	if (priv->fifo)
 		kfifo_free(priv->fifo);
 
@@ -1169,7 +1365,7 @@ static int nfs_open(struct device *dev, FILE *file, const char *filename)
 	file->priv = priv;
 	file->size = inode->i_size;
 
-	priv->fifo = kfifo_alloc(1024);
+	priv->fifo = kfifo_alloc(NFS_READ_SIZE);
 	if (!priv->fifo) {
 		free(priv);
 		return -ENOMEM;
@@ -1197,11 +1393,8 @@ static int nfs_read(struct device *dev, FILE *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->priv;
 
-	if (insize > 1024)
-		insize = 1024;
-
 	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->pos, insize);
+		int ret = nfs_read_window(priv, file->pos, file->size);
 		if (ret)
 			return ret;
 	}
@@ -1556,6 +1749,7 @@ static int nfs_init(void)
 	rootnfsopts = xstrdup("v3,tcp");
 
 	globalvar_add_simple_string("linux.rootnfsopts", &rootnfsopts);
+	globalvar_add_simple_int("nfs.windowsize", &g_nfs_window_size, "%u");
 
 	return register_fs_driver(&nfs_driver);
 }
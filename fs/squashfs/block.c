@@ -22,6 +22,9 @@
  * datablocks and metadata blocks.
  */
 
+#include <common.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
 #include <linux/fs.h>
 #include <linux/string.h>
 
@@ -32,50 +35,76 @@
 #include "page_actor.h"
 
 /*
- * Read the metadata block length, this is stored in the first two
- * bytes of the metadata block.
+ * Read the device blocks covering @length bytes at @index. Sequential
+ * datablock reads are served from a readahead buffer which is filled with
+ * CONFIG_SQUASHFS_READAHEAD_SIZE KiB at once, so that reading a large file
+ * results in a few large device reads instead of one read per block.
+ *
+ * Returns a pointer to the device block containing @index, or NULL on
+ * failure. If the data had to be allocated, *@to_free is set to it.
  */
-static char *get_block_length(struct super_block *sb,
-			u64 *cur_index, int *offset, int *length)
+static char *squashfs_read_blocks(struct squashfs_sb_info *msblk, u64 index,
+		int length, bool readahead, char **to_free)
 {
-	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	u64 start = round_down(index, msblk->devblksize);
+	u64 end = round_up(index + length, msblk->devblksize);
+	size_t size = end - start;
+	ssize_t ret;
 	char *buf;
 
-	buf = squashfs_devread(msblk,
-			 *cur_index * msblk->devblksize,
-			 msblk->devblksize);
+	*to_free = NULL;
+
+	if (msblk->ra_len && start >= msblk->ra_start &&
+			end <= msblk->ra_start + msblk->ra_len)
+		return msblk->ra_buf + (start - msblk->ra_start);
+
+	if (readahead && !msblk->ra_busy && size <= msblk->ra_size) {
+		size_t ra_size = min_t(u64, msblk->ra_size,
+			round_up(msblk->bytes_used, msblk->devblksize) - start);
+
+		if (!msblk->ra_buf) {
+			msblk->ra_buf = malloc(msblk->ra_size);
+			if (msblk->ra_buf == NULL)
+				goto read;
+		}
+
+		/*
+		 * The device read may reschedule, make sure other bthreads
+		 * neither use nor refill the buffer meanwhile.
+		 */
+		msblk->ra_len = 0;
+		msblk->ra_busy = 1;
+		ret = cdev_read(msblk->cdev, msblk->ra_buf, ra_size, start, 0);
+		msblk->ra_busy = 0;
+		if (ret != (ssize_t)ra_size)
+			goto failed;
+
+		msblk->ra_start = start;
+		msblk->ra_len = ra_size;
+
+		return msblk->ra_buf;
+	}
+
+read:
+	buf = malloc(size);
 	if (buf == NULL)
 		return NULL;
 
-	if (msblk->devblksize - *offset == 1) {
-		*length = (unsigned char) buf[*offset];
+	ret = cdev_read(msblk->cdev, buf, size, start, 0);
+	if (ret != (ssize_t)size) {
 		free(buf);
-		buf = squashfs_devread(msblk,
-				 ++(*cur_index) * msblk->devblksize,
-				 msblk->devblksize);
-		if (buf == NULL)
-			return NULL;
-		*length |= (unsigned char) buf[0] << 8;
-		*offset = 1;
-	} else {
-		*length = (unsigned char) buf[*offset] |
-			(unsigned char) buf[*offset + 1] << 8;
-		*offset += 2;
-
-		if (*offset == msblk->devblksize) {
-			free(buf);
-			buf = squashfs_devread(msblk,
-					 ++(*cur_index) * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf == NULL)
-				return NULL;
-			*offset = 0;
-		}
+		goto failed;
 	}
 
+	*to_free = buf;
+
 	return buf;
-}
 
+failed:
+	dev_err(msblk->dev, "read error: %s\n",
+		strerror(ret < 0 ? -ret : EIO));
+	return NULL;
+}
 
 /*
  * Read and decompress a metadata block or datablock.  Length is non-zero
@@ -90,21 +119,15 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		u64 *next_index, struct squashfs_page_actor *output)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	char **buf;
-	int offset = index & ((1 << msblk->devblksize_log2) - 1);
-	u64 cur_index = index >> msblk->devblksize_log2;
-	int bytes, compressed, b = 0, k = 0, avail;
-
-	buf = calloc(((output->length + msblk->devblksize - 1)
-			>> msblk->devblksize_log2) + 1, sizeof(*buf));
-	if (buf == NULL)
-		return -ENOMEM;
+	char **buf = NULL;
+	char *data, *to_free;
+	bool readahead = false;
+	int offset, bytes, compressed, b, k;
 
 	if (length) {
 		/*
 		 * Datablock.
 		 */
-		bytes = -offset;
 		compressed = SQUASHFS_COMPRESSED_BLOCK(length);
 		length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
 		if (next_index)
@@ -114,99 +137,91 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 			index, compressed ? "" : "un", length, output->length);
 
 		if (length < 0 || length > output->length ||
-				(index + length) > msblk->bytes_used) {
+				(index + length) > msblk->bytes_used)
 			goto read_failure;
-		}
-
-		for (b = 0; bytes < length; b++, cur_index++) {
-			buf[b] = squashfs_devread(msblk,
-					 cur_index * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf[b] == NULL)
-				goto block_release;
-
-			bytes += msblk->devblksize;
-		}
 
+		/* read ahead if this block follows the previous one */
+		readahead = msblk->ra_size && index == msblk->ra_next;
+		msblk->ra_next = index + length;
 	} else {
 		/*
-		 * Metadata block.
+		 * Metadata block, its length is stored in the first two bytes.
 		 */
 		if ((index + 2) > msblk->bytes_used)
 			goto read_failure;
 
-		buf[0] = get_block_length(sb, &cur_index, &offset, &length);
-		if (buf[0] == NULL)
+		data = squashfs_read_blocks(msblk, index, 2, false, &to_free);
+		if (data == NULL)
 			goto read_failure;
-		b = 1;
 
-		bytes = msblk->devblksize - offset;
+		offset = index & (msblk->devblksize - 1);
+		length = get_unaligned_le16(data + offset);
+		free(to_free);
+		index += 2;
+
 		compressed = SQUASHFS_COMPRESSED(length);
 		length = SQUASHFS_COMPRESSED_SIZE(length);
 		if (next_index)
-			*next_index = index + length + 2;
+			*next_index = index + length;
 
-		TRACE("Block Meta @ 0x%llx, %scompressed size %d\n", index,
+		TRACE("Block Meta @ 0x%llx, %scompressed size %d\n", index - 2,
 				compressed ? "" : "un", length);
 
 		if (length < 0 || length > output->length ||
 					(index + length) > msblk->bytes_used)
-			goto block_release;
-
-		for (; bytes < length; b++) {
-			buf[b] = squashfs_devread(msblk,
-					 ++cur_index * msblk->devblksize,
-					 msblk->devblksize);
-			if (buf[b] == NULL)
-				goto block_release;
-			bytes += msblk->devblksize;
-		}
+			goto read_failure;
 	}
 
+	data = squashfs_read_blocks(msblk, index, length, readahead, &to_free);
+	if (data == NULL)
+		goto read_failure;
+
+	offset = index & (msblk->devblksize - 1);
+	b = (offset + length + msblk->devblksize - 1) >> msblk->devblksize_log2;
+
 	if (compressed) {
+		buf = calloc(b, sizeof(*buf));
+		if (buf == NULL)
+			goto block_release;
+
+		for (k = 0; k < b; k++)
+			buf[k] = data + (k << msblk->devblksize_log2);
+
 		length = squashfs_decompress(msblk, buf, b, offset, length,
 			output);
 		if (length < 0)
-			goto read_failure;
+			goto block_release;
 	} else {
 		/*
 		 * Block is uncompressed.
 		 */
-		int pg_offset = 0;
-		void *data = squashfs_first_page(output);
-
-		for (bytes = length; k < b; k++) {
-			int in = min(bytes, msblk->devblksize - offset);
-			bytes -= in;
-			while (in) {
-				if (pg_offset == PAGE_CACHE_SIZE) {
-					data = squashfs_next_page(output);
-					pg_offset = 0;
-				}
-				avail = min_t(int, in, PAGE_CACHE_SIZE -
-						pg_offset);
-				memcpy(data + pg_offset, buf[k] + offset,
-						avail);
-				in -= avail;
-				pg_offset += avail;
-				offset += avail;
+		int pg_offset = 0, avail;
+		void *page = squashfs_first_page(output);
+
+		data += offset;
+		for (bytes = length; bytes; bytes -= avail) {
+			if (pg_offset == PAGE_CACHE_SIZE) {
+				page = squashfs_next_page(output);
+				pg_offset = 0;
 			}
-			offset = 0;
-			kfree(buf[k]);
+			avail = min_t(int, bytes, PAGE_CACHE_SIZE - pg_offset);
+			memcpy(page + pg_offset, data, avail);
+			pg_offset += avail;
+			data += avail;
 		}
 		squashfs_finish_page(output);
 	}
 
-	kfree(buf);
+	free(buf);
+	free(to_free);
 	return length;
 
 block_release:
-	for (; k < b; k++)
-		kfree(buf[k]);
+	free(buf);
+	free(to_free);
 
 read_failure:
 	ERROR("squashfs_read_data failed to read block 0x%llx\n",
 					(unsigned long long) index);
-	kfree(buf);
 	return -EIO;
 }
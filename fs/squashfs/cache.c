@@ -40,6 +40,7 @@
  * near future access without requiring an additional read and decompress.
  */
 
+#include <bthread.h>
 #include <linux/fs.h>
 #include <linux/pagemap.h>
 
@@ -68,6 +69,14 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		}
 
 		if (n == cache->entries) {
+			/*
+			 * Block not in cache, if all cache entries are used
+			 * wait for another bthread to release one.
+			 */
+			if (cache->unused == 0) {
+				bthread_reschedule();
+				continue;
+			}
 
 			/*
 			 * At least one unused cache entry.  A simple
@@ -116,6 +125,13 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			cache->unused--;
 		entry->refcount++;
 
+		/*
+		 * If the entry is still being filled in by another bthread,
+		 * wait until it is done.
+		 */
+		while (entry->pending)
+			bthread_reschedule();
+
 		goto out;
 	}
 
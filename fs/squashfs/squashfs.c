@@ -21,26 +21,6 @@
 
 struct ubi_volume_desc;
 
-char *squashfs_devread(struct squashfs_sb_info *fs, int byte_offset,
-		int byte_len)
-{
-	ssize_t size;
-	char *buf;
-
-	buf = malloc(byte_len);
-	if (buf == NULL)
-		return NULL;
-
-	size = cdev_read(fs->cdev, buf, byte_len, byte_offset, 0);
-	if (size < 0) {
-		dev_err(fs->dev, "read error: %s\n",
-				strerror(-size));
-		return NULL;
-	}
-
-	return buf;
-}
-
 static void squashfs_set_rootarg(struct fs_device *fsdev)
 {
 	struct ubi_volume_desc *ubi_vol;
@@ -52,8 +52,6 @@ static inline struct squashfs_page *squashfs_page(struct page *page)
 
 #define WARNING(s, args...)	pr_warn("SQUASHFS: "s, ## args)
 
-char *squashfs_devread(struct squashfs_sb_info *fs, int byte_offset,
-		int byte_len);
 extern int squashfs_mount(struct fs_device *fsdev,
 			  int silent);
 extern void squashfs_put_super(struct super_block *sb);
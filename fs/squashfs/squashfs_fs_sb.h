@@ -78,5 +78,11 @@ struct squashfs_sb_info {
 	int					xattr_ids;
 	struct cdev				*cdev;
 	struct device				*dev;
+	char					*ra_buf;
+	u64					ra_start;
+	size_t					ra_len;
+	size_t					ra_size;
+	u64					ra_next;
+	int					ra_busy;
 };
 #endif
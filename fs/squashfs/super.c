@@ -31,6 +31,7 @@
 #include <linux/pagemap.h>
 #include <linux/magic.h>
 #include <linux/bitops.h>
+#include <linux/sizes.h>
 
 #include "page_actor.h"
 #include "squashfs_fs.h"
@@ -73,6 +74,7 @@ void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
 		squashfs_decompressor_destroy(sbi);
+		free(sbi->ra_buf);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -113,6 +115,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	msblk->devblksize = 1024;
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
+	msblk->ra_size = CONFIG_SQUASHFS_READAHEAD_SIZE * SZ_1K;
 
 	mutex_init(&msblk->meta_index_mutex);
 	/*
@@ -220,7 +223,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		SQUASHFS_CACHED_DATA_BLOCKS, msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -310,6 +313,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
 	squashfs_decompressor_destroy(msblk);
+	free(msblk->ra_buf);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
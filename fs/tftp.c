@@ -73,6 +73,13 @@
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
 #define TFTP_MTU_SIZE		1432	/* MTU based block size */
+#ifdef CONFIG_NET_IP_REASSEMBLY
+/* largest block fitting into a reassembled datagram, at most the RFC 2348 limit */
+#define TFTP_REASM_BLOCK_SIZE	(CONFIG_NET_IP_REASSEMBLY_MAX_SIZE - 20 - 8 - 4)
+#define TFTP_MAX_BLOCK_SIZE	(TFTP_REASM_BLOCK_SIZE < 65464 ? TFTP_REASM_BLOCK_SIZE : 65464)
+#else
+#define TFTP_MAX_BLOCK_SIZE	TFTP_MTU_SIZE
+#endif
 #define TFTP_MAX_WINDOW_SIZE	CONFIG_FS_TFTP_MAX_WINDOW_SIZE
 
 /* allocate this number of blocks more than needed in the fifo */
@@ -93,6 +100,7 @@
 #endif
 
 static int g_tftp_window_size = DIV_ROUND_UP(TFTP_MAX_WINDOW_SIZE, 2);
+static int g_tftp_block_size = TFTP_MAX_BLOCK_SIZE;
 
 struct tftp_block {
 	uint16_t id;
@@ -201,7 +209,7 @@ static int tftp_send(struct file_priv *priv)
 	int len = 0;
 	uint16_t *s;
 	unsigned char *pkt = net_udp_get_payload(priv->tftp_con);
-	unsigned int window_size;
+	unsigned int window_size, block_size;
 	int ret;
 
 	pr_vdebug("%s: state %s\n", __func__, tftp_states[priv->state]);
@@ -209,14 +217,28 @@ static int tftp_send(struct file_priv *priv)
 	switch (priv->state) {
 	case STATE_RRQ:
 	case STATE_WRQ:
+		if (priv->is_getattr)
+			/* use only a minimal blksize for getattr
+			   operations */
+			block_size = TFTP_BLOCK_SIZE;
+		else if (priv->push)
+			/* we can't send fragmented datagrams */
+			block_size = TFTP_MTU_SIZE;
+		else
+			block_size = clamp_t(unsigned int, g_tftp_block_size,
+					     TFTP_BLOCK_SIZE, TFTP_MAX_BLOCK_SIZE);
+
 		if (priv->push || priv->is_getattr)
 			/* atm, windowsize is supported only for RRQ and there
 			   is no need to request a full window when we are
 			   just looking up file attributes */
 			window_size = 1;
 		else
-			window_size = min_t(unsigned int, g_tftp_window_size,
-					    TFTP_MAX_WINDOW_SIZE);
+			/* with large blocks, limit the window to the memory
+			   MTU sized blocks would need */
+			window_size = min3((unsigned int)g_tftp_window_size,
+					   (unsigned int)TFTP_MAX_WINDOW_SIZE,
+					   max(1U, TFTP_MAX_WINDOW_SIZE * TFTP_MTU_SIZE / block_size));
 
 		xp = pkt;
 		s = (uint16_t *)pkt;
@@ -237,9 +259,7 @@ static int tftp_send(struct file_priv *priv)
 				'\0',	/* "timeout" */
 				TIMEOUT, '\0',
 				'\0',	/* "blksize" */
-				/* use only a minimal blksize for getattr
-				   operations, */
-				priv->is_getattr ? TFTP_BLOCK_SIZE : TFTP_MTU_SIZE);
+				block_size);
 		pkt++;
 
 		if (!priv->push)
@@ -350,7 +370,7 @@ static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 		s = val + strlen(val) + 1;
 	}
 
-	if (priv->blocksize > TFTP_MTU_SIZE ||
+	if (priv->blocksize > (priv->push ? TFTP_MTU_SIZE : TFTP_MAX_BLOCK_SIZE) ||
 	    priv->windowsize > TFTP_MAX_WINDOW_SIZE ||
 	    priv->windowsize == 0) {
 		pr_warn("tftp: invalid oack response\n");
@@ -1071,6 +1091,7 @@ static struct fs_driver tftp_driver = {
 static int tftp_init(void)
 {
 	globalvar_add_simple_int("tftp.windowsize", &g_tftp_window_size, "%u");
+	globalvar_add_simple_int("tftp.blocksize", &g_tftp_block_size, "%u");
 
 	return register_fs_driver(&tftp_driver);
 }
@@ -286,23 +286,13 @@ int __init ubifs_compressors_init(void)
 
 /* file.c */
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+static int decompress_block(struct inode *inode, void *addr, unsigned int block,
+			    struct ubifs_data_node *dn)
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(c, le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -333,11 +323,39 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return decompress_block(inode, addr, block, dn);
+}
+
+static int ubifs_bulk_read = 1;
+
 struct ubifs_file {
 	struct inode *inode;
 	void *buf;
 	unsigned int block;
 	struct ubifs_data_node *dn;
+
+	/* data nodes fetched with the last bulk-read */
+	struct bu_info *bu;
+	unsigned int bu_block;		/* first block covered by @bu */
+	unsigned int bu_blocks;		/* blocks covered, including holes */
+
+	unsigned int next_block;	/* to detect sequential reads */
 };
 
 static int ubifs_open(struct device *dev, FILE *file, const char *filename)
@@ -362,6 +380,9 @@ static int ubifs_close(struct device *dev, FILE *f)
 {
 	struct ubifs_file *uf = f->priv;
 
+	if (uf->bu)
+		free(uf->bu->buf);
+	free(uf->bu);
 	free(uf->buf);
 	free(uf->dn);
 	free(uf);
@@ -369,14 +390,117 @@ static int ubifs_close(struct device *dev, FILE *f)
 	return 0;
 }
 
+/*
+ * Fetch the data nodes following @block which lie consecutively in the same
+ * LEB with a single flash read.
+ */
+static int ubifs_bulk_read_nodes(struct ubifs_file *uf, unsigned int block)
+{
+	struct ubifs_info *c = uf->inode->i_sb->s_fs_info;
+	struct bu_info *bu = uf->bu;
+	int err;
+
+	if (!bu) {
+		bu = xzalloc(sizeof(*bu));
+		bu->buf_len = c->max_bu_buf_len;
+		bu->buf = malloc(bu->buf_len);
+		if (!bu->buf) {
+			free(bu);
+			return -ENOMEM;
+		}
+		uf->bu = bu;
+	}
+
+	uf->bu_blocks = 0;
+
+	data_key_init(c, &bu->key, uf->inode->i_ino, block);
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+
+	if (!bu->cnt) {
+		/* no data nodes nearby, only know that @block is a hole */
+		uf->bu_block = block;
+		uf->bu_blocks = 1;
+		return 0;
+	}
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err;
+
+	uf->bu_block = block;
+	uf->bu_blocks = key_block(c, &bu->zbranch[bu->cnt - 1].key) - block + 1;
+
+	return 0;
+}
+
+/* decompress @block from the nodes fetched by the last bulk-read */
+static int ubifs_bulk_get_block(struct ubifs_file *uf, unsigned int block,
+				void *addr)
+{
+	struct ubifs_info *c = uf->inode->i_sb->s_fs_info;
+	struct bu_info *bu = uf->bu;
+	void *node = bu->buf;
+	int i;
+
+	for (i = 0; i < bu->cnt; i++) {
+		unsigned int b = key_block(c, &bu->zbranch[i].key);
+
+		if (b == block)
+			return decompress_block(uf->inode, addr, block, node);
+		if (b > block)
+			break;
+
+		node += ALIGN(bu->zbranch[i].len, 8);
+	}
+
+	/* a hole */
+	memset(addr, 0, UBIFS_BLOCK_SIZE);
+
+	return 0;
+}
+
+/*
+ * Read @block into @addr. Sequential reads are served from bulk-reads, random
+ * ones read only the single data node needed.
+ */
+static int ubifs_read_block(struct ubifs_file *uf, unsigned int block,
+			    void *addr)
+{
+	bool sequential = block == uf->next_block;
+	int ret;
+
+	uf->next_block = block + 1;
+
+	if (uf->bu_blocks && block >= uf->bu_block &&
+	    block - uf->bu_block < uf->bu_blocks)
+		return ubifs_bulk_get_block(uf, block, addr);
+
+	if (ubifs_bulk_read && sequential) {
+		ret = ubifs_bulk_read_nodes(uf, block);
+		if (!ret)
+			return ubifs_bulk_get_block(uf, block, addr);
+
+		/* fall back to reading the node alone */
+		uf->bu_blocks = 0;
+	}
+
+	ret = read_block(uf->inode, addr, block, uf->dn);
+	if (ret && ret != -ENOENT)
+		return ret;
+
+	return 0;
+}
+
 static int ubifs_get_block(struct ubifs_file *uf, unsigned int pos)
 {
 	int ret;
 	unsigned int block = pos / UBIFS_BLOCK_SIZE;
 
 	if (block != uf->block) {
-		ret = read_block(uf->inode, uf->buf, block, uf->dn);
-		if (ret && ret != -ENOENT)
+		ret = ubifs_read_block(uf, block, uf->buf);
+		if (ret)
 			return ret;
 		uf->block = block;
 	}
@@ -408,13 +532,12 @@ static int ubifs_read(struct device *_dev, FILE *f, void *buf, size_t insize)
 		buf += now;
 	}
 
-	/* Do full blocks */
+	/* Do full blocks, decompressed directly into the destination */
 	while (size >= UBIFS_BLOCK_SIZE) {
-		ret = ubifs_get_block(uf, pos);
+		ret = ubifs_read_block(uf, pos / UBIFS_BLOCK_SIZE, buf);
 		if (ret)
 			return ret;
 
-		memcpy(buf, uf->buf, UBIFS_BLOCK_SIZE);
 		size -= UBIFS_BLOCK_SIZE;
 		pos += UBIFS_BLOCK_SIZE;
 		buf += UBIFS_BLOCK_SIZE;
@@ -566,6 +689,7 @@ static int ubifs_init(void)
 			return ret;
 	}
 
+	globalvar_add_simple_bool("ubifs.bulk_read", &ubifs_bulk_read);
 	globalvar_add_simple_bool("ubifs.allow_encrypted", &ubifs_allow_encrypted);
 	globalvar_add_simple_bool("ubifs.allow_authenticated_unauthenticated",
 				  &ubifs_allow_authenticated_unauthenticated);
@@ -575,6 +699,8 @@ static int ubifs_init(void)
 
 coredevice_initcall(ubifs_init);
 
+BAREBOX_MAGICVAR(global.ubifs.bulk_read,
+		 "If true, read consecutive data nodes with a single flash read on sequential reads");
 BAREBOX_MAGICVAR(global.ubifs.allow_encrypted,
 		 "If true, allow to mount UBIFS with encrypted files");
 BAREBOX_MAGICVAR(global.ubifs.allow_authenticated_unauthenticated,
@@ -3,15 +3,43 @@
 #define __BLOCK_H
 
 #include <driver.h>
+#include <poller.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/types.h>
 
 struct block_device;
 
+/*
+ * An asynchronous block request. The submitter fills in buf, block,
+ * num_blocks, write and optionally complete/priv. status is -EINPROGRESS
+ * while the request is in flight and holds the result afterwards.
+ */
+struct block_request {
+	struct block_device *blk;
+	void *buf;
+	sector_t block;
+	blkcnt_t num_blocks;
+	bool write;
+	int status;
+	void (*complete)(struct block_request *req);
+	void *priv;
+};
+
 struct block_device_ops {
 	int (*read)(struct block_device *, void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*write)(struct block_device *, const void *buf, sector_t block, blkcnt_t num_blocks);
 	int (*flush)(struct block_device *);
+
+	/*
+	 * Optional asynchronous interface. submit queues a request and
+	 * returns without waiting for it, or -EBUSY if the hardware queue is
+	 * full. poll reaps finished requests and reports them with
+	 * block_request_complete(). Drivers without it are driven through
+	 * read/write synchronously.
+	 */
+	int (*submit)(struct block_device *, struct block_request *req);
+	void (*poll)(struct block_device *);
 };
 
 struct chunk;
@@ -25,11 +53,29 @@ struct block_device {
 	int rdbufsize;
 	int blkmask;
 
+	/* cache geometry, defaults are used when left zero by the driver */
+	uint32_t cache_chunk_size;
+	uint32_t cache_chunks;
+	uint32_t cache_readahead; /* max chunks to prefetch, 0 disables */
+	struct param_d *param_chunk_size;
+	struct param_d *param_chunks;
+	struct param_d *param_readahead;
+
+	/* sequential readahead state */
+	void *ra_buf;
+	sector_t ra_next;
+	unsigned int ra_window;
+
+	/* asynchronous requests */
+	unsigned int inflight;
+	struct poller_struct poller;
+
 	sector_t discard_start;
 	blkcnt_t discard_size;
 
 	struct list_head buffered_blocks;
 	struct list_head idle_blocks;
+	struct rb_root chunk_tree;
 
 	struct cdev cdev;
 };
@@ -44,6 +90,11 @@ int blockdevice_unregister(struct block_device *blk);
 int block_read(struct block_device *blk, void *buf, sector_t block, blkcnt_t num_blocks);
 int block_write(struct block_device *blk, void *buf, sector_t block, blkcnt_t num_blocks);
 
+int block_submit(struct block_device *blk, struct block_request *req);
+void block_request_complete(struct block_request *req, int status);
+void block_poll(struct block_device *blk);
+int block_wait(struct block_request *req);
+
 static inline int block_flush(struct block_device *blk)
 {
 	return cdev_flush(&blk->cdev);
@@ -87,6 +87,8 @@ struct image_data {
 
 	const void *fit_kernel;
 	unsigned long fit_kernel_size;
+	/* set when the kernel has been loaded to its FIT load address */
+	struct resource *fit_kernel_res;
 	void *fit_config;
 
 	struct device_node *of_root_node;
@@ -8,4 +8,7 @@ int bunzip2(unsigned char *inbuf, int len,
 	    unsigned char *output,
 	    int *pos,
 	    void(*error)(char *x));
+int bunzip2_priv(unsigned char *inbuf, int len,
+		 int (*flush)(void *priv, void *buf, unsigned int len),
+		 void *priv, void (*error)(char *x));
 #endif
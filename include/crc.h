@@ -38,6 +38,14 @@ static inline u16 crc_itu_t_byte(u16 crc, const u8 data)
 uint32_t crc32(uint32_t, const void *, unsigned int);
 uint32_t crc32_be(uint32_t, const void *, unsigned int);
 uint32_t crc32_no_comp(uint32_t, const void *, unsigned int);
+
+/* The implementations behind crc32_no_comp(), for testing */
+uint32_t crc32_le_bytewise(uint32_t, const void *, unsigned int);
+uint32_t crc32_le_sliceby8(uint32_t, const void *, unsigned int);
+
+/* Provided by architectures selecting HAVE_ARCH_CRC32 */
+bool arch_crc32_le_supported(void);
+uint32_t arch_crc32_le(uint32_t, const void *, unsigned int);
 int file_crc(char *filename, unsigned long start, unsigned long size,
 	     unsigned long *crc, unsigned long *total);
 
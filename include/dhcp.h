@@ -7,6 +7,8 @@
 #ifndef __DHCP_H__
 #define __DHCP_H__
 
+#include <net.h>
+
 #define DHCP_DEFAULT_RETRY 20
 
 struct dhcp_req_param {
@@ -23,7 +25,7 @@ struct dhcp_result {
 	IPaddr_t ip;
 	IPaddr_t netmask;
 	IPaddr_t gateway;
-	IPaddr_t nameserver;
+	IPaddr_t nameserver[NET_MAX_NAMESERVERS];
 	IPaddr_t serverip;
 	IPaddr_t dhcp_serverip;
 	char *hostname;
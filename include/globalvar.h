@@ -29,6 +29,9 @@ int globalvar_add_simple_enum(const char *name,	int *value,
 			      const char * const *names, int max);
 int globalvar_add_simple_bitmask(const char *name, unsigned long *value,
 				 const char * const *names, int max);
+int globalvar_add_ip(const char *name,
+		     int (*set)(struct param_d *, void *),
+		     IPaddr_t *ip, void *priv);
 int globalvar_add_simple_ip(const char *name, IPaddr_t *ip);
 
 int nvvar_load(void);
@@ -84,6 +87,13 @@ static inline int globalvar_add_simple_bitmask(const char *name,
 	return 0;
 }
 
+static inline int globalvar_add_ip(const char *name,
+		int (*set)(struct param_d *, void *),
+		IPaddr_t *ip, void *priv)
+{
+	return 0;
+}
+
 static inline int globalvar_add_simple_ip(const char *name,
 		IPaddr_t *ip)
 {
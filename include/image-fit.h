@@ -9,11 +9,21 @@
 #include <linux/types.h>
 #include <bootm.h>
 
+struct resource;
+
 struct fit_handle {
 	const void *fit;
 	void *fit_alloc;
 	size_t size;
 
+	/*
+	 * When not mapped into memory, the image data is read from this file
+	 * on demand. -1 otherwise.
+	 */
+	int fd;
+	/* where data-offset properties of external data count from */
+	loff_t data_base;
+
 	bool verbose;
 	enum bootm_verify verify;
 
@@ -32,6 +42,9 @@ int fit_has_image(struct fit_handle *handle, void *configuration,
 int fit_open_image(struct fit_handle *handle, void *configuration,
 		   const char *name, const void **outdata,
 		   unsigned long *outsize);
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, unsigned long load_address,
+		   struct resource **res, unsigned long *outsize);
 int fit_get_image_address(struct fit_handle *handle, void *configuration,
 			  const char *name, const char *property,
 			  unsigned long *address);
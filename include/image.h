@@ -299,6 +299,7 @@ struct uimage_handle_data {
 struct uimage_handle *uimage_open(const char *filename);
 void uimage_close(struct uimage_handle *handle);
 int uimage_verify(struct uimage_handle *handle);
+int uimage_verify_on_load(struct uimage_handle *handle);
 int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 		int(*flush)(void*, unsigned int));
 void uimage_print_contents(struct uimage_handle *handle);
@@ -318,6 +319,7 @@ struct uimage_handle {
 	int nb_data_entries;
 	size_t data_offset;
 	int fd;
+	int verify_on_load;	/* check data crc in uimage_load() */
 };
 
 #define UIMAGE_INVALID_ADDRESS	(~0)
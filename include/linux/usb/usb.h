@@ -144,6 +144,60 @@ extern struct bus_type usb_bus_type;
 
 int usb_driver_register(struct usb_driver *);
 
+struct usb_urb;
+
+typedef void (*usb_urb_complete_t)(struct usb_urb *urb);
+
+/**
+ * struct usb_urb - an asynchronous bulk transfer
+ * @dev: the device to transfer from or to
+ * @pipe: the bulk pipe
+ * @transfer_buffer: DMA capable data buffer
+ * @transfer_buffer_length: size of @transfer_buffer
+ * @actual_length: number of bytes transferred
+ * @status: -EINPROGRESS while queued, 0 or a negative error code when done
+ * @complete: called when the transfer is done or cancelled
+ * @context: for use by the submitter
+ * @urb_list: for use by the host controller driver
+ * @hcpriv: for use by the host controller driver
+ * @transfer_dma: DMA address of @transfer_buffer while queued
+ *
+ * Completion functions are called from usb_poll_urbs() and usb_kill_urb()
+ * outside of the host controller, so they may resubmit the URB or start
+ * other transfers.
+ */
+struct usb_urb {
+	struct usb_device *dev;
+	unsigned long pipe;
+	void *transfer_buffer;
+	int transfer_buffer_length;
+	int actual_length;
+	int status;
+	usb_urb_complete_t complete;
+	void *context;
+
+	struct list_head urb_list;
+	void *hcpriv;
+	dma_addr_t transfer_dma;
+};
+
+static inline void usb_fill_bulk_urb(struct usb_urb *urb,
+				     struct usb_device *dev,
+				     unsigned long pipe, void *buffer,
+				     int length, usb_urb_complete_t complete,
+				     void *context)
+{
+	urb->dev = dev;
+	urb->pipe = pipe;
+	urb->transfer_buffer = buffer;
+	urb->transfer_buffer_length = length;
+	urb->actual_length = 0;
+	urb->status = 0;
+	urb->complete = complete;
+	urb->context = context;
+	INIT_LIST_HEAD(&urb->urb_list);
+}
+
 struct usb_host {
 	int (*init)(struct usb_host *);
 	int (*exit)(struct usb_host *);
@@ -157,6 +211,15 @@ struct usb_host {
 	int (*alloc_device)(struct usb_device *dev);
 	int (*update_hub_device)(struct usb_device *dev);
 
+	/*
+	 * Optional asynchronous bulk transfers. Completed URBs are moved to
+	 * the @done list by poll_urbs and kill_urb, the core calls their
+	 * completion functions.
+	 */
+	int (*submit_urb)(struct usb_urb *urb);
+	void (*kill_urb)(struct usb_urb *urb, struct list_head *done);
+	void (*poll_urbs)(struct usb_host *host, struct list_head *done);
+
 	bool no_desc_before_addr;
 
 	struct list_head list;
@@ -189,6 +252,9 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, int len, int *actual_length, int timeout_ms);
 int usb_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 			void *buffer, int transfer_len, int interval);
+int usb_submit_urb(struct usb_urb *urb);
+int usb_kill_urb(struct usb_urb *urb);
+int usb_poll_urbs(struct usb_device *dev);
 int usb_maxpacket(struct usb_device *dev, unsigned long pipe);
 int usb_get_configuration_no(struct usb_device *dev, unsigned char *buffer,
 				int cfgno);
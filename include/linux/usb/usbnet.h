@@ -21,6 +21,10 @@
 
 #include <net.h>
 #include <linux/phy.h>
+#include <linux/usb/usb.h>
+
+/* receive URBs kept queued when the host controller supports it */
+#define USBNET_RX_URBS		8
 
 /* interface from usbnet core to each USB networking link we handle */
 struct usbnet {
@@ -45,7 +49,8 @@ struct usbnet {
 	u32			xid;
 	u32			hard_mtu;	/* count any extra framing */
 	size_t			rx_urb_size;	/* size for rx urbs */
-	void			*rx_buf;
+	struct usb_urb		rx_urb[USBNET_RX_URBS];
+	bool			rx_sync;	/* host can't queue urbs */
 	void			*tx_buf;
 
 	unsigned long		flags;
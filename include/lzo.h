@@ -52,5 +52,8 @@ STATIC int decompress_unlzo(u8 *input, int in_len,
 		int (*flush) (void *, unsigned int),
 		u8 *output, int *posp,
 		void (*error) (char *x));
+int decompress_unlzo_priv(u8 *input, int in_len,
+			  int (*flush) (void *priv, void *buf, unsigned int len),
+			  void *priv, void (*error) (char *x));
 
 #endif
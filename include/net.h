@@ -30,7 +30,11 @@
 #define PKT_NUM_RETRIES 4
 
 /* The number of receive packet buffers */
+#ifdef CONFIG_NET_RX_PACKETS
+#define PKTBUFSRX	CONFIG_NET_RX_PACKETS
+#else
 #define PKTBUFSRX	4
+#endif
 
 struct device;
 
@@ -42,6 +46,12 @@ struct eth_device {
 	int  (*open) (struct eth_device*);
 	int  (*send) (struct eth_device*, void *packet, int length);
 	int  (*recv) (struct eth_device*);
+	/*
+	 * Optional replacement for recv: receive up to budget frames and
+	 * return the number received. Returning budget means that more
+	 * frames may be pending and the device is polled again right away.
+	 */
+	int  (*recv_budget) (struct eth_device*, int budget);
 	void (*halt) (struct eth_device*);
 	int  (*get_ethaddr) (struct eth_device*, u8 adr[6]);
 	int  (*set_ethaddr) (struct eth_device*, const unsigned char *adr);
@@ -76,6 +86,14 @@ struct eth_device {
 
 	struct list_head send_queue;
 
+	struct list_head neighbours;
+
+	/* number of times no packet buffer was available for this device */
+	uint32_t pool_exhausted;
+
+	/* number of users of promiscuous mode */
+	unsigned int promisc;
+
 	bool ifup;
 #define ETH_MODE_DHCP 0
 #define ETH_MODE_STATIC 1
@@ -151,6 +169,8 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_IGMP	 2	/* Internet Group Management Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
@@ -172,6 +192,9 @@ struct iphdr {
 	/* The options start here. */
 } __attribute__ ((packed));
 
+#define IP_MF		0x2000	/* more fragments */
+#define IP_OFFSET	0x1fff	/* fragment offset in units of 8 bytes */
+
 struct udphdr {
 	uint16_t	uh_sport;	/* source port */
 	uint16_t	uh_dport;	/* destination port */
@@ -179,6 +202,24 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+struct tcphdr {
+	uint16_t	source;		/* source port */
+	uint16_t	dest;		/* destination port */
+	uint32_t	seq;		/* sequence number */
+	uint32_t	ack_seq;	/* acknowledgement number */
+	uint8_t		doff;		/* header length in words, upper 4 bits */
+	uint8_t		flags;
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+	uint16_t	window;
+	uint16_t	check;
+	uint16_t	urg_ptr;
+	/* The options start here. */
+} __attribute__ ((packed));
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -256,17 +297,22 @@ struct icmphdr {
 extern unsigned char *NetRxPackets[PKTBUFSRX];/* Receive packets		*/
 
 void net_set_ip(struct eth_device *edev, IPaddr_t ip);
+void net_neigh_flush(struct eth_device *edev);
 void net_set_serverip(IPaddr_t ip);
 const char *net_get_server(void);
 void net_set_serverip_empty(IPaddr_t ip);
 void net_set_netmask(struct eth_device *edev, IPaddr_t ip);
 void net_set_gateway(IPaddr_t ip);
+#define NET_MAX_NAMESERVERS	3
+
 void net_set_nameserver(IPaddr_t ip);
+void net_set_nameservers(const IPaddr_t *ips, int num);
 void net_set_domainname(const char *name);
 IPaddr_t net_get_ip(struct eth_device *edev);
 IPaddr_t net_get_serverip(void);
 IPaddr_t net_get_gateway(void);
 IPaddr_t net_get_nameserver(void);
+int net_get_nameservers(IPaddr_t *ips);
 const char *net_get_domainname(void);
 struct eth_device *net_route(IPaddr_t ip);
 
@@ -288,6 +334,11 @@ static inline struct icmphdr *net_eth_to_icmphdr(char *pkt)
 	return (struct icmphdr *)(net_eth_to_iphdr(pkt) + 1);
 }
 
+static inline struct tcphdr *net_eth_to_tcphdr(char *pkt)
+{
+	return (struct tcphdr *)(net_eth_to_iphdr(pkt) + 1);
+}
+
 static inline char *net_eth_to_icmp_payload(char *pkt)
 {
 	return (char *)(net_eth_to_icmphdr(pkt) + 1);
@@ -366,11 +417,16 @@ void ethaddr_to_string(const u8 enetaddr[6], char *str);
 
 #ifdef CONFIG_NET_RESOLV
 int resolv(const char *host, IPaddr_t *ip);
+void dns_cache_flush(void);
 #else
 static inline int resolv(const char *host, IPaddr_t *ip)
 {
 	return string_to_ip(host, ip);
 }
+
+static inline void dns_cache_flush(void)
+{
+}
 #endif
 
 /**
@@ -465,10 +521,20 @@ struct eth_device *eth_get_byname(const char *name);
  */
 int net_receive(struct eth_device *edev, unsigned char *pkt, int len);
 
+#ifdef CONFIG_NET_IP_REASSEMBLY
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len);
+#else
+static inline unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	return NULL;
+}
+#endif
+
 struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
 	struct udphdr *udp;
+	struct tcphdr *tcp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
 	unsigned char *packet;
@@ -478,10 +544,30 @@ struct net_connection {
 	void *priv;
 };
 
-static inline char *net_alloc_packet(void)
-{
-	return dma_alloc(PKTSIZE);
-}
+void *net_alloc_packet(void);
+void net_free_packet(void *packet);
+
+/*
+ * A reference counted buffer from the packet buffer pool. The list member
+ * may be used by whoever owns the buffer, e.g. to queue it.
+ */
+struct net_pktbuf {
+	struct list_head list;
+	unsigned char *data;
+	int len;
+	struct eth_device *edev;
+	unsigned int refcount;
+	bool keepable;
+};
+
+struct net_pktbuf *net_pktbuf_alloc(struct eth_device *edev);
+struct net_pktbuf *net_pktbuf_alloc_tx(struct eth_device *edev);
+struct net_pktbuf *net_pktbuf_get(struct net_pktbuf *pb);
+void net_pktbuf_put(struct net_pktbuf *pb);
+struct net_pktbuf *net_pktbuf_from_data(const void *data);
+struct net_pktbuf *net_pktbuf_keep(const void *pkt);
+struct net_pktbuf *net_receive_pktbuf(struct eth_device *edev,
+				      struct net_pktbuf *pb);
 
 struct net_connection *net_udp_new(IPaddr_t dest, uint16_t dport,
 		rx_handler_f *handler, void *ctx);
@@ -510,6 +596,25 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 int net_udp_send(struct net_connection *con, int len);
 int net_icmp_send(struct net_connection *con, int len);
 
+static inline bool net_ip_is_multicast(IPaddr_t ip)
+{
+	return (ntohl(ip) & 0xf0000000) == 0xe0000000;
+}
+
+int net_join_group(struct eth_device *edev, IPaddr_t group);
+void net_leave_group(struct eth_device *edev, IPaddr_t group);
+
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+int net_tcp_send(struct net_connection *con, int len);
+
+struct tcp_connection;
+
+struct tcp_connection *tcp_connect(IPaddr_t dest, uint16_t dport);
+int tcp_send(struct tcp_connection *tcp, const void *buf, size_t len);
+int tcp_recv(struct tcp_connection *tcp, void *buf, size_t len);
+void tcp_close(struct tcp_connection *tcp);
+
 void led_trigger_network(enum led_trigger trigger);
 
 #define IFUP_FLAG_FORCE		(1 << 0)
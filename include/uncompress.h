@@ -2,6 +2,9 @@
 #ifndef __UNCOMPRESS_H
 #define __UNCOMPRESS_H
 
+#include <filetype.h>
+#include <linux/types.h>
+
 int uncompress(unsigned char *inbuf, int len,
 	   int(*fill)(void*, unsigned int),
 	   int(*flush)(void*, unsigned int),
@@ -23,4 +26,15 @@ ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 
 void uncompress_err_stdout(char *);
 
+struct uncompress_stream;
+
+struct uncompress_stream *uncompress_stream_init(enum filetype type,
+						 void (*error_fn)(char *x));
+void uncompress_stream_feed(struct uncompress_stream *s, const void *in,
+			    size_t len);
+ssize_t uncompress_stream_drain(struct uncompress_stream *s, void *out,
+				size_t len);
+bool uncompress_stream_finished(struct uncompress_stream *s);
+void uncompress_stream_free(struct uncompress_stream *s);
+
 #endif /* __UNCOMPRESS_H */
@@ -672,9 +672,10 @@ static int start_bunzip(struct bunzip_data **bdp, void *inbuf, int len,
 
 /* Example usage: decompress src_fd to dst_fd.  (Stops at end of bzip2 data,
    not end of file.) */
-int bunzip2(unsigned char *buf, int len,
+static int __bunzip2(unsigned char *buf, int len,
 			int(*fill)(void*, unsigned int),
-			int(*flush)(void*, unsigned int),
+			int(*flush)(void *priv, void *buf, unsigned int len),
+			void *flush_priv,
 			unsigned char *outbuf,
 			int *pos,
 			void(*error)(char *x))
@@ -708,7 +709,7 @@ int bunzip2(unsigned char *buf, int len,
 			if (!flush)
 				outbuf += i;
 			else
-				if (i != flush(outbuf, i)) {
+				if (i != flush(flush_priv, outbuf, i)) {
 					i = RETVAL_UNEXPECTED_OUTPUT_EOF;
 					break;
 				}
@@ -739,6 +740,35 @@ exit_0:
 	return i;
 }
 
+static int bunzip2_flush(void *priv, void *buf, unsigned int len)
+{
+	int (*flush)(void *, unsigned int) = priv;
+
+	return flush(buf, len);
+}
+
+int bunzip2(unsigned char *buf, int len,
+			int(*fill)(void*, unsigned int),
+			int(*flush)(void*, unsigned int),
+			unsigned char *outbuf,
+			int *pos,
+			void(*error)(char *x))
+{
+	return __bunzip2(buf, len, fill, flush ? bunzip2_flush : NULL, flush,
+			 outbuf, pos, error);
+}
+
+/*
+ * Like bunzip2() with a flush function, but hands @priv to @flush so the
+ * caller does not need global state to find its output.
+ */
+int bunzip2_priv(unsigned char *buf, int len,
+		 int (*flush)(void *priv, void *buf, unsigned int len),
+		 void *priv, void (*error)(char *x))
+{
+	return __bunzip2(buf, len, NULL, flush, priv, NULL, NULL, error);
+}
+
 #ifdef PREBOOT
 STATIC int INIT decompress(unsigned char *buf, int len,
 			int(*fill)(void*, unsigned int),
@@ -109,9 +109,10 @@ static inline int parse_header(u8 *input, int *skip, int in_len)
 	return 1;
 }
 
-int decompress_unlzo(u8 *input, int in_len,
+static int __decompress_unlzo(u8 *input, int in_len,
 				int (*fill) (void *, unsigned int),
-				int (*flush) (void *, unsigned int),
+				int (*flush) (void *priv, void *buf, unsigned int len),
+				void *flush_priv,
 				u8 *output, int *posp,
 				void (*error) (char *x))
 {
@@ -255,7 +256,7 @@ int decompress_unlzo(u8 *input, int in_len,
 			}
 		}
 
-		if (flush && flush(out_buf, dst_len) != dst_len)
+		if (flush && flush(flush_priv, out_buf, dst_len) != dst_len)
 			goto exit_2;
 		if (output)
 			out_buf += dst_len;
@@ -287,4 +288,36 @@ exit_1:
 exit:
 	return ret;
 }
+
+static int unlzo_flush(void *priv, void *buf, unsigned int len)
+{
+	int (*flush)(void *, unsigned int) = priv;
+
+	return flush(buf, len);
+}
+
+int decompress_unlzo(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error) (char *x))
+{
+	return __decompress_unlzo(input, in_len, fill,
+				  flush ? unlzo_flush : NULL, flush,
+				  output, posp, error);
+}
+
+#ifndef __PBL__
+/*
+ * Like decompress_unlzo() with a flush function, but hands @priv to @flush
+ * so the caller does not need global state to find its output.
+ */
+int decompress_unlzo_priv(u8 *input, int in_len,
+			  int (*flush) (void *priv, void *buf, unsigned int len),
+			  void *priv, void (*error) (char *x))
+{
+	return __decompress_unlzo(input, in_len, NULL, flush, priv,
+				  NULL, NULL, error);
+}
+#endif
 #define decompress decompress_unlzo
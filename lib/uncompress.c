@@ -19,21 +19,911 @@
 #include <gunzip.h>
 #include <lzo.h>
 #include <linux/xz.h>
+#include <linux/zlib.h>
+#include <linux/zstd.h>
+#include <linux/lz4.h>
 #include <linux/decompress/unlz4.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
 #include <errno.h>
 #include <filetype.h>
 #include <malloc.h>
 #include <fs.h>
 #include <libfile.h>
 
-static void *uncompress_buf;
-static unsigned int uncompress_size;
+#define UNCOMPRESS_BUF_SIZE	SZ_64K
+
+struct uncompress_stream_ops {
+	enum filetype type;
+	int (*init)(struct uncompress_stream *s);
+	/*
+	 * Decompress into @out. Returns the number of bytes produced, 0 when
+	 * all input has been consumed without producing output or a negative
+	 * error code. Sets s->finished at the end of the compressed stream.
+	 */
+	ssize_t (*run)(struct uncompress_stream *s, void *out, size_t len);
+	void (*exit)(struct uncompress_stream *s);
+};
+
+struct uncompress_stream {
+	const struct uncompress_stream_ops *ops;
+	const u8 *in;
+	size_t in_len;
+	size_t consumed;
+	bool in_end;
+	bool finished;
+	void (*error_fn)(char *x);
+	void *priv;
+};
+
+static void uncompress_stream_consume(struct uncompress_stream *s, size_t len)
+{
+	s->in += len;
+	s->in_len -= len;
+	s->consumed += len;
+}
+
+/*
+ * Collect @len bytes of input in @buf, which already holds *@have bytes.
+ * Returns true when the buffer is complete.
+ */
+static bool __maybe_unused uncompress_stream_gather(struct uncompress_stream *s,
+						    void *buf, size_t *have,
+						    size_t len)
+{
+	size_t now = min(len - *have, s->in_len);
+
+	memcpy(buf + *have, s->in, now);
+	uncompress_stream_consume(s, now);
+	*have += now;
+
+	return *have == len;
+}
+
+#ifdef CONFIG_ZLIB
+#define GZ_FEXTRA	0x04
+#define GZ_FNAME	0x08
+#define GZ_FCOMMENT	0x10
+#define GZ_FHCRC	0x02
+
+enum gz_state {
+	GZ_HEADER,
+	GZ_EXTRA_LEN,
+	GZ_SKIP,
+	GZ_STRING,
+	GZ_DATA,
+};
+
+struct gz_stream {
+	struct z_stream_s strm;
+	enum gz_state state;
+	u8 hdr[10];
+	size_t have;
+	unsigned int flags;
+	unsigned int skip;
+};
+
+static enum gz_state gz_next_state(struct gz_stream *gz)
+{
+	gz->have = 0;
+
+	if (gz->flags & GZ_FEXTRA) {
+		gz->flags &= ~GZ_FEXTRA;
+		return GZ_EXTRA_LEN;
+	}
+	if (gz->flags & GZ_FNAME) {
+		gz->flags &= ~GZ_FNAME;
+		return GZ_STRING;
+	}
+	if (gz->flags & GZ_FCOMMENT) {
+		gz->flags &= ~GZ_FCOMMENT;
+		return GZ_STRING;
+	}
+	if (gz->flags & GZ_FHCRC) {
+		gz->flags &= ~GZ_FHCRC;
+		gz->skip = 2;
+		return GZ_SKIP;
+	}
+
+	return GZ_DATA;
+}
+
+static int gz_parse_header(struct uncompress_stream *s)
+{
+	struct gz_stream *gz = s->priv;
+	size_t now;
+
+	while (gz->state != GZ_DATA && s->in_len) {
+		switch (gz->state) {
+		case GZ_HEADER:
+			if (!uncompress_stream_gather(s, gz->hdr, &gz->have, 10))
+				break;
+			if (gz->hdr[0] != 0x1f || gz->hdr[1] != 0x8b ||
+			    gz->hdr[2] != 0x08) {
+				s->error_fn("Not a gzip file");
+				return -EINVAL;
+			}
+			gz->flags = gz->hdr[3];
+			gz->state = gz_next_state(gz);
+			break;
+		case GZ_EXTRA_LEN:
+			if (!uncompress_stream_gather(s, gz->hdr, &gz->have, 2))
+				break;
+			gz->skip = get_unaligned_le16(gz->hdr);
+			gz->state = GZ_SKIP;
+			break;
+		case GZ_SKIP:
+			now = min_t(size_t, gz->skip, s->in_len);
+			uncompress_stream_consume(s, now);
+			gz->skip -= now;
+			if (!gz->skip)
+				gz->state = gz_next_state(gz);
+			break;
+		case GZ_STRING:
+			now = *s->in;
+			uncompress_stream_consume(s, 1);
+			if (!now)
+				gz->state = gz_next_state(gz);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int gz_init(struct uncompress_stream *s)
+{
+	struct gz_stream *gz;
+
+	gz = xzalloc(sizeof(*gz));
+	gz->strm.workspace = malloc(zlib_inflate_workspacesize());
+	if (!gz->strm.workspace) {
+		free(gz);
+		return -ENOMEM;
+	}
+
+	if (zlib_inflateInit2(&gz->strm, -MAX_WBITS) != Z_OK) {
+		free(gz->strm.workspace);
+		free(gz);
+		return -EINVAL;
+	}
+
+	s->priv = gz;
+
+	return 0;
+}
+
+static ssize_t gz_run(struct uncompress_stream *s, void *out, size_t len)
+{
+	struct gz_stream *gz = s->priv;
+	size_t produced;
+	int ret;
+
+	ret = gz_parse_header(s);
+	if (ret)
+		return ret;
+
+	if (gz->state != GZ_DATA)
+		return 0;
+
+	gz->strm.next_in = s->in;
+	gz->strm.avail_in = s->in_len;
+	gz->strm.next_out = out;
+	gz->strm.avail_out = len;
+
+	ret = zlib_inflate(&gz->strm, 0);
+
+	uncompress_stream_consume(s, s->in_len - gz->strm.avail_in);
+	produced = len - gz->strm.avail_out;
+
+	/* the trailer and any following members are ignored like gunzip() does */
+	if (ret == Z_STREAM_END) {
+		s->finished = true;
+	} else if (ret != Z_OK && !(ret == Z_BUF_ERROR && !s->in_len)) {
+		s->error_fn("uncompression error");
+		return -EIO;
+	}
+
+	return produced;
+}
+
+static void gz_exit(struct uncompress_stream *s)
+{
+	struct gz_stream *gz = s->priv;
+
+	zlib_inflateEnd(&gz->strm);
+	free(gz->strm.workspace);
+	free(gz);
+}
+
+static const struct uncompress_stream_ops gz_stream_ops = {
+	.type = filetype_gzip,
+	.init = gz_init,
+	.run = gz_run,
+	.exit = gz_exit,
+};
+#endif
+
+#ifdef CONFIG_XZ_DECOMPRESS
+static int xz_init(struct uncompress_stream *s)
+{
+	xz_crc32_init();
+
+	s->priv = xz_dec_init(XZ_DYNALLOC, (uint32_t)-1);
+	if (!s->priv)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static ssize_t xz_run(struct uncompress_stream *s, void *out, size_t len)
+{
+	struct xz_buf b = {
+		.in = s->in,
+		.in_size = s->in_len,
+		.out = out,
+		.out_size = len,
+	};
+	enum xz_ret ret;
+
+	ret = xz_dec_run(s->priv, &b);
+
+	uncompress_stream_consume(s, b.in_pos);
+
+	switch (ret) {
+	case XZ_STREAM_END:
+		s->finished = true;
+		/* fall through */
+	case XZ_OK:
+		return b.out_pos;
+	case XZ_BUF_ERROR:
+		/* no progress possible, more input needed */
+		if (!s->in_len)
+			return b.out_pos;
+		s->error_fn("XZ-compressed data is corrupt");
+		return -EIO;
+	case XZ_MEM_ERROR:
+	case XZ_MEMLIMIT_ERROR:
+		s->error_fn("XZ decompressor ran out of memory");
+		return -ENOMEM;
+	case XZ_FORMAT_ERROR:
+		s->error_fn("Input is not in the XZ format (wrong magic bytes)");
+		return -EINVAL;
+	case XZ_OPTIONS_ERROR:
+		s->error_fn("Input was encoded with settings that are not "
+			    "supported by this XZ decoder");
+		return -EINVAL;
+	default:
+		s->error_fn("XZ-compressed data is corrupt");
+		return -EIO;
+	}
+}
+
+static void xz_exit(struct uncompress_stream *s)
+{
+	xz_dec_end(s->priv);
+}
+
+static const struct uncompress_stream_ops xz_stream_ops = {
+	.type = filetype_xz_compressed,
+	.init = xz_init,
+	.run = xz_run,
+	.exit = xz_exit,
+};
+#endif
+
+#ifdef CONFIG_ZSTD_DECOMPRESS
+struct zstd_stream {
+	ZSTD_DStream *dstream;
+	void *workspace;
+	/* the frame header is needed to size the window */
+	u8 hdr[ZSTD_FRAMEHEADERSIZE_MAX];
+	size_t have;
+	size_t hdr_pos;
+};
+
+static int zstd_init(struct uncompress_stream *s)
+{
+	s->priv = xzalloc(sizeof(struct zstd_stream));
+
+	return 0;
+}
+
+static int zstd_start(struct uncompress_stream *s)
+{
+	struct zstd_stream *zs = s->priv;
+	ZSTD_frameParams params;
+	size_t wsize, ret;
+
+	if (!uncompress_stream_gather(s, zs->hdr, &zs->have, sizeof(zs->hdr)) &&
+	    !s->in_end)
+		return 0;
+
+	ret = ZSTD_getFrameParams(&params, zs->hdr, zs->have);
+	if (ZSTD_isError(ret) || ret || !params.windowSize) {
+		s->error_fn("ZSTD-compressed data has an invalid frame header");
+		return -EINVAL;
+	}
+
+	wsize = ZSTD_DStreamWorkspaceBound(params.windowSize);
+	zs->workspace = malloc(wsize);
+	if (!zs->workspace) {
+		s->error_fn("ZSTD decompressor ran out of memory");
+		return -ENOMEM;
+	}
+
+	zs->dstream = ZSTD_initDStream(params.windowSize, zs->workspace, wsize);
+	if (!zs->dstream) {
+		s->error_fn("ZSTD_initDStream failed");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static ssize_t zstd_run(struct uncompress_stream *s, void *out, size_t len)
+{
+	struct zstd_stream *zs = s->priv;
+	ZSTD_outBuffer obuf = {
+		.dst = out,
+		.size = len,
+	};
+	ZSTD_inBuffer ibuf;
+	size_t ret;
+
+	if (!zs->dstream) {
+		int err = zstd_start(s);
+
+		if (err)
+			return err;
+		if (!zs->dstream)
+			return 0;
+	}
+
+	if (zs->hdr_pos < zs->have) {
+		ibuf.src = zs->hdr;
+		ibuf.size = zs->have;
+		ibuf.pos = zs->hdr_pos;
+	} else {
+		ibuf.src = s->in;
+		ibuf.size = s->in_len;
+		ibuf.pos = 0;
+	}
+
+	ret = ZSTD_decompressStream(zs->dstream, &obuf, &ibuf);
+
+	if (ibuf.src == zs->hdr)
+		zs->hdr_pos = ibuf.pos;
+	else
+		uncompress_stream_consume(s, ibuf.pos);
+
+	if (ZSTD_isError(ret)) {
+		s->error_fn("ZSTD-compressed data is corrupt");
+		return -EIO;
+	}
+
+	/* only a single frame is decompressed, like gunzip() does */
+	if (!ret)
+		s->finished = true;
+
+	return obuf.pos;
+}
+
+static void zstd_exit(struct uncompress_stream *s)
+{
+	struct zstd_stream *zs = s->priv;
+
+	free(zs->workspace);
+	free(zs);
+}
+
+static const struct uncompress_stream_ops zstd_stream_ops = {
+	.type = filetype_zstd_compressed,
+	.init = zstd_init,
+	.run = zstd_run,
+	.exit = zstd_exit,
+};
+#endif
+
+#ifdef CONFIG_LZ4_DECOMPRESS
+/* legacy lz4 format, see decompress_unlz4.c */
+#define LZ4_CHUNK_SIZE		(8 << 20)
+#define LZ4_ARCHIVE_MAGIC	0x184C2102
+
+struct lz4_stream {
+	u8 *inbuf;
+	size_t in_alloc;
+	u8 *outbuf;
+	u8 size[4];
+	size_t have;
+	size_t chunksize;
+	size_t out_len;
+	size_t out_pos;
+};
+
+static int lz4_init(struct uncompress_stream *s)
+{
+	struct lz4_stream *ls;
+
+	ls = xzalloc(sizeof(*ls));
+	ls->outbuf = malloc(LZ4_CHUNK_SIZE);
+	if (!ls->outbuf) {
+		free(ls);
+		return -ENOMEM;
+	}
+
+	s->priv = ls;
+
+	return 0;
+}
+
+static ssize_t lz4_run(struct uncompress_stream *s, void *out, size_t len)
+{
+	struct lz4_stream *ls = s->priv;
+	size_t now;
+	int ret;
+
+	while (ls->out_pos == ls->out_len) {
+		if (!ls->chunksize) {
+			if (!ls->have && !s->in_len && s->in_end) {
+				s->finished = true;
+				return 0;
+			}
+			if (!uncompress_stream_gather(s, ls->size, &ls->have, 4))
+				return 0;
+
+			ls->have = 0;
+			ls->chunksize = get_unaligned_le32(ls->size);
+			if (ls->chunksize == LZ4_ARCHIVE_MAGIC)
+				ls->chunksize = 0;
+			continue;
+		}
+
+		/*
+		 * lz4 compressed kernels have the uncompressed size appended,
+		 * which reads like the size of a chunk without any data.
+		 */
+		if (!ls->have && !s->in_len && s->in_end) {
+			s->finished = true;
+			return 0;
+		}
+
+		if (ls->chunksize > lz4_compressbound(LZ4_CHUNK_SIZE)) {
+			s->error_fn("chunk length is longer than allocated");
+			return -EINVAL;
+		}
+
+		/* most images are smaller than a single chunk */
+		if (ls->chunksize > ls->in_alloc) {
+			free(ls->inbuf);
+			ls->inbuf = malloc(ls->chunksize);
+			if (!ls->inbuf) {
+				ls->in_alloc = 0;
+				return -ENOMEM;
+			}
+			ls->in_alloc = ls->chunksize;
+		}
+
+		if (!uncompress_stream_gather(s, ls->inbuf, &ls->have,
+					      ls->chunksize))
+			return 0;
+
+		ls->out_len = LZ4_CHUNK_SIZE;
+		ret = lz4_decompress_unknownoutputsize(ls->inbuf, ls->chunksize,
+						       ls->outbuf, &ls->out_len);
+		if (ret < 0) {
+			s->error_fn("Decoding failed");
+			return -EIO;
+		}
+
+		ls->out_pos = 0;
+		ls->have = 0;
+		ls->chunksize = 0;
+	}
+
+	now = min(len, ls->out_len - ls->out_pos);
+	memcpy(out, ls->outbuf + ls->out_pos, now);
+	ls->out_pos += now;
+
+	return now;
+}
+
+static void lz4_exit(struct uncompress_stream *s)
+{
+	struct lz4_stream *ls = s->priv;
+
+	free(ls->inbuf);
+	free(ls->outbuf);
+	free(ls);
+}
+
+static const struct uncompress_stream_ops lz4_stream_ops = {
+	.type = filetype_lz4_compressed,
+	.init = lz4_init,
+	.run = lz4_run,
+	.exit = lz4_exit,
+};
+#endif
+
+#if defined(CONFIG_LZO_DECOMPRESS) || defined(CONFIG_BZLIB)
+/*
+ * The lzo and bzip2 decompressors can only pull their input through a
+ * fill callback. For them the input is collected and decompressed in one
+ * go once it is complete.
+ */
+struct buffered_stream {
+	int (*decompress)(unsigned char *inbuf, int len,
+			  int (*flush)(void *priv, void *buf, unsigned int len),
+			  void *priv, void (*error)(char *x));
+	u8 *inbuf;
+	size_t in_size;
+	size_t in_alloc;
+	u8 *outbuf;
+	size_t out_size;
+	size_t out_alloc;
+	size_t out_pos;
+	bool done;
+};
+
+static int buffered_flush(void *priv, void *buf, unsigned int len)
+{
+	struct buffered_stream *bs = priv;
+
+	if (bs->out_size + len > bs->out_alloc) {
+		size_t alloc = max(bs->out_alloc * 2, bs->out_size + len);
+		u8 *tmp = realloc(bs->outbuf, alloc);
+
+		if (!tmp)
+			return -ENOMEM;
+
+		bs->outbuf = tmp;
+		bs->out_alloc = alloc;
+	}
+
+	memcpy(bs->outbuf + bs->out_size, buf, len);
+	bs->out_size += len;
+
+	return len;
+}
+
+static ssize_t buffered_run(struct uncompress_stream *s, void *out, size_t len)
+{
+	struct buffered_stream *bs = s->priv;
+	size_t now;
+	int ret;
+
+	if (s->in_len) {
+		if (bs->in_size + s->in_len > bs->in_alloc) {
+			size_t alloc = max(bs->in_alloc * 2,
+					   bs->in_size + s->in_len);
+			u8 *tmp = realloc(bs->inbuf, alloc);
+
+			if (!tmp)
+				return -ENOMEM;
+
+			bs->inbuf = tmp;
+			bs->in_alloc = alloc;
+		}
+
+		memcpy(bs->inbuf + bs->in_size, s->in, s->in_len);
+		bs->in_size += s->in_len;
+		uncompress_stream_consume(s, s->in_len);
+	}
+
+	if (!s->in_end)
+		return 0;
+
+	if (!bs->done) {
+		ret = bs->decompress(bs->inbuf, bs->in_size, buffered_flush,
+				     bs, s->error_fn);
+		if (ret)
+			return -EIO;
+
+		bs->done = true;
+		free(bs->inbuf);
+		bs->inbuf = NULL;
+	}
+
+	now = min(len, bs->out_size - bs->out_pos);
+	memcpy(out, bs->outbuf + bs->out_pos, now);
+	bs->out_pos += now;
+
+	if (bs->out_pos == bs->out_size)
+		s->finished = true;
+
+	return now;
+}
+
+static void buffered_exit(struct uncompress_stream *s)
+{
+	struct buffered_stream *bs = s->priv;
+
+	free(bs->inbuf);
+	free(bs->outbuf);
+	free(bs);
+}
+#endif
+
+#ifdef CONFIG_LZO_DECOMPRESS
+static int lzo_init(struct uncompress_stream *s)
+{
+	struct buffered_stream *bs = xzalloc(sizeof(*bs));
+
+	bs->decompress = decompress_unlzo_priv;
+	s->priv = bs;
+
+	return 0;
+}
+
+static const struct uncompress_stream_ops lzo_stream_ops = {
+	.type = filetype_lzo_compressed,
+	.init = lzo_init,
+	.run = buffered_run,
+	.exit = buffered_exit,
+};
+#endif
+
+#ifdef CONFIG_BZLIB
+static int bzip2_init(struct uncompress_stream *s)
+{
+	struct buffered_stream *bs = xzalloc(sizeof(*bs));
+
+	bs->decompress = bunzip2_priv;
+	s->priv = bs;
+
+	return 0;
+}
+
+static const struct uncompress_stream_ops bzip2_stream_ops = {
+	.type = filetype_bzip2,
+	.init = bzip2_init,
+	.run = buffered_run,
+	.exit = buffered_exit,
+};
+#endif
+
+static const struct uncompress_stream_ops *uncompress_stream_ops[] = {
+#ifdef CONFIG_ZLIB
+	&gz_stream_ops,
+#endif
+#ifdef CONFIG_XZ_DECOMPRESS
+	&xz_stream_ops,
+#endif
+#ifdef CONFIG_ZSTD_DECOMPRESS
+	&zstd_stream_ops,
+#endif
+#ifdef CONFIG_LZ4_DECOMPRESS
+	&lz4_stream_ops,
+#endif
+#ifdef CONFIG_LZO_DECOMPRESS
+	&lzo_stream_ops,
+#endif
+#ifdef CONFIG_BZLIB
+	&bzip2_stream_ops,
+#endif
+};
+
+static const struct uncompress_stream_ops *uncompress_stream_find(enum filetype type)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(uncompress_stream_ops); i++)
+		if (uncompress_stream_ops[i]->type == type)
+			return uncompress_stream_ops[i];
+
+	return NULL;
+}
+
+/**
+ * uncompress_stream_init - create a streaming decompressor
+ * @type: The compression format of the input
+ * @error_fn: Called with a message when decompression fails
+ *
+ * All state is kept in the returned object, so any number of streams can be
+ * active at the same time.
+ *
+ * Return: The stream or an ERR_PTR, -ENOSYS if @type is not supported
+ */
+struct uncompress_stream *uncompress_stream_init(enum filetype type,
+						 void (*error_fn)(char *x))
+{
+	const struct uncompress_stream_ops *ops;
+	struct uncompress_stream *s;
+	int ret;
+
+	ops = uncompress_stream_find(type);
+	if (!ops)
+		return ERR_PTR(-ENOSYS);
+
+	s = xzalloc(sizeof(*s));
+	s->ops = ops;
+	s->error_fn = error_fn ?: uncompress_err_stdout;
+
+	ret = ops->init(s);
+	if (ret) {
+		free(s);
+		return ERR_PTR(ret);
+	}
+
+	return s;
+}
+
+/**
+ * uncompress_stream_feed - pass the next chunk of compressed data
+ * @s: The stream
+ * @in: The data
+ * @len: Size of @in, 0 to signal the end of the input
+ *
+ * @in must stay valid until uncompress_stream_drain() has consumed it,
+ * which is the case when it returns 0.
+ */
+void uncompress_stream_feed(struct uncompress_stream *s, const void *in,
+			    size_t len)
+{
+	s->in = in;
+	s->in_len = len;
+	if (!len)
+		s->in_end = true;
+}
+
+/**
+ * uncompress_stream_drain - get decompressed data
+ * @s: The stream
+ * @out: The output buffer
+ * @len: Size of @out
+ *
+ * Return: The number of bytes written to @out. 0 if more input is needed or
+ * the stream has ended, see uncompress_stream_finished(). A negative error
+ * code when the data is corrupt or ended prematurely.
+ */
+ssize_t uncompress_stream_drain(struct uncompress_stream *s, void *out,
+				size_t len)
+{
+	ssize_t ret;
+
+	if (s->finished)
+		return 0;
+
+	do {
+		ret = s->ops->run(s, out, len);
+	} while (!ret && s->in_len && !s->finished);
+
+	if (!ret && !s->finished && s->in_end) {
+		s->error_fn("unexpected end of compressed data");
+		return -EIO;
+	}
+
+	return ret;
+}
+
+bool uncompress_stream_finished(struct uncompress_stream *s)
+{
+	return s->finished;
+}
+
+void uncompress_stream_free(struct uncompress_stream *s)
+{
+	if (!s)
+		return;
+
+	s->ops->exit(s);
+	free(s);
+}
 
 void uncompress_err_stdout(char *x)
 {
 	printf("%s\n", x);
 }
 
+/* Where uncompress() gets its input from and puts its output to */
+struct uncompress_io {
+	const void *inbuf;
+	int inlen;
+	int (*fill)(void *, unsigned int);
+	int infd;
+	int (*flush)(void *, unsigned int);
+	int outfd;
+	void *output;
+	void (*error_fn)(char *x);
+};
+
+static int uncompress_io_read(struct uncompress_io *io, void *buf,
+			      unsigned int len)
+{
+	if (io->fill)
+		return io->fill(buf, len);
+	if (io->infd >= 0)
+		return read_full(io->infd, buf, len);
+
+	return 0;
+}
+
+static int uncompress_run_stream(struct uncompress_stream *s,
+				 struct uncompress_io *io,
+				 const void *head, int headlen, int *pos)
+{
+	void *inbuf = NULL, *outbuf = NULL;
+	size_t outpos = 0;
+	bool more_input = !io->inbuf;
+	ssize_t now;
+	int ret = 0;
+
+	if (!io->flush && io->outfd < 0 && !io->output)
+		return -EINVAL;
+
+	if (more_input)
+		inbuf = xmalloc(UNCOMPRESS_BUF_SIZE);
+	if (io->flush || io->outfd >= 0)
+		outbuf = xmalloc(UNCOMPRESS_BUF_SIZE);
+
+	uncompress_stream_feed(s, head, headlen);
+
+	while (!uncompress_stream_finished(s)) {
+		void *out = outbuf ?: io->output + outpos;
+
+		now = uncompress_stream_drain(s, out, UNCOMPRESS_BUF_SIZE);
+		if (now < 0) {
+			ret = now;
+			break;
+		}
+
+		if (now) {
+			if (io->flush)
+				ret = io->flush(out, now);
+			else if (io->outfd >= 0)
+				ret = write_full(io->outfd, out, now);
+			else
+				ret = now;
+
+			if (ret != now) {
+				io->error_fn("write error");
+				ret = ret < 0 ? ret : -EIO;
+				break;
+			}
+
+			ret = 0;
+			outpos += now;
+			continue;
+		}
+
+		if (uncompress_stream_finished(s))
+			break;
+
+		if (!more_input) {
+			uncompress_stream_feed(s, NULL, 0);
+			continue;
+		}
+
+		ret = uncompress_io_read(io, inbuf, UNCOMPRESS_BUF_SIZE);
+		if (ret < 0) {
+			io->error_fn("read error");
+			break;
+		}
+
+		more_input = ret > 0;
+		uncompress_stream_feed(s, inbuf, ret);
+		ret = 0;
+	}
+
+	if (pos)
+		*pos = s->consumed;
+
+	free(inbuf);
+	free(outbuf);
+
+	return ret;
+}
+
+/*
+ * Everything below is only used for compression formats without a
+ * streaming implementation. The decompressors pull their input through
+ * the fill callback, which has no context pointer, so this state has to
+ * be global and only one such decompression can run at a time.
+ */
+static void *uncompress_buf;
+static unsigned int uncompress_size;
 static int (*uncompress_fill_fn)(void*, unsigned int);
 
 static int uncompress_fill(void *buf, unsigned int len)
@@ -45,6 +935,7 @@ static int uncompress_fill(void *buf, unsigned int len)
 
 		memcpy(buf, uncompress_buf, now);
 		uncompress_size -= now;
+		uncompress_buf += now;
 		len -= now;
 		total = now;
 		buf += now;
@@ -60,41 +951,29 @@ static int uncompress_fill(void *buf, unsigned int len)
 	return total;
 }
 
-int uncompress(unsigned char *inbuf, int len,
-	   int(*fill)(void*, unsigned int),
-	   int(*flush)(void*, unsigned int),
-	   unsigned char *output,
-	   int *pos,
-	   void(*error_fn)(char *x))
+static int uncompress_infd, uncompress_outfd;
+
+static int fill_fd(void *buf, unsigned int len)
+{
+	return read_full(uncompress_infd, buf, len);
+}
+
+static int flush_fd(void *buf, unsigned int len)
+{
+	return write(uncompress_outfd, buf, len);
+}
+
+static int uncompress_run_legacy(enum filetype ft, struct uncompress_io *io,
+				 void *head, int headlen, int *pos)
 {
-	enum filetype ft;
 	int (*compfn)(unsigned char *inbuf, int len,
             int(*fill)(void*, unsigned int),
             int(*flush)(void*, unsigned int),
             unsigned char *output,
             int *pos,
             void(*error)(char *x));
-	int ret;
-	char *err;
-
-	if (inbuf) {
-		ft = file_detect_type(inbuf, len);
-		uncompress_buf = NULL;
-		uncompress_size = 0;
-	} else {
-		if (!fill)
-			return -EINVAL;
-
-		uncompress_fill_fn = fill;
-		uncompress_buf = xzalloc(32);
-		uncompress_size = 32;
-
-		ret = fill(uncompress_buf, 32);
-		if (ret < 0)
-			goto err;
-
-		ft = file_detect_type(uncompress_buf, 32);
-	}
+	int (*fill)(void *, unsigned int) = NULL;
+	int (*flush)(void *, unsigned int) = io->flush;
 
 	switch (ft) {
 #ifdef CONFIG_BZLIB
@@ -102,113 +981,203 @@ int uncompress(unsigned char *inbuf, int len,
 		compfn = bunzip2;
 		break;
 #endif
-#ifdef CONFIG_ZLIB
-	case filetype_gzip:
-		compfn = gunzip;
-		break;
-#endif
 #ifdef CONFIG_LZO_DECOMPRESS
 	case filetype_lzo_compressed:
 		compfn = decompress_unlzo;
 		break;
-#endif
-#ifdef CONFIG_LZ4_DECOMPRESS
-	case filetype_lz4_compressed:
-		compfn = decompress_unlz4;
-		break;
-#endif
-#ifdef CONFIG_XZ_DECOMPRESS
-	case filetype_xz_compressed:
-		compfn = decompress_unxz;
-		break;
 #endif
 	default:
+		return -ENOSYS;
+	}
+
+	if (!io->inbuf) {
+		uncompress_fill_fn = io->fill;
+		if (!io->fill) {
+			uncompress_infd = io->infd;
+			uncompress_fill_fn = fill_fd;
+		}
+		uncompress_buf = head;
+		uncompress_size = headlen;
+		fill = uncompress_fill;
+	}
+
+	if (!flush && io->outfd >= 0) {
+		uncompress_outfd = io->outfd;
+		flush = flush_fd;
+	}
+
+	return compfn((void *)io->inbuf, io->inlen, fill, flush, io->output,
+		      pos, io->error_fn);
+}
+
+static int __uncompress(struct uncompress_io *io, int *pos)
+{
+	struct uncompress_stream *s;
+	enum filetype ft;
+	void *head = NULL;
+	int headlen = 0;
+	char *err;
+	int ret;
+
+	if (!io->error_fn)
+		io->error_fn = uncompress_err_stdout;
+
+	if (io->inbuf) {
+		ft = file_detect_type(io->inbuf, io->inlen);
+		head = (void *)io->inbuf;
+		headlen = io->inlen;
+	} else {
+		if (!io->fill && io->infd < 0)
+			return -EINVAL;
+
+		head = xzalloc(32);
+		headlen = uncompress_io_read(io, head, 32);
+		if (headlen < 0) {
+			ret = headlen;
+			goto out;
+		}
+
+		ft = file_detect_type(head, 32);
+	}
+
+	if (ft == filetype_bzip2 || ft == filetype_lzo_compressed) {
+		/* unlike their streaming variant these don't buffer all input */
+		ret = uncompress_run_legacy(ft, io, head, headlen, pos);
+	} else {
+		s = uncompress_stream_init(ft, io->error_fn);
+		if (IS_ERR(s)) {
+			ret = PTR_ERR(s);
+		} else {
+			ret = uncompress_run_stream(s, io, head, headlen, pos);
+			uncompress_stream_free(s);
+		}
+	}
+
+	if (ret == -ENOSYS) {
 		err = basprintf("cannot handle filetype %s",
 				  file_type_to_string(ft));
-		error_fn(err);
+		io->error_fn(err);
 		free(err);
-		ret = -ENOSYS;
-		goto err;
 	}
-
-	ret = compfn(inbuf, len, fill ? uncompress_fill : NULL,
-			flush, output, pos, error_fn);
-err:
-	free(uncompress_buf);
+out:
+	if (!io->inbuf)
+		free(head);
 
 	return ret;
 }
 
-static int uncompress_infd, uncompress_outfd;
-
-static int fill_fd(void *buf, unsigned int len)
+int uncompress(unsigned char *inbuf, int len,
+	   int(*fill)(void*, unsigned int),
+	   int(*flush)(void*, unsigned int),
+	   unsigned char *output,
+	   int *pos,
+	   void(*error_fn)(char *x))
 {
-	return read_full(uncompress_infd, buf, len);
-}
+	struct uncompress_io io = {
+		.inbuf = inbuf,
+		.inlen = len,
+		.fill = fill,
+		.infd = -1,
+		.flush = flush,
+		.outfd = -1,
+		.output = output,
+		.error_fn = error_fn,
+	};
 
-static int flush_fd(void *buf, unsigned int len)
-{
-	return write(uncompress_outfd, buf, len);
+	return __uncompress(&io, pos);
 }
 
 int uncompress_fd_to_fd(int infd, int outfd,
 	   void(*error_fn)(char *x))
 {
-	uncompress_infd = infd;
-	uncompress_outfd = outfd;
+	struct uncompress_io io = {
+		.infd = infd,
+		.outfd = outfd,
+		.error_fn = error_fn,
+	};
 
-	return uncompress(NULL, 0,
-	   fill_fd,
-	   flush_fd,
-	   NULL,
-	   NULL,
-	   error_fn);
+	return __uncompress(&io, NULL);
 }
 
 int uncompress_fd_to_buf(int infd, void *output,
 		void(*error_fn)(char *x))
 {
-	uncompress_infd = infd;
+	struct uncompress_io io = {
+		.infd = infd,
+		.outfd = -1,
+		.output = output,
+		.error_fn = error_fn,
+	};
 
-	return uncompress(NULL, 0, fill_fd, NULL, output, NULL, error_fn);
+	return __uncompress(&io, NULL);
 }
 
 int uncompress_buf_to_fd(const void *input, size_t input_len,
 			 int outfd, void(*error_fn)(char *x))
 {
-	uncompress_outfd = outfd;
+	struct uncompress_io io = {
+		.inbuf = input,
+		.inlen = input_len,
+		.infd = -1,
+		.outfd = outfd,
+		.error_fn = error_fn,
+	};
 
-	return uncompress((void *)input, input_len, NULL, flush_fd,
-			  NULL, NULL, error_fn);
+	return __uncompress(&io, NULL);
 }
 
 ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 			      void **buf, void(*error_fn)(char *x))
 {
-	char *dstpath;
-	size_t size;
-	int outfd, ret;
+	struct uncompress_stream *s;
+	size_t size = 0, alloc = 0;
+	void *out = NULL, *tmp;
+	ssize_t now;
+	char *err;
 
-	dstpath = make_temp("data-uncompressed");
-	if (!dstpath)
-		return -ENOMEM;
+	s = uncompress_stream_init(file_detect_type(input, input_len), error_fn);
+	if (IS_ERR(s)) {
+		err = basprintf("cannot handle filetype %s",
+				file_type_to_string(file_detect_type(input, input_len)));
+		(error_fn ?: uncompress_err_stdout)(err);
+		free(err);
+		return PTR_ERR(s);
+	}
+
+	uncompress_stream_feed(s, input, input_len);
+
+	while (1) {
+		if (alloc - size < UNCOMPRESS_BUF_SIZE) {
+			alloc = max_t(size_t, alloc * 2, UNCOMPRESS_BUF_SIZE);
+			tmp = realloc(out, alloc);
+			if (!tmp) {
+				now = -ENOMEM;
+				goto err;
+			}
+			out = tmp;
+		}
+
+		now = uncompress_stream_drain(s, out + size, alloc - size);
+		if (now < 0)
+			goto err;
 
-	outfd = open(dstpath, O_CREAT | O_WRONLY);
-	if (outfd < 0) {
-		ret = -ENODEV;
-		goto free_temp;
+		size += now;
+
+		if (uncompress_stream_finished(s))
+			break;
+
+		if (!now)
+			uncompress_stream_feed(s, NULL, 0);
 	}
 
-	ret = uncompress_buf_to_fd(input, input_len, outfd, uncompress_err_stdout);
-	if (ret)
-		goto close_outfd;
+	uncompress_stream_free(s);
 
-	*buf = read_file(dstpath, &size);
-close_outfd:
-	close(outfd);
-	unlink(dstpath);
-free_temp:
-	free(dstpath);
+	*buf = out;
+
+	return size;
+err:
+	uncompress_stream_free(s);
+	free(out);
 
-	return ret ?: size;
+	return now;
 }
@@ -284,9 +284,13 @@ static void dhcp_options_handle(unsigned char option, void *popt,
 		case 3:
 			dhcp_result->gateway = net_read_ip(popt);
 			break;
-		case 6:
-			dhcp_result->nameserver = net_read_ip(popt);
+		case 6: {
+			int i;
+
+			for (i = 0; i < min(optlen / 4, NET_MAX_NAMESERVERS); i++)
+				dhcp_result->nameserver[i] = net_read_ip(popt + i * 4);
 			break;
+		}
 		case DHCP_HOSTNAME:
 			dhcp_result->hostname = xstrndup(popt, optlen);
 			break;
@@ -537,7 +541,7 @@ int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
 		"  netmask: %pI4\n"
 		"  gateway: %pI4\n"
 		"  serverip: %pI4\n"
-		"  nameserver: %pI4\n"
+		"  nameserver: %pI4 %pI4 %pI4\n"
 		"  hostname: %s\n"
 		"  domainname: %s\n"
 		"  rootpath: %s\n"
@@ -547,7 +551,9 @@ int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
 		&dhcp_result->netmask,
 		&dhcp_result->gateway,
 		&dhcp_result->serverip,
-		&dhcp_result->nameserver,
+		&dhcp_result->nameserver[0],
+		&dhcp_result->nameserver[1],
+		&dhcp_result->nameserver[2],
 		dhcp_result->hostname ? dhcp_result->hostname : "",
 		dhcp_result->domainname ? dhcp_result->domainname : "",
 		dhcp_result->rootpath ? dhcp_result->rootpath : "",
@@ -574,7 +580,7 @@ int dhcp_set_result(struct eth_device *edev, struct dhcp_result *res)
 	net_set_ip(edev, res->ip);
 	net_set_netmask(edev, res->netmask);
 	net_set_gateway(res->gateway);
-	net_set_nameserver(res->nameserver);
+	net_set_nameservers(res->nameserver, NET_MAX_NAMESERVERS);
 
 	set_res(&global_dhcp_bootfile, res->bootfile);
 	set_res(&global_dhcp_oftree_file, res->devicetree);
@@ -26,17 +26,36 @@
 
 #include <common.h>
 #include <command.h>
+#include <getopt.h>
 #include <net.h>
 #include <clock.h>
 #include <environment.h>
 #include <linux/err.h>
+#include <linux/list.h>
+#include <asm/unaligned.h>
 
 #define DNS_PORT 53
 
+/* overall time we wait for an answer from any nameserver */
+#define DNS_TIMEOUT		(10 * SECOND)
+#define DNS_RESEND		SECOND
+
+/* longest name that encodes into the 255 bytes RFC 1035 allows */
+#define DNS_MAX_NAME		253
+
+/* number of cached names and TTL of negative answers without SOA record */
+#define DNS_CACHE_SIZE		16
+#define DNS_NEGATIVE_TTL	60
+
+#define DNS_FLAG_RESPONSE	0x8000
+#define DNS_RCODE_MASK		0x000f
+#define DNS_RCODE_NXDOMAIN	3
+
 /* http://en.wikipedia.org/wiki/List_of_DNS_record_types */
 enum dns_query_type {
 	DNS_A_RECORD = 0x01,
 	DNS_CNAME_RECORD = 0x05,
+	DNS_SOA_RECORD = 0x06,
 	DNS_MX_RECORD = 0x0f,
 };
 
@@ -53,26 +72,125 @@ struct header {
 	unsigned char	data[1];	/* Data, variable length */
 };
 
+/* a resource record as found in the answer and authority sections */
+struct dns_rr {
+	u16 type;
+	u16 class;
+	u32 ttl;
+	u16 dlen;
+	const unsigned char *data;
+};
+
+struct dns_server {
+	IPaddr_t ip;
+	struct net_connection *con;
+	bool failed;
+};
+
+struct dns_cache_entry {
+	struct list_head list;
+	char *name;
+	IPaddr_t ip;		/* 0 for names known not to exist */
+	uint64_t expires;
+};
+
 #define STATE_INIT	0
 #define STATE_DONE	1
 
-static struct net_connection *dns_con;
 static uint64_t dns_timer_start;
 static uint16_t dns_req_id;
 static int dns_state;
 static IPaddr_t dns_ip;
+static u32 dns_ttl;
+
+/* most recently used entries first */
+static LIST_HEAD(dns_cache);
+static int dns_cache_num;
 
-static int dns_send(const char *name)
+static void dns_cache_free(struct dns_cache_entry *entry)
+{
+	list_del(&entry->list);
+	free(entry->name);
+	free(entry);
+	dns_cache_num--;
+}
+
+static struct dns_cache_entry *dns_cache_lookup(const char *name)
+{
+	struct dns_cache_entry *entry, *tmp;
+	uint64_t now = get_time_ns();
+
+	list_for_each_entry_safe(entry, tmp, &dns_cache, list) {
+		if (entry->expires <= now) {
+			dns_cache_free(entry);
+			continue;
+		}
+
+		if (!strcasecmp(entry->name, name)) {
+			list_move(&entry->list, &dns_cache);
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void dns_cache_add(const char *name, IPaddr_t ip, u32 ttl)
+{
+	struct dns_cache_entry *entry;
+
+	if (!ttl)
+		return;
+
+	entry = dns_cache_lookup(name);
+	if (!entry) {
+		if (dns_cache_num >= DNS_CACHE_SIZE)
+			dns_cache_free(list_last_entry(&dns_cache,
+						       struct dns_cache_entry, list));
+
+		entry = xzalloc(sizeof(*entry));
+		entry->name = xstrdup(name);
+		list_add(&entry->list, &dns_cache);
+		dns_cache_num++;
+	}
+
+	entry->ip = ip;
+	entry->expires = get_time_ns() + (uint64_t)ttl * SECOND;
+}
+
+void dns_cache_flush(void)
+{
+	struct dns_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &dns_cache, list)
+		dns_cache_free(entry);
+}
+
+/* the name to query and cache, with the default domain appended if needed */
+static char *dns_fullname(const char *name)
+{
+	const char *domain = getenv("global.net.domainname");
+
+	if (!strchr(name, '.') && domain && *domain)
+		return basprintf("%s.%s", name, domain);
+
+	return xstrdup(name);
+}
+
+static int dns_send(struct dns_server *srv, const char *fullname)
 {
-	int ret;
 	struct header *header;
 	enum dns_query_type qtype = DNS_A_RECORD;
-	unsigned char *packet = net_udp_get_payload(dns_con);
-	unsigned char *p, *s, *fullname, *dotptr;
-	const unsigned char *domain;
+	unsigned char *packet = net_udp_get_payload(srv->con);
+	unsigned char *p;
+	const char *s, *dot;
+	size_t namelen = strlen(fullname);
 
-	/* generate "difficult" to predict transaction id */
-	dns_req_id = dns_timer_start + (dns_timer_start >> 16);
+	/* a trailing dot marks the name as absolute and is not encoded */
+	if (namelen && fullname[namelen - 1] == '.')
+		namelen--;
+	if (namelen > DNS_MAX_NAME)
+		return -EINVAL;
 
 	/* Prepare DNS packet header */
 	header           = (struct header *)packet;
@@ -83,202 +201,357 @@ static int dns_send(const char *name)
 	header->nauth    = 0;
 	header->nother   = 0;
 
-	domain = getenv("global.net.domainname");
-
-	if (!strchr(name, '.') && domain && *domain)
-		fullname = basprintf(".%s.%s.", name, domain);
-	else
-		fullname = basprintf(".%s.", name);
-
-	/* replace dots in fullname with chunk len */
-	dotptr = fullname;
-	do {
+	/* encode the name as length prefixed labels */
+	p = header->data;
+	for (s = fullname; *s; s = dot + 1) {
 		int len;
 
-		s = strchr(dotptr + 1, '.');
-
-		len = s - dotptr - 1;
+		dot = strchrnul(s, '.');
+		len = dot - s;
+		if (!len || len > 63)
+			return -EINVAL;
 
-		*dotptr = len;
-		dotptr = s;
-	} while (*(dotptr + 1));
-	*dotptr = 0;
+		*p++ = len;
+		memcpy(p, s, len);
+		p += len;
 
-	strcpy(header->data, fullname);
-
-	p = header->data + strlen(fullname);
+		if (!*dot)
+			break;
+	}
 
 	*p++ = 0;			/* Mark end of host name */
-	*p++ = 0;			/* Some servers require double null */
+
+	*p++ = 0;
 	*p++ = (unsigned char)qtype;	/* Query Type */
 
 	*p++ = 0;
 	*p++ = 1;				/* Class: inet, 0x0001 */
 
-	ret = net_udp_send(dns_con, p - packet);
+	return net_udp_send(srv->con, p - packet);
+}
 
-	free(fullname);
+/* skip a possibly compressed name, returns NULL if it exceeds the packet */
+static const unsigned char *dns_skip_name(const unsigned char *p,
+					  const unsigned char *e)
+{
+	while (p < e) {
+		if ((*p & 0xc0) == 0xc0)
+			return p + 2 <= e ? p + 2 : NULL;
+		if (!*p)
+			return p + 1;
+		p += *p + 1;
+	}
 
-	return ret;
+	return NULL;
 }
 
-static void dns_recv(struct header *header, unsigned len)
+static const unsigned char *dns_read_rr(const unsigned char *p,
+					const unsigned char *e,
+					struct dns_rr *rr)
 {
-	unsigned char *p, *e, *s;
-	u16 type;
-	int found, stop, dlen;
-	short tmp;
+	p = dns_skip_name(p, e);
+	if (!p || p + 10 > e)
+		return NULL;
+
+	rr->type = get_unaligned_be16(p);
+	rr->class = get_unaligned_be16(p + 2);
+	rr->ttl = get_unaligned_be32(p + 4);
+	rr->dlen = get_unaligned_be16(p + 8);
+	rr->data = p + 10;
+
+	p += 10 + rr->dlen;
+
+	return p <= e ? p : NULL;
+}
+
+/* TTL for a negative answer from the SOA record in the authority section */
+static u32 dns_negative_ttl(const unsigned char *p, const unsigned char *e,
+			    int nauth)
+{
+	struct dns_rr rr;
+
+	while (nauth--) {
+		p = dns_read_rr(p, e, &rr);
+		if (!p)
+			break;
+
+		/* the SOA minimum is the last field of the record */
+		if (rr.type == DNS_SOA_RECORD && rr.dlen >= 20)
+			return min(rr.ttl, get_unaligned_be32(rr.data + rr.dlen - 4));
+	}
+
+	return DNS_NEGATIVE_TTL;
+}
+
+static void dns_recv(struct dns_server *srv, struct header *header,
+		     unsigned len)
+{
+	const unsigned char *p, *e;
+	struct dns_rr rr;
+	u16 flags;
+	u32 ttl = ~0;
+	int i, nanswers;
 
 	pr_debug("%s\n", __func__);
 
+	if (len < sizeof(*header) - 1)
+		return;
+
 	/* Only accept responses with the expected request id */
 	if (ntohs(header->tid) != dns_req_id) {
 		pr_debug("DNS response with incorrect id\n");
 		return;
 	}
 
-	/* We sent 1 query. We want to see more that 1 answer. */
-	if (ntohs(header->nqueries) != 1)
+	flags = ntohs(header->flags);
+	if (!(flags & DNS_FLAG_RESPONSE) || ntohs(header->nqueries) != 1)
 		return;
 
-	/* Received 0 answers */
-	if (header->nanswers == 0) {
-		dns_state = STATE_DONE;
-		pr_debug("DNS server returned no answers\n");
+	switch (flags & DNS_RCODE_MASK) {
+	case 0:
+	case DNS_RCODE_NXDOMAIN:
+		break;
+	default:
+		pr_debug("nameserver %pI4 failed with %d\n", &srv->ip,
+			 flags & DNS_RCODE_MASK);
+		srv->failed = true;
 		return;
 	}
 
-	/* Skip host name */
-	s = &header->data[0];
-	e = ((uint8_t *)header) + len;
-	for (p = s; p < e && *p != '\0'; p++)
-		continue;
+	e = (unsigned char *)header + len;
 
-	/* We sent query class 1, query type 1 */
-	tmp = p[1] | (p[2] << 8);
-	if (&p[5] > e || ntohs(tmp) != DNS_A_RECORD) {
-		pr_debug("DNS response was not A record\n");
+	/* Skip the question: host name, type and class */
+	p = dns_skip_name(header->data, e);
+	if (!p || p + 4 > e)
 		return;
-	}
-
-	/* Go to the first answer section */
-	p += 5;
-
-	/* Loop through the answers, we want A type answer */
-	for (found = stop = 0; !stop && &p[12] < e; ) {
-
-		/* Skip possible name in CNAME answer */
-		if (*p != 0xc0) {
-			while (*p && &p[12] < e)
-				p++;
-			p--;
-		}
-		pr_debug("Name (Offset in header): %d\n", p[1]);
-
-		tmp = p[2] | (p[3] << 8);
-		type = ntohs(tmp);
-		pr_debug("type = %d\n", type);
-		if (type == DNS_CNAME_RECORD) {
-			/* CNAME answer. shift to the next section */
-			debug("Found canonical name\n");
-			tmp = p[10] | (p[11] << 8);
-			dlen = ntohs(tmp);
-			pr_debug("dlen = %d\n", dlen);
-			p += 12 + dlen;
-		} else if (type == DNS_A_RECORD) {
-			pr_debug("Found A-record\n");
-			found = stop = 1;
-		} else {
-			pr_debug("Unknown type\n");
-			stop = 1;
+	p += 4;
+
+	/*
+	 * Loop through the answers, we want the first A record. It is
+	 * possibly preceded by the CNAME chain leading to it, the result
+	 * is valid as long as all records along the chain are.
+	 */
+	nanswers = ntohs(header->nanswers);
+	for (i = 0; i < nanswers; i++) {
+		p = dns_read_rr(p, e, &rr);
+		if (!p)
+			return;
+
+		pr_debug("type = %d\n", rr.type);
+
+		if (rr.type == DNS_CNAME_RECORD) {
+			ttl = min(ttl, rr.ttl);
+		} else if (rr.type == DNS_A_RECORD && rr.class == 1 &&
+			   rr.dlen == 4) {
+			dns_ip = net_read_ip((void *)rr.data);
+			dns_ttl = min(ttl, rr.ttl);
+			dns_state = STATE_DONE;
+			return;
 		}
 	}
 
-	if (found && &p[12] < e) {
-
-		tmp = p[10] | (p[11] << 8);
-		dlen = ntohs(tmp);
-		p += 12;
-		dns_ip = net_read_ip(p);
-		dns_state = STATE_DONE;
-	}
+	/* name does not exist or has no A record */
+	pr_debug("DNS server returned no answers\n");
+	dns_ip = 0;
+	dns_ttl = dns_negative_ttl(p, e, ntohs(header->nauth));
+	dns_state = STATE_DONE;
 }
 
 static void dns_handler(void *ctx, char *packet, unsigned len)
 {
-	(void)ctx;
-	dns_recv((struct header *)net_eth_to_udp_payload(packet),
+	dns_recv(ctx, (struct header *)net_eth_to_udp_payload(packet),
 		net_eth_to_udplen(packet));
 }
 
-int resolv(const char *host, IPaddr_t *ip)
+static int dns_query(const char *name, IPaddr_t *ip)
 {
-	IPaddr_t nameserver;
+	struct dns_server servers[NET_MAX_NAMESERVERS] = {};
+	IPaddr_t ips[NET_MAX_NAMESERVERS];
+	uint64_t start;
+	int i, num, nfailed, ret;
 
-	if (!string_to_ip(host, ip))
-		return 0;
-
-	dns_ip = 0;
-	*ip = 0;
-
-	dns_state = STATE_INIT;
-
-	nameserver = net_get_nameserver();
-	if (!nameserver) {
+	num = net_get_nameservers(ips);
+	if (!num) {
 		pr_err("no nameserver specified in $global.net.nameserver\n");
 		return -ENOENT;
 	}
 
-	pr_debug("resolving host %s via nameserver %pI4\n", host, &nameserver);
+	dns_ip = 0;
+	dns_state = STATE_INIT;
 
-	dns_con = net_udp_new(nameserver, DNS_PORT, dns_handler, NULL);
-	if (IS_ERR(dns_con))
-		return PTR_ERR(dns_con);
 	dns_timer_start = get_time_ns();
-	dns_send(host);
+
+	/* generate "difficult" to predict transaction id */
+	dns_req_id = dns_timer_start + (dns_timer_start >> 16);
+
+	/*
+	 * Ask all nameservers at once, the first answer wins. Setting up a
+	 * connection may have to wait for ARP, so an answer can arrive before
+	 * all queries are out, the remaining servers are not asked then.
+	 */
+	for (i = 0; i < num; i++) {
+		struct dns_server *srv = &servers[i];
+
+		srv->ip = ips[i];
+
+		if (dns_state == STATE_DONE) {
+			srv->failed = true;
+			continue;
+		}
+
+		pr_debug("resolving host %s via nameserver %pI4\n", name, &ips[i]);
+
+		srv->con = net_udp_new(srv->ip, DNS_PORT, dns_handler, srv);
+		if (IS_ERR(srv->con)) {
+			pr_debug("nameserver %pI4: %s\n", &srv->ip,
+				 strerror(-PTR_ERR(srv->con)));
+			srv->con = NULL;
+			srv->failed = true;
+			continue;
+		}
+
+		ret = dns_send(srv, name);
+		if (ret)
+			goto out;
+	}
+
+	start = dns_timer_start = get_time_ns();
 
 	while (dns_state != STATE_DONE) {
 		if (ctrlc()) {
-			break;
+			ret = -EINTR;
+			goto out;
 		}
+
 		net_poll();
-		if (is_timeout(dns_timer_start, SECOND)) {
+
+		for (i = 0, nfailed = 0; i < num; i++)
+			nfailed += servers[i].failed;
+		if (nfailed == num) {
+			ret = -EIO;
+			goto out;
+		}
+
+		if (is_timeout(start, DNS_TIMEOUT)) {
+			ret = -ETIMEDOUT;
+			goto out;
+		}
+
+		if (is_timeout(dns_timer_start, DNS_RESEND)) {
 			dns_timer_start = get_time_ns();
 			printf("T ");
-			dns_send(host);
+			for (i = 0; i < num; i++)
+				if (!servers[i].failed)
+					dns_send(&servers[i], name);
 		}
 	}
 
-	net_unregister(dns_con);
+	*ip = dns_ip;
+	ret = 0;
+out:
+	for (i = 0; i < num; i++)
+		if (servers[i].con)
+			net_unregister(servers[i].con);
+
+	return ret;
+}
+
+int resolv(const char *host, IPaddr_t *ip)
+{
+	struct dns_cache_entry *entry;
+	char *fullname;
+	int ret;
+
+	if (!string_to_ip(host, ip))
+		return 0;
+
+	*ip = 0;
+
+	fullname = dns_fullname(host);
 
-	if (dns_ip) {
-		pr_debug("host %s is at %pI4\n", host, &dns_ip);
+	entry = dns_cache_lookup(fullname);
+	if (entry) {
+		pr_debug("host %s found in cache\n", fullname);
+		*ip = entry->ip;
+		ret = 0;
 	} else {
+		ret = dns_query(fullname, ip);
+		if (!ret)
+			dns_cache_add(fullname, *ip, dns_ttl);
+	}
+
+	free(fullname);
+
+	if (ret) {
+		pr_debug("resolving %s failed: %s\n", host, strerror(-ret));
+		return ret;
+	}
+
+	if (!*ip) {
 		pr_debug("host %s not found\n", host);
 		return -ENOENT;
 	}
 
-	*ip = dns_ip;
+	pr_debug("host %s is at %pI4\n", host, ip);
 
 	return 0;
 }
 
 #ifdef CONFIG_CMD_HOST
+static void dns_cache_list(void)
+{
+	struct dns_cache_entry *entry, *tmp;
+	uint64_t now = get_time_ns();
+
+	list_for_each_entry_safe(entry, tmp, &dns_cache, list) {
+		if (entry->expires <= now) {
+			dns_cache_free(entry);
+			continue;
+		}
+
+		if (entry->ip)
+			printf("%-40s %-15pI4", entry->name, &entry->ip);
+		else
+			printf("%-40s %-15s", entry->name, "not found");
+
+		printf(" %llus\n", (entry->expires - now) / SECOND);
+	}
+}
+
 static int do_host(int argc, char *argv[])
 {
 	IPaddr_t ip;
-	int ret;
+	int ret, opt;
+	bool list = false, flush = false;
 	char *hostname, *varname = NULL;
 
-	if (argc < 2)
-		return COMMAND_ERROR_USAGE;
+	while ((opt = getopt(argc, argv, "lf")) > 0) {
+		switch (opt) {
+		case 'l':
+			list = true;
+			break;
+		case 'f':
+			flush = true;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (flush)
+		dns_cache_flush();
+	if (list)
+		dns_cache_list();
 
-	hostname = argv[1];
+	if (optind == argc)
+		return list || flush ? 0 : COMMAND_ERROR_USAGE;
 
-	if (argc > 2)
-		varname = argv[2];
+	hostname = argv[optind];
 
-	ret = resolv(argv[1], &ip);
+	if (optind + 1 < argc)
+		varname = argv[optind + 1];
+
+	ret = resolv(hostname, &ip);
 	if (ret) {
 		printf("unknown host %s\n", hostname);
 		return 1;
@@ -292,10 +565,20 @@ static int do_host(int argc, char *argv[])
 	return 0;
 }
 
+BAREBOX_CMD_HELP_START(host)
+BAREBOX_CMD_HELP_TEXT("Resolve HOSTNAME and print its address or store it in VARIABLE.")
+BAREBOX_CMD_HELP_TEXT("Answers are cached as long as their TTL permits.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-l", "list the DNS cache")
+BAREBOX_CMD_HELP_OPT ("-f", "flush the DNS cache")
+BAREBOX_CMD_HELP_END
+
 BAREBOX_CMD_START(host)
 	.cmd		= do_host,
 	BAREBOX_CMD_DESC("resolve a hostname")
-	BAREBOX_CMD_OPTS("<HOSTNAME> [VARIABLE]")
+	BAREBOX_CMD_OPTS("[-lf] [HOSTNAME [VARIABLE]]")
 	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_host_help)
 BAREBOX_CMD_END
 #endif
@@ -33,10 +33,23 @@ static LIST_HEAD(ethaddr_list);
 
 int eth_set_promisc(struct eth_device *edev, bool enable)
 {
+	int ret;
+
 	if (!edev->set_promisc)
 		return -EOPNOTSUPP;
 
-	return edev->set_promisc(edev, enable);
+	if (!enable && !edev->promisc)
+		return 0;
+
+	/* only the first user enables it and the last one disables it */
+	if (enable ? edev->promisc++ : --edev->promisc)
+		return 0;
+
+	ret = edev->set_promisc(edev, enable);
+	if (ret && enable)
+		edev->promisc--;
+
+	return ret;
 }
 
 int eth_set_ethaddr(struct eth_device *edev, const char *ethaddr)
@@ -217,32 +230,20 @@ static int eth_carrier_check(struct eth_device *edev, bool may_wait)
 	return edev->phydev->link ? 0 : -ENETDOWN;
 }
 
-struct eth_q {
-	struct eth_device *edev;
-	int length;
-	struct list_head list;
-	void *data;
-};
-
 static int eth_queue(struct eth_device *edev, void *packet, int length)
 {
-	struct eth_q *q;
+	struct net_pktbuf *pb;
 
-	q = xzalloc(sizeof(*q));
-	if (!q)
-		return -ENOMEM;
+	if (length > PKTSIZE)
+		return -EMSGSIZE;
 
-	q->data = dma_alloc(length);
-	if (!q->data) {
-		free(q);
+	pb = net_pktbuf_alloc_tx(edev);
+	if (!pb)
 		return -ENOMEM;
-	}
-
-	q->length = length;
-	q->edev = edev;
 
-	memcpy(q->data, packet, length);
-	list_add_tail(&q->list, &edev->send_queue);
+	memcpy(pb->data, packet, length);
+	pb->len = length;
+	list_add_tail(&pb->list, &edev->send_queue);
 
 	return 0;
 }
@@ -272,45 +273,64 @@ int eth_send(struct eth_device *edev, void *packet, int length)
 	return ret;
 }
 
-static void eth_do_work(struct eth_device *edev)
+/* frames received per device before the others get their turn */
+#define ETH_RX_BUDGET	32
+
+/* returns true when the driver has more frames pending */
+static bool eth_do_work(struct eth_device *edev)
 {
-	struct eth_q *q, *tmp;
+	struct net_pktbuf *pb, *tmp;
+	bool pending = false;
+	int budget = ETH_RX_BUDGET;
 	int ret;
 
 	if (!phy_acquired(edev->phydev)) {
 		ret = eth_carrier_check(edev, false);
 		if (ret)
-			return;
+			return false;
 	}
 
 	if (slice_acquired(eth_device_slice(edev)))
-		return;
+		return false;
 
 	slice_acquire(eth_device_slice(edev));
 
-	edev->recv(edev);
+	/*
+	 * A DSA master passes each frame to a port, which holds only one.
+	 * Let the port pick it up before receiving the next.
+	 */
+	if (edev->rx_preprocessor)
+		budget = 1;
+
+	if (edev->recv_budget)
+		pending = edev->recv_budget(edev, budget) >= budget;
+	else
+		edev->recv(edev);
 
-	list_for_each_entry_safe(q, tmp, &edev->send_queue, list) {
+	list_for_each_entry_safe(pb, tmp, &edev->send_queue, list) {
 		led_trigger_network(LED_TRIGGER_NET_TX);
-		eth_send_raw(edev, q->data, q->length);
-		list_del(&q->list);
-		free(q->data);
-		free(q);
+		eth_send_raw(edev, pb->data, pb->len);
+		list_del_init(&pb->list);
+		net_pktbuf_put(pb);
 	}
 
 	slice_release(eth_device_slice(edev));
+
+	return pending;
 }
 
+/* returns 1 if a device has more frames pending, 0 otherwise */
 int eth_rx(void)
 {
 	struct eth_device *edev;
+	int pending = 0;
 
 	for_each_netdev(edev) {
-		if (edev->active)
-			eth_do_work(edev);
+		if (edev->active && eth_do_work(edev))
+			pending = 1;
 	}
 
-	return 0;
+	return pending;
 }
 
 static int eth_param_set_ethaddr(struct param_d *param, void *priv)
@@ -320,6 +340,16 @@ static int eth_param_set_ethaddr(struct param_d *param, void *priv)
 	return eth_set_ethaddr(edev, edev->ethaddr);
 }
 
+static int eth_param_set_ipaddr(struct param_d *param, void *priv)
+{
+	struct eth_device *edev = priv;
+
+	/* the new address is already set, so flush unconditionally */
+	net_neigh_flush(edev);
+
+	return 0;
+}
+
 #ifdef CONFIG_OFTREE
 static void eth_of_fixup_node(struct device_node *root,
 			      const char *node_path, int ethid,
@@ -421,6 +451,7 @@ int eth_register(struct eth_device *edev)
 	}
 
 	INIT_LIST_HEAD(&edev->send_queue);
+	INIT_LIST_HEAD(&edev->neighbours);
 
 	ret = register_device(&edev->dev);
 	if (ret)
@@ -430,7 +461,8 @@ int eth_register(struct eth_device *edev)
 
 	edev->devname = xstrdup(dev_name(&edev->dev));
 
-	dev_add_param_ip(dev, "ipaddr", NULL, NULL, &edev->ipaddr, edev);
+	dev_add_param_ip(dev, "ipaddr", eth_param_set_ipaddr, NULL,
+			 &edev->ipaddr, edev);
 	dev_add_param_string(dev, "serverip", NULL, NULL, &net_server, edev);
 	dev_add_param_ip(dev, "gateway", NULL, NULL, &net_gateway, edev);
 	dev_add_param_ip(dev, "netmask", NULL, NULL, &edev->netmask, edev);
@@ -443,6 +475,8 @@ int eth_register(struct eth_device *edev)
 	dev_add_param_enum(dev, "mode", NULL, NULL, &edev->global_mode,
 				  eth_mode_names, ARRAY_SIZE(eth_mode_names),
 				  NULL);
+	dev_add_param_uint32_ro(dev, "pool_exhausted", &edev->pool_exhausted,
+				"%u");
 
 	if (edev->init)
 		edev->init(edev);
@@ -497,20 +531,18 @@ void eth_close(struct eth_device *edev)
 
 void eth_unregister(struct eth_device *edev)
 {
-	struct eth_q *q, *tmp;
+	struct net_pktbuf *pb, *tmp;
 
 	if (edev->active)
 		edev->halt(edev);
 
-	list_for_each_entry_safe(q, tmp, &edev->send_queue, list) {
-		if (q->edev != edev)
-			continue;
-
-		list_del(&q->list);
-		free(q->data);
-		free(q);
+	list_for_each_entry_safe(pb, tmp, &edev->send_queue, list) {
+		list_del_init(&pb->list);
+		net_pktbuf_put(pb);
 	}
 
+	net_neigh_flush(edev);
+
 	if (IS_ENABLED(CONFIG_OFDEVICE))
 		free(edev->nodepath);
 
@@ -133,7 +133,7 @@ static int source_env_network(struct eth_device *edev)
 		memcpy(edev->ethaddr, ethaddr, 6);
 
 	if (mode == ETH_MODE_STATIC) {
-		edev->ipaddr = ipaddr;
+		net_set_ip(edev, ipaddr);
 		edev->netmask = netmask;
 		if (gateway)
 			net_set_gateway(gateway);
@@ -206,7 +206,7 @@ int ifup_edev(struct eth_device *edev, unsigned flags)
 	int ret;
 
 	if (edev->global_mode == ETH_MODE_DISABLED) {
-		edev->ipaddr = 0;
+		net_set_ip(edev, 0);
 		edev->netmask = 0;
 		edev->ifup = false;
 		return 0;
@@ -236,6 +236,7 @@ int ifup_edev(struct eth_device *edev, unsigned flags)
 void ifdown_edev(struct eth_device *edev)
 {
 	eth_close(edev);
+	net_neigh_flush(edev);
 	edev->ifup = false;
 }
 
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * ip_frag.c - IPv4 fragment reassembly
+ *
+ * A fixed number of datagrams can be reassembled in parallel. Incomplete
+ * datagrams are dropped after IP_FRAG_TIMEOUT or when their slot is needed
+ * for a newer datagram.
+ */
+
+#define pr_fmt(fmt) "ip_frag: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <malloc.h>
+#include <net.h>
+#include <linux/bitmap.h>
+
+#define IP_FRAG_SLOTS		CONFIG_NET_IP_REASSEMBLY_SLOTS
+#define IP_FRAG_MAX_SIZE	CONFIG_NET_IP_REASSEMBLY_MAX_SIZE
+#define IP_FRAG_MAX_PAYLOAD	(IP_FRAG_MAX_SIZE - sizeof(struct iphdr))
+#define IP_FRAG_TIMEOUT		(2 * SECOND)
+
+/* received data is tracked in the 8 byte units of the fragment offset */
+#define IP_FRAG_UNITS		DIV_ROUND_UP(IP_FRAG_MAX_PAYLOAD, 8)
+
+struct ip_frag_queue {
+	bool used;
+	IPaddr_t saddr;
+	IPaddr_t daddr;
+	uint16_t id;
+	uint8_t protocol;
+	uint64_t start;
+	/* payload length, known once the last fragment has arrived */
+	unsigned int len;
+	/* ethernet header, IP header and payload of the datagram */
+	unsigned char *buf;
+	unsigned long received[BITS_TO_LONGS(IP_FRAG_UNITS)];
+};
+
+static struct ip_frag_queue ip_frag_queues[IP_FRAG_SLOTS];
+
+static bool ip_frag_match(struct ip_frag_queue *q, struct iphdr *ip)
+{
+	return q->used && q->id == ip->id && q->protocol == ip->protocol &&
+	       q->saddr == net_read_ip(&ip->saddr) &&
+	       q->daddr == net_read_ip(&ip->daddr);
+}
+
+static struct ip_frag_queue *ip_frag_find(struct iphdr *ip)
+{
+	struct ip_frag_queue *q, *victim = NULL;
+	int i;
+
+	for (i = 0; i < IP_FRAG_SLOTS; i++) {
+		q = &ip_frag_queues[i];
+
+		if (q->used && is_timeout(q->start, IP_FRAG_TIMEOUT)) {
+			pr_debug("dropping incomplete datagram %u\n",
+				 ntohs(q->id));
+			q->used = false;
+		}
+
+		if (ip_frag_match(q, ip))
+			return q;
+
+		if (!victim || (victim->used &&
+				(!q->used || q->start < victim->start)))
+			victim = q;
+	}
+
+	if (victim->used)
+		pr_debug("no free slot, dropping incomplete datagram %u\n",
+			 ntohs(victim->id));
+
+	if (!victim->buf) {
+		victim->buf = malloc(ETHER_HDR_SIZE + IP_FRAG_MAX_SIZE);
+		if (!victim->buf)
+			return NULL;
+	}
+
+	victim->used = true;
+	victim->id = ip->id;
+	victim->protocol = ip->protocol;
+	victim->saddr = net_read_ip(&ip->saddr);
+	victim->daddr = net_read_ip(&ip->daddr);
+	victim->start = get_time_ns();
+	victim->len = 0;
+	bitmap_zero(victim->received, IP_FRAG_UNITS);
+
+	return victim;
+}
+
+/**
+ * net_ip_defrag - add a fragment to its datagram
+ * @pkt: the ethernet frame containing the fragment
+ * @len: length of the frame, updated to the length of the reassembled frame
+ *
+ * Return: the reassembled frame once all fragments have been received,
+ * NULL otherwise. The frame is valid until the next call.
+ */
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct ip_frag_queue *q;
+	unsigned int frag_off = ntohs(ip->frag_off);
+	unsigned int offset = (frag_off & IP_OFFSET) * 8;
+	unsigned int tot_len = ntohs(ip->tot_len);
+	unsigned int plen, units;
+	bool more = frag_off & IP_MF;
+
+	/* we don't do IP options */
+	if (ip->hl_v != 0x45 || tot_len <= sizeof(struct iphdr))
+		return NULL;
+
+	plen = tot_len - sizeof(struct iphdr);
+
+	/* all but the last fragment carry a multiple of 8 bytes */
+	if (more && (plen & 7))
+		return NULL;
+
+	if (offset + plen > IP_FRAG_MAX_PAYLOAD) {
+		pr_debug("datagram %u too large\n", ntohs(ip->id));
+		return NULL;
+	}
+
+	q = ip_frag_find(ip);
+	if (!q)
+		return NULL;
+
+	if (!more) {
+		if (q->len && q->len != offset + plen)
+			goto drop;
+		q->len = offset + plen;
+	}
+
+	if (q->len && offset + plen > q->len)
+		goto drop;
+
+	/* the headers of the first fragment become the datagram's headers */
+	if (!offset)
+		memcpy(q->buf, pkt, ETHER_HDR_SIZE + sizeof(struct iphdr));
+
+	memcpy(q->buf + ETHER_HDR_SIZE + sizeof(struct iphdr) + offset,
+	       ip + 1, plen);
+
+	bitmap_set(q->received, offset / 8, DIV_ROUND_UP(plen, 8));
+
+	if (!q->len)
+		return NULL;
+
+	units = DIV_ROUND_UP(q->len, 8);
+	if (find_first_zero_bit(q->received, units) < units)
+		return NULL;
+
+	ip = (struct iphdr *)(q->buf + ETHER_HDR_SIZE);
+	ip->tot_len = htons(sizeof(struct iphdr) + q->len);
+	ip->frag_off = 0;
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(struct iphdr));
+
+	q->used = false;
+	*len = ETHER_HDR_SIZE + sizeof(struct iphdr) + q->len;
+
+	return q->buf;
+
+drop:
+	pr_debug("inconsistent fragments for datagram %u\n", ntohs(ip->id));
+	q->used = false;
+
+	return NULL;
+}
@@ -0,0 +1,591 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * mcrecv.c - receive an image sent to many boards at once via multicast
+ *
+ * The sender (see scripts/mcsend) multicasts the image in blocks to a group
+ * all receivers have joined. Every block is sent once in the first pass.
+ * At the end of each pass the sender asks for repair requests, receivers
+ * which miss blocks answer with a NACK listing the missing ranges and the
+ * sender multicasts the union of them in the next pass. Receivers which
+ * have everything send DONE and leave.
+ *
+ * All fields are big endian, every packet starts with struct mc_hdr:
+ *
+ * sender -> group:
+ *   ANNOUNCE   u64 size, u16 block size, u16 reserved
+ *   DATA       u32 block number, data
+ *   PASS_END   u32 pass
+ *   FINISHED   -
+ * receiver -> sender:
+ *   NACK       u32 pass, u16 number of ranges, u16 reserved,
+ *              ranges of u32 first block, u32 number of blocks
+ *   DONE       -
+ *
+ * ANNOUNCE is repeated throughout the transfer so that receivers can join
+ * late, they get the blocks sent before via the repair passes.
+ */
+
+#define pr_fmt(fmt) "mcrecv: " fmt
+
+#include <common.h>
+#include <command.h>
+#include <clock.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <net.h>
+#include <progress.h>
+#include <stdlib.h>
+#include <linux/bitmap.h>
+#include <linux/err.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
+
+#define MC_MAGIC		0x62626d63	/* "bbmc" */
+#define MC_VERSION		1
+
+#define MC_ANNOUNCE		1
+#define MC_DATA			2
+#define MC_PASS_END		3
+#define MC_FINISHED		4
+#define MC_NACK			5
+#define MC_DONE			6
+
+#define MC_DEFAULT_GROUP	"239.255.66.66"
+#define MC_DEFAULT_PORT		6868
+#define MC_DEFAULT_TIMEOUT	30
+
+#define MC_MAX_BLKSIZE		65000
+#define MC_MAX_RANGES		128
+
+/* received blocks waiting to be written */
+#define MC_QUEUE_MAX		SZ_4M
+
+/* switches forget group members which do not report for a few minutes */
+#define MC_IGMP_REFRESH		(60 * SECOND)
+
+struct mc_hdr {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t type;
+	uint16_t reserved;
+	uint32_t session;
+} __attribute__ ((packed));
+
+struct mc_block {
+	struct list_head list;
+	uint32_t block;
+	int len;
+	void *data;
+	struct net_pktbuf *pb;	/* kept packet buffer @data lives in or NULL */
+};
+
+struct mc_recv {
+	struct eth_device *edev;
+	IPaddr_t group;
+	uint16_t port;
+
+	struct net_connection *con;	/* bound to the group port */
+	struct net_connection *nack_con;
+
+	uint64_t max_size;	/* size of the target device, 0 for files */
+	bool too_large;		/* announced size exceeds max_size */
+
+	/* from the first announce */
+	bool announced;
+	uint32_t session;
+	IPaddr_t sender_ip;
+	uint16_t sender_port;
+	uint64_t size;
+	unsigned int blksize;
+	unsigned int nblocks;
+
+	unsigned long *have;	/* blocks received, set when queued */
+	unsigned int nhave;
+	struct list_head queue;
+	unsigned int queued;
+	uint64_t written;
+
+	int pass_end;		/* pass which ended, 0 if none pending */
+	bool finished;
+	uint64_t last_rx;
+
+	unsigned int duplicates;
+	unsigned int dropped;
+	unsigned int passes;
+};
+
+static void mc_fill_hdr(struct mc_recv *mc, struct mc_hdr *hdr, int type)
+{
+	put_unaligned_be32(MC_MAGIC, &hdr->magic);
+	hdr->version = MC_VERSION;
+	hdr->type = type;
+	hdr->reserved = 0;
+	put_unaligned_be32(mc->session, &hdr->session);
+}
+
+static void mc_handle_announce(struct mc_recv *mc, const struct mc_hdr *hdr,
+			       const unsigned char *p, int len, char *pkt)
+{
+	uint64_t size;
+	unsigned int blksize;
+
+	if (mc->announced || len < 12)
+		return;
+
+	size = get_unaligned_be64(p);
+	blksize = get_unaligned_be16(p + 8);
+
+	if (!blksize || blksize > MC_MAX_BLKSIZE ||
+	    div_u64(size + blksize - 1, blksize) > UINT_MAX) {
+		pr_debug("bad announce, size %llu block size %u\n", size,
+			 blksize);
+		return;
+	}
+
+	if (mc->max_size && size > mc->max_size) {
+		mc->size = size;
+		mc->too_large = true;
+		return;
+	}
+
+	mc->session = get_unaligned_be32(&hdr->session);
+	mc->size = size;
+	mc->blksize = blksize;
+	mc->nblocks = div_u64(size + blksize - 1, blksize);
+	mc->sender_ip = net_read_ip(&net_eth_to_iphdr(pkt)->saddr);
+	mc->sender_port = ntohs(net_eth_to_udphdr(pkt)->uh_sport);
+	mc->announced = true;
+}
+
+static void mc_handle_data(struct mc_recv *mc, const unsigned char *p,
+			   int len)
+{
+	struct mc_block *b;
+	uint32_t block;
+	int expected;
+
+	/* not set up yet, the block will be repaired later */
+	if (!mc->have || len < 4)
+		return;
+
+	block = get_unaligned_be32(p);
+	p += 4;
+	len -= 4;
+
+	if (block >= mc->nblocks)
+		return;
+
+	expected = min_t(uint64_t, mc->blksize,
+			 mc->size - (uint64_t)block * mc->blksize);
+	if (len != expected)
+		return;
+
+	if (test_bit(block, mc->have)) {
+		mc->duplicates++;
+		return;
+	}
+
+	b = xzalloc(sizeof(*b));
+	b->block = block;
+	b->len = len;
+
+	/* keep the packet instead of copying when the pool allows */
+	b->pb = net_pktbuf_keep(p);
+	if (b->pb) {
+		b->data = (void *)p;
+	} else if (mc->queued + len <= MC_QUEUE_MAX) {
+		b->data = xmemdup(p, len);
+	} else {
+		/* writing does not keep up, the block will be repaired */
+		mc->dropped++;
+		free(b);
+		return;
+	}
+
+	list_add_tail(&b->list, &mc->queue);
+	mc->queued += len;
+	set_bit(block, mc->have);
+	mc->nhave++;
+}
+
+static void mc_handler(void *ctx, char *pkt, unsigned int len)
+{
+	struct mc_recv *mc = ctx;
+	const struct mc_hdr *hdr = (void *)net_eth_to_udp_payload(pkt);
+	const unsigned char *p = (void *)(hdr + 1);
+
+	len = net_eth_to_udplen(pkt);
+	if (len < sizeof(*hdr))
+		return;
+
+	len -= sizeof(*hdr);
+
+	if (get_unaligned_be32(&hdr->magic) != MC_MAGIC ||
+	    hdr->version != MC_VERSION)
+		return;
+
+	if (hdr->type == MC_ANNOUNCE)
+		mc_handle_announce(mc, hdr, p, len, pkt);
+
+	if (!mc->announced || get_unaligned_be32(&hdr->session) != mc->session)
+		return;
+
+	mc->last_rx = get_time_ns();
+
+	switch (hdr->type) {
+	case MC_DATA:
+		mc_handle_data(mc, p, len);
+		break;
+	case MC_PASS_END:
+		if (len >= 4)
+			mc->pass_end = get_unaligned_be32(p);
+		break;
+	case MC_FINISHED:
+		mc->finished = true;
+		break;
+	}
+}
+
+static int mc_write_queue(struct mc_recv *mc, int fd)
+{
+	struct mc_block *b, *tmp;
+	int ret = 0;
+
+	list_for_each_entry_safe(b, tmp, &mc->queue, list) {
+		if (!ret) {
+			ret = pwrite_full(fd, b->data, b->len,
+					  (loff_t)b->block * mc->blksize);
+			if (ret < 0)
+				pr_err("writing block %u failed: %pe\n",
+				       b->block, ERR_PTR(ret));
+			else
+				ret = 0;
+		}
+
+		list_del(&b->list);
+		mc->queued -= b->len;
+		mc->written += b->len;
+
+		if (b->pb)
+			net_pktbuf_put(b->pb);
+		else
+			free(b->data);
+		free(b);
+	}
+
+	return ret;
+}
+
+static int mc_send_nack(struct mc_recv *mc, int pass)
+{
+	unsigned char *packet = net_udp_get_payload(mc->nack_con);
+	struct mc_hdr *hdr = (void *)packet;
+	unsigned char *p = packet + sizeof(*hdr) + 8;
+	unsigned int first, end = 0;
+	int nranges = 0;
+
+	mc_fill_hdr(mc, hdr, MC_NACK);
+
+	while (nranges < MC_MAX_RANGES) {
+		first = find_next_zero_bit(mc->have, mc->nblocks, end);
+		if (first >= mc->nblocks)
+			break;
+
+		end = find_next_bit(mc->have, mc->nblocks, first);
+
+		put_unaligned_be32(first, p);
+		put_unaligned_be32(end - first, p + 4);
+		p += 8;
+		nranges++;
+	}
+
+	put_unaligned_be32(pass, packet + sizeof(*hdr));
+	put_unaligned_be16(nranges, packet + sizeof(*hdr) + 4);
+	put_unaligned_be16(0, packet + sizeof(*hdr) + 6);
+
+	return net_udp_send(mc->nack_con, p - packet);
+}
+
+static int mc_send_done(struct mc_recv *mc)
+{
+	struct mc_hdr *hdr = net_udp_get_payload(mc->nack_con);
+
+	mc_fill_hdr(mc, hdr, MC_DONE);
+
+	return net_udp_send(mc->nack_con, sizeof(*hdr));
+}
+
+static int mc_open(struct mc_recv *mc, const char *filename)
+{
+	struct stat s;
+	int fd, ret, mode = O_WRONLY | O_CREAT;
+
+	ret = stat(filename, &s);
+	if (ret && ret != -ENOENT)
+		return ret;
+
+	/* truncate regular files only, like cp does */
+	if (!ret && S_ISREG(s.st_mode))
+		mode |= O_TRUNC;
+
+	fd = open(filename, mode);
+	if (fd < 0)
+		return fd;
+
+	if (ret || S_ISREG(s.st_mode)) {
+		ret = ftruncate(fd, mc->size);
+		if (ret) {
+			close(fd);
+			return ret;
+		}
+	}
+
+	return fd;
+}
+
+static struct eth_device *mc_get_edev(const char *ifname)
+{
+	struct eth_device *edev;
+
+	if (ifname)
+		return eth_get_byname(ifname);
+
+	for_each_netdev(edev) {
+		if (edev->ifup && edev->ipaddr)
+			return edev;
+	}
+
+	return NULL;
+}
+
+static int mc_receive(struct mc_recv *mc, const char *filename,
+		      unsigned int timeout)
+{
+	struct mc_block *b, *tmp;
+	struct stat s;
+	uint64_t start, last_join;
+	int fd = -1, ret;
+
+	INIT_LIST_HEAD(&mc->queue);
+
+	/* devices don't grow, files are checked when writing */
+	if (!stat(filename, &s) && !S_ISREG(s.st_mode))
+		mc->max_size = s.st_size;
+
+	mc->con = net_udp_eth_new(mc->edev, IP_BROADCAST, 0, mc_handler, mc);
+	if (IS_ERR(mc->con))
+		return PTR_ERR(mc->con);
+
+	net_udp_bind(mc->con, mc->port);
+
+	if (mc->group != IP_BROADCAST) {
+		ret = net_join_group(mc->edev, mc->group);
+		if (ret)
+			goto out;
+	}
+
+	start = last_join = mc->last_rx = get_time_ns();
+
+	printf("waiting for sender on %pI4:%u\n", &mc->group, mc->port);
+
+	while (1) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
+
+		net_poll();
+
+		if (is_timeout(mc->last_rx, (uint64_t)timeout * SECOND)) {
+			ret = -ETIMEDOUT;
+			goto out;
+		}
+
+		if (mc->group != IP_BROADCAST &&
+		    is_timeout(last_join, MC_IGMP_REFRESH)) {
+			net_join_group(mc->edev, mc->group);
+			last_join = get_time_ns();
+		}
+
+		if (mc->too_large) {
+			pr_err("%llu bytes announced, but %s has only %llu\n",
+			       mc->size, filename, mc->max_size);
+			ret = -ENOSPC;
+			goto out;
+		}
+
+		if (!mc->announced)
+			continue;
+
+		if (fd < 0) {
+			printf("receiving %llu bytes from %pI4 in blocks of %u\n",
+			       mc->size, &mc->sender_ip, mc->blksize);
+
+			fd = mc_open(mc, filename);
+			if (fd < 0) {
+				ret = fd;
+				goto out;
+			}
+
+			/* the sender is a neighbour now, no ARP needed */
+			mc->nack_con = net_udp_eth_new(mc->edev, mc->sender_ip,
+						       mc->sender_port,
+						       mc_handler, mc);
+			if (IS_ERR(mc->nack_con)) {
+				ret = PTR_ERR(mc->nack_con);
+				mc->nack_con = NULL;
+				goto out;
+			}
+
+			mc->have = bitmap_zalloc(mc->nblocks);
+			if (!mc->have) {
+				ret = -ENOMEM;
+				goto out;
+			}
+
+			init_progression_bar(mc->size);
+		}
+
+		if (!list_empty(&mc->queue)) {
+			ret = mc_write_queue(mc, fd);
+			if (ret)
+				goto out;
+
+			show_progress(mc->written);
+		}
+
+		if (mc->nhave == mc->nblocks) {
+			/* two of them, in case the first one gets lost */
+			mc_send_done(mc);
+			mc_send_done(mc);
+			ret = 0;
+			goto out;
+		}
+
+		if (mc->pass_end) {
+			mc->passes = mc->pass_end;
+			ret = mc_send_nack(mc, mc->pass_end);
+			mc->pass_end = 0;
+			if (ret)
+				goto out;
+		}
+
+		if (mc->finished) {
+			pr_err("sender finished with %u blocks missing\n",
+			       mc->nblocks - mc->nhave);
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+out:
+	if (mc->announced && fd >= 0) {
+		putchar('\n');
+		printf("%u blocks, %u duplicates, %u dropped, %u repair passes in %llums\n",
+		       mc->nblocks, mc->duplicates, mc->dropped, mc->passes,
+		       (get_time_ns() - start) / MSECOND);
+	}
+
+	list_for_each_entry_safe(b, tmp, &mc->queue, list) {
+		if (b->pb)
+			net_pktbuf_put(b->pb);
+		else
+			free(b->data);
+		free(b);
+	}
+
+	if (fd >= 0)
+		close(fd);
+
+	if (mc->group != IP_BROADCAST)
+		net_leave_group(mc->edev, mc->group);
+
+	if (mc->nack_con)
+		net_unregister(mc->nack_con);
+	net_unregister(mc->con);
+	free(mc->have);
+
+	return ret;
+}
+
+static int do_mcrecv(int argc, char *argv[])
+{
+	struct mc_recv *mc;
+	const char *ifname = NULL, *group = MC_DEFAULT_GROUP;
+	unsigned int port = MC_DEFAULT_PORT, timeout = MC_DEFAULT_TIMEOUT;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "g:p:i:t:")) > 0) {
+		switch (opt) {
+		case 'g':
+			group = optarg;
+			break;
+		case 'p':
+			port = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			ifname = optarg;
+			break;
+		case 't':
+			timeout = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind + 1 != argc || !port || port > 0xffff)
+		return COMMAND_ERROR_USAGE;
+
+	mc = xzalloc(sizeof(*mc));
+	mc->port = port;
+
+	ret = string_to_ip(group, &mc->group);
+	if (ret || (mc->group != IP_BROADCAST && !net_ip_is_multicast(mc->group))) {
+		printf("invalid multicast group %s\n", group);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	mc->edev = mc_get_edev(ifname);
+	if (!mc->edev) {
+		printf("no network interface is up\n");
+		ret = -ENETDOWN;
+		goto out;
+	}
+
+	ret = mc_receive(mc, argv[optind], timeout);
+	if (ret)
+		printf("mcrecv failed: %pe\n", ERR_PTR(ret));
+out:
+	free(mc);
+
+	return ret ? COMMAND_ERROR : COMMAND_SUCCESS;
+}
+
+BAREBOX_CMD_HELP_START(mcrecv)
+BAREBOX_CMD_HELP_TEXT("Receive a file sent to many boards at once via multicast and")
+BAREBOX_CMD_HELP_TEXT("write it to FILE, which may be a device. Missing blocks are")
+BAREBOX_CMD_HELP_TEXT("requested from the sender until the file is complete. Use")
+BAREBOX_CMD_HELP_TEXT("scripts/mcsend on the host to send the file.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-g GROUP", "multicast group or 255.255.255.255 (default " MC_DEFAULT_GROUP ")")
+BAREBOX_CMD_HELP_OPT ("-p PORT", "UDP port (default " __stringify(MC_DEFAULT_PORT) ")")
+BAREBOX_CMD_HELP_OPT ("-i INTF", "network interface (default: first one which is up)")
+BAREBOX_CMD_HELP_OPT ("-t SECS", "give up when nothing is received for SECS (default "
+		      __stringify(MC_DEFAULT_TIMEOUT) ")")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(mcrecv)
+	.cmd		= do_mcrecv,
+	BAREBOX_CMD_DESC("receive a file via multicast")
+	BAREBOX_CMD_OPTS("[-gpit] FILE")
+	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_mcrecv_help)
+BAREBOX_CMD_END
@@ -33,17 +33,50 @@ static unsigned int net_ip_id;
 
 char *net_server;
 IPaddr_t net_gateway;
-static IPaddr_t net_nameserver;
+static IPaddr_t net_nameservers[NET_MAX_NAMESERVERS];
 static char *net_domainname;
 
+/* answers from the previous nameservers may not be valid anymore */
+static int net_nameserver_set(struct param_d *p, void *priv)
+{
+	dns_cache_flush();
+
+	return 0;
+}
+
 void net_set_nameserver(IPaddr_t nameserver)
 {
-	net_nameserver = nameserver;
+	net_nameservers[0] = nameserver;
+	dns_cache_flush();
 }
 
 IPaddr_t net_get_nameserver(void)
 {
-	return net_nameserver;
+	return net_nameservers[0];
+}
+
+/* replaces all nameservers, unused slots are cleared */
+void net_set_nameservers(const IPaddr_t *nameservers, int num)
+{
+	int i;
+
+	for (i = 0; i < NET_MAX_NAMESERVERS; i++)
+		net_nameservers[i] = i < num ? nameservers[i] : 0;
+
+	dns_cache_flush();
+}
+
+/* returns the number of configured nameservers stored to @nameservers */
+int net_get_nameservers(IPaddr_t *nameservers)
+{
+	int i, num = 0;
+
+	for (i = 0; i < NET_MAX_NAMESERVERS; i++) {
+		if (net_nameservers[i])
+			nameservers[num++] = net_nameservers[i];
+	}
+
+	return num;
 }
 
 void net_set_domainname(const char *name)
@@ -69,14 +102,18 @@ uint16_t net_checksum(unsigned char *ptr, int len)
 {
 	uint32_t xsum = 0;
 	uint16_t *p = (uint16_t *)ptr;
+	int n = len >> 1;
 
-	if (len & 1)
-		ptr[len] = 0;
+	while (n-- > 0)
+		xsum += *p++;
 
-	len = (len + 1) >> 1;
+	/* pad an odd trailing byte with a zero without writing past @len */
+	if (len & 1) {
+		uint16_t last = 0;
 
-	while (len-- > 0)
-		xsum += *p++;
+		*(uint8_t *)&last = ptr[len - 1];
+		xsum += last;
+	}
 
 	xsum = (xsum & 0xffff) + (xsum >> 16);
 	xsum = (xsum & 0xffff) + (xsum >> 16);
@@ -110,19 +147,122 @@ int setenv_ip(const char *name, IPaddr_t ip)
 	return 0;
 }
 
+/*
+ * Neighbour cache: the ethernet addresses of the hosts on the local
+ * networks, kept per device. Entries are learned from ARP and from incoming
+ * IP traffic and expire after ARP_CACHE_TIMEOUT, so that not every new
+ * connection costs an ARP round trip.
+ */
+#define ARP_CACHE_SIZE		16
+#define ARP_CACHE_TIMEOUT	(60 * SECOND)
+
+struct net_neigh {
+	struct list_head list;
+	IPaddr_t ip;
+	unsigned char ethaddr[6];
+	uint64_t updated;
+};
+
+static struct net_neigh *net_neigh_find(struct eth_device *edev, IPaddr_t ip)
+{
+	struct net_neigh *n;
+
+	list_for_each_entry(n, &edev->neighbours, list)
+		if (n->ip == ip)
+			return n;
+
+	return NULL;
+}
+
+static bool net_neigh_lookup(struct eth_device *edev, IPaddr_t ip,
+			     unsigned char *ether)
+{
+	struct net_neigh *n;
+
+	n = net_neigh_find(edev, ip);
+	if (!n)
+		return false;
+
+	if (is_timeout(n->updated, ARP_CACHE_TIMEOUT)) {
+		list_del(&n->list);
+		free(n);
+		return false;
+	}
+
+	memcpy(ether, n->ethaddr, 6);
+
+	return true;
+}
+
+/*
+ * Add or refresh the entry for @ip. When @create is false only an existing
+ * entry is updated, which is what we do for unsolicited information like
+ * gratuitous ARP.
+ */
+static void net_neigh_update(struct eth_device *edev, IPaddr_t ip,
+			     const unsigned char *ether, bool create)
+{
+	struct net_neigh *n, *oldest = NULL;
+	int count = 0;
+
+	if (!ip || ip == IP_BROADCAST || !is_valid_ether_addr(ether))
+		return;
+
+	n = net_neigh_find(edev, ip);
+	if (!n) {
+		if (!create)
+			return;
+
+		list_for_each_entry(n, &edev->neighbours, list) {
+			if (!oldest || n->updated < oldest->updated)
+				oldest = n;
+			count++;
+		}
+
+		if (count < ARP_CACHE_SIZE) {
+			n = xzalloc(sizeof(*n));
+			list_add(&n->list, &edev->neighbours);
+		} else {
+			n = oldest;
+		}
+
+		n->ip = ip;
+	}
+
+	if (memcmp(n->ethaddr, ether, 6))
+		pr_debug("neighbour %pI4 is at %02x:%02x:%02x:%02x:%02x:%02x\n",
+			 &ip, ether[0], ether[1], ether[2], ether[3], ether[4],
+			 ether[5]);
+
+	memcpy(n->ethaddr, ether, 6);
+	n->updated = get_time_ns();
+}
+
+void net_neigh_flush(struct eth_device *edev)
+{
+	struct net_neigh *n, *tmp;
+
+	list_for_each_entry_safe(n, tmp, &edev->neighbours, list) {
+		list_del(&n->list);
+		free(n);
+	}
+}
+
 static unsigned char *arp_ether;
 static IPaddr_t arp_wait_ip;
 
-static void arp_handler(struct arprequest *arp)
+static void arp_handler(struct eth_device *edev, struct arprequest *arp)
 {
 	IPaddr_t tmp;
 
+	tmp = net_read_ip(&arp->ar_data[6]);
+
+	net_neigh_update(edev, tmp, &arp->ar_data[0], true);
+
 	/* are we waiting for a reply */
 	if (!arp_wait_ip)
 		return;
 
-	tmp = net_read_ip(&arp->ar_data[6]);
-
 	/* matched waiting packet's address */
 	if (tmp == arp_wait_ip) {
 		/* save address for later use */
@@ -195,17 +335,7 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 	memcpy(arp->ar_data, edev->ethaddr, 6);	/* source ET addr	*/
 	net_write_ip(arp->ar_data + 6, edev->ipaddr);	/* source IP addr	*/
 	memset(arp->ar_data + 10, 0, 6);	/* dest ET addr = 0     */
-
-	if ((dest & edev->netmask) != (edev->ipaddr & edev->netmask)) {
-		if (!net_gateway)
-			arp_wait_ip = dest;
-		else
-			arp_wait_ip = net_gateway;
-	} else {
-		arp_wait_ip = dest;
-	}
-
-	net_write_ip(arp->ar_data + 16, arp_wait_ip);
+	net_write_ip(arp->ar_data + 16, dest);	/* dest IP addr		*/
 
 	arp_ether = ether;
 
@@ -239,16 +369,26 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 	return 0;
 }
 
+/* upper limit for the rounds of receiving in a single net_poll() */
+#define NET_POLL_MAX_ROUNDS	8
+
+/* a driver had frames left after its receive budget was used up */
+static bool net_rx_pending;
+
 void net_poll(void)
 {
 	static bool in_net_poll;
+	int rounds = 0;
 
 	if (in_net_poll)
 		return;
 
 	in_net_poll = true;
 
-	eth_rx();
+	/* keep receiving while a burst is coming in */
+	do {
+		net_rx_pending = eth_rx();
+	} while (net_rx_pending && ++rounds < NET_POLL_MAX_ROUNDS);
 
 	in_net_poll = false;
 }
@@ -258,16 +398,16 @@ static void __net_poll(struct poller_struct *poller)
 	static uint64_t last;
 
 	/*
-	 * USB network controllers take a long time in the receive path,
-	 * so limit the polling rate to once per 10ms. This is due to
-	 * deficiencies in the barebox USB stack: We can't queue URBs and
-	 * receive a callback when they are done. Instead, we always
-	 * synchronously queue an URB and wait for its completion. In case
-	 * of USB network adapters the only way to detect if packets have
-	 * been received is to queue a RX URB and see if it completes (in
-	 * which case we have received data) or if it timeouts (no data
-	 * available). The timeout can't be arbitrarily small, 2ms is the
-	 * smallest we can do with the 1ms USB frame size.
+	 * USB network controllers may take a long time in the receive
+	 * path, so limit the polling rate to once per 10ms. EHCI and xHCI
+	 * can queue URBs, so the USB network adapters keep several RX URBs
+	 * queued there and a poll only collects the completed ones. The
+	 * other host controllers can only transfer synchronously, so the
+	 * only way to detect if packets have been received is to queue a
+	 * RX URB and see if it completes (in which case we have received
+	 * data) or if it timeouts (no data available). The timeout can't
+	 * be arbitrarily small, 2ms is the smallest we can do with the 1ms
+	 * USB frame size.
 	 *
 	 * Given that we do a mixture of polling-as-fast-as-possible when
 	 * we are waiting for network traffic (tftp, nfs and other users
@@ -275,8 +415,11 @@ static void __net_poll(struct poller_struct *poller)
 	 * here to still get packets when no user is actively waiting for
 	 * incoming packets. This is used to receive incoming ping packets
 	 * and to get fastboot over ethernet going.
+	 *
+	 * Drivers which report pending frames after their receive budget
+	 * was used up are polled again without waiting.
 	 */
-	if (!is_timeout(last, 10 * MSECOND))
+	if (!net_rx_pending && !is_timeout(last, 10 * MSECOND))
 		return;
 
 	net_poll();
@@ -294,7 +437,7 @@ static int init_net_poll(void)
 }
 device_initcall(init_net_poll);
 
-static uint16_t net_udp_new_localport(void)
+static uint16_t net_new_localport(void)
 {
 	static uint16_t localport;
 
@@ -340,6 +483,9 @@ void net_set_serverip_empty(IPaddr_t ip)
 
 void net_set_ip(struct eth_device *edev, IPaddr_t ip)
 {
+	if (edev->ipaddr != ip)
+		net_neigh_flush(edev);
+
 	edev->ipaddr = ip;
 }
 
@@ -365,10 +511,21 @@ IPaddr_t net_get_gateway(void)
 
 static LIST_HEAD(connection_list);
 
+/* The address we have to send to for reaching @dest */
+static IPaddr_t net_nexthop(struct eth_device *edev, IPaddr_t dest)
+{
+	if ((dest & edev->netmask) != (edev->ipaddr & edev->netmask) &&
+	    net_gateway)
+		return net_gateway;
+
+	return dest;
+}
+
 static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 				      rx_handler_f *handler, void *ctx)
 {
 	struct net_connection *con;
+	IPaddr_t nexthop;
 	int ret;
 
 	if (!edev) {
@@ -400,15 +557,20 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->et = (struct ethernet *)con->packet;
 	con->ip = (struct iphdr *)(con->packet + ETHER_HDR_SIZE);
 	con->udp = (struct udphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->icmp = (struct icmphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->handler = handler;
 
 	if (dest == IP_BROADCAST) {
 		memset(con->et->et_dest, 0xff, 6);
 	} else {
-		ret = arp_request(edev, dest, con->et->et_dest);
-		if (ret)
-			goto out;
+		nexthop = net_nexthop(edev, dest);
+
+		if (!net_neigh_lookup(edev, nexthop, con->et->et_dest)) {
+			ret = arp_request(edev, nexthop, con->et->et_dest);
+			if (ret)
+				goto out;
+		}
 	}
 
 	con->et->et_protlen = htons(PROT_IP);
@@ -425,7 +587,7 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 
 	return con;
 out:
-	free(con->packet);
+	net_free_packet(con->packet);
 	free(con);
 	return ERR_PTR(ret);
 }
@@ -441,7 +603,7 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 
 	con->proto = IPPROTO_UDP;
 	con->udp->uh_dport = htons(dport);
-	con->udp->uh_sport = htons(net_udp_new_localport());
+	con->udp->uh_sport = htons(net_new_localport());
 	con->ip->protocol = IPPROTO_UDP;
 
 	return con;
@@ -467,10 +629,26 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	return con;
 }
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	struct net_connection *con = net_new(NULL, dest, handler, ctx);
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->tcp->dest = htons(dport);
+	con->tcp->source = htons(net_new_localport());
+	con->ip->protocol = IPPROTO_TCP;
+
+	return con;
+}
+
 void net_unregister(struct net_connection *con)
 {
 	list_del(&con->list);
-	free(con->packet);
+	net_free_packet(con->packet);
 	free(con);
 }
 
@@ -492,6 +670,32 @@ int net_udp_send(struct net_connection *con, int len)
 	return net_ip_send(con, sizeof(struct udphdr) + len);
 }
 
+/* sum of the TCP segment including the pseudo header */
+static uint16_t net_tcp_checksum(struct iphdr *ip, void *tcp, int len)
+{
+	uint16_t *saddr = (uint16_t *)&ip->saddr;
+	uint16_t *daddr = (uint16_t *)&ip->daddr;
+	uint32_t xsum;
+
+	xsum = net_checksum(tcp, len);
+	xsum += saddr[0] + saddr[1] + daddr[0] + daddr[1];
+	xsum += htons(IPPROTO_TCP) + htons(len);
+
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return xsum;
+}
+
+/* @len is the length of the TCP header including options plus data */
+int net_tcp_send(struct net_connection *con, int len)
+{
+	con->tcp->check = 0;
+	con->tcp->check = ~net_tcp_checksum(con->ip, con->tcp, len);
+
+	return net_ip_send(con, len);
+}
+
 int net_icmp_send(struct net_connection *con, int len)
 {
 	con->icmp->checksum = ~net_checksum((unsigned char *)con->icmp,
@@ -500,6 +704,156 @@ int net_icmp_send(struct net_connection *con, int len)
 	return net_ip_send(con, sizeof(struct icmphdr) + len);
 }
 
+/*
+ * Multicast groups we are a member of. UDP packets sent to them are
+ * accepted like those sent to our own address.
+ */
+#define NET_MAX_GROUPS		4
+
+struct net_group {
+	struct eth_device *edev;
+	IPaddr_t group;
+	bool promisc;
+};
+
+static struct net_group net_groups[NET_MAX_GROUPS];
+
+struct igmphdr {
+	uint8_t		type;
+	uint8_t		code;
+	uint16_t	csum;
+	uint32_t	group;
+} __attribute__ ((packed));
+
+#define IGMPV2_MEMBERSHIP_REPORT	0x16
+#define IGMP_LEAVE_GROUP		0x17
+
+#define IP_ALL_ROUTERS		htonl(0xe0000002)	/* 224.0.0.2 */
+
+static struct net_group *net_find_group(struct eth_device *edev, IPaddr_t group)
+{
+	int i;
+
+	for (i = 0; i < NET_MAX_GROUPS; i++) {
+		if (net_groups[i].edev == edev && net_groups[i].group == group)
+			return &net_groups[i];
+	}
+
+	return NULL;
+}
+
+static void net_multicast_ether(IPaddr_t ip, unsigned char *ether)
+{
+	uint32_t addr = ntohl(ip);
+
+	ether[0] = 0x01;
+	ether[1] = 0x00;
+	ether[2] = 0x5e;
+	ether[3] = (addr >> 16) & 0x7f;
+	ether[4] = addr >> 8;
+	ether[5] = addr;
+}
+
+/* send an IGMPv2 message, with the router alert option as RFC 2236 asks */
+static int net_igmp_send(struct eth_device *edev, int type, IPaddr_t group,
+			 IPaddr_t dest)
+{
+	unsigned char *packet;
+	struct ethernet *et;
+	struct iphdr *ip;
+	struct igmphdr *igmp;
+	uint32_t *opt;
+	int iplen = sizeof(*ip) + 4;
+	int len = iplen + sizeof(*igmp);
+	int ret;
+
+	packet = net_alloc_packet();
+	if (!packet)
+		return -ENOMEM;
+
+	memset(packet, 0, ETHER_HDR_SIZE + len);
+
+	et = (struct ethernet *)packet;
+	ip = (struct iphdr *)(packet + ETHER_HDR_SIZE);
+	opt = (uint32_t *)(ip + 1);
+	igmp = (struct igmphdr *)(opt + 1);
+
+	net_multicast_ether(dest, et->et_dest);
+	memcpy(et->et_src, edev->ethaddr, 6);
+	et->et_protlen = htons(PROT_IP);
+
+	ip->hl_v = 0x46;
+	ip->tos = 0xc0;
+	ip->tot_len = htons(len);
+	ip->id = htons(net_ip_id++);
+	ip->frag_off = htons(0x4000);	/* No fragmentation */
+	ip->ttl = 1;
+	ip->protocol = IPPROTO_IGMP;
+	net_copy_ip(&ip->saddr, &edev->ipaddr);
+	net_copy_ip(&ip->daddr, &dest);
+	*opt = htonl(0x94040000);	/* router alert */
+	ip->check = ~net_checksum((unsigned char *)ip, iplen);
+
+	igmp->type = type;
+	net_copy_ip(&igmp->group, &group);
+	igmp->csum = ~net_checksum((unsigned char *)igmp, sizeof(*igmp));
+
+	ret = eth_send(edev, packet, ETHER_HDR_SIZE + len);
+	net_free_packet(packet);
+
+	return ret;
+}
+
+/**
+ * net_join_group - receive packets sent to a multicast group
+ * @edev: the device to receive the packets on
+ * @group: the multicast group address
+ *
+ * The device is put into promiscuous mode if it supports it, as drivers
+ * do not program multicast filters. A membership report is sent so that
+ * switches doing IGMP snooping forward the group to us. Queries are not
+ * answered, so callers staying in a group for longer than a few minutes
+ * should call this function again now and then to refresh the membership.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int net_join_group(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_group *g;
+
+	if (!net_ip_is_multicast(group))
+		return -EINVAL;
+
+	g = net_find_group(edev, group);
+	if (!g) {
+		g = net_find_group(NULL, 0);
+		if (!g)
+			return -ENOSPC;
+
+		g->edev = edev;
+		g->group = group;
+		g->promisc = !eth_set_promisc(edev, true);
+	}
+
+	return net_igmp_send(edev, IGMPV2_MEMBERSHIP_REPORT, group, group);
+}
+
+void net_leave_group(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_group *g = net_find_group(edev, group);
+
+	if (!g)
+		return;
+
+	net_igmp_send(edev, IGMP_LEAVE_GROUP, group, IP_ALL_ROUTERS);
+
+	if (g->promisc)
+		eth_set_promisc(edev, false);
+
+	g->edev = NULL;
+	g->group = 0;
+}
+
 static int net_answer_arp(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct arprequest *arp = (struct arprequest *)(pkt + ETHER_HDR_SIZE);
@@ -524,7 +878,7 @@ static int net_answer_arp(struct eth_device *edev, unsigned char *pkt, int len)
 		return 0;
 	memcpy(packet, pkt, ETHER_HDR_SIZE + ARP_HDR_SIZE);
 	ret = eth_send(edev, packet, ETHER_HDR_SIZE + ARP_HDR_SIZE);
-	free(packet);
+	net_free_packet(packet);
 
 	return ret;
 }
@@ -543,6 +897,7 @@ static void net_bad_packet(unsigned char *pkt, int len)
 static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct arprequest *arp;
+	IPaddr_t sip, tip;
 
 	pr_debug("%s: got arp\n", __func__);
 
@@ -568,14 +923,37 @@ static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 		goto bad;
 	if (edev->ipaddr == 0)
 		return 0;
-	if (net_read_ip(&arp->ar_data[16]) != edev->ipaddr)
+
+	sip = net_read_ip(&arp->ar_data[6]);
+	tip = net_read_ip(&arp->ar_data[16]);
+
+	/*
+	 * Gratuitous ARP: a host announcing its (possibly changed) address.
+	 * Only refresh what we already know, but warn when somebody else
+	 * claims our address.
+	 */
+	if (sip == tip) {
+		if (sip == edev->ipaddr) {
+			if (memcmp(&arp->ar_data[0], edev->ethaddr, 6))
+				dev_warn(&edev->dev, "%pI4 is used by another host\n",
+					 &sip);
+			return 0;
+		}
+
+		net_neigh_update(edev, sip, &arp->ar_data[0], false);
+		return 0;
+	}
+
+	if (tip != edev->ipaddr)
 		return 0;
 
 	switch (ntohs(arp->ar_op)) {
 	case ARPOP_REQUEST:
+		/* the requester will most likely talk to us next */
+		net_neigh_update(edev, sip, &arp->ar_data[0], true);
 		return net_answer_arp(edev, pkt, len);
 	case ARPOP_REPLY:
-		arp_handler(arp);
+		arp_handler(edev, arp);
 		return 1;
 	default:
 		pr_debug("Unexpected ARP opcode 0x%x\n", ntohs(arp->ar_op));
@@ -605,6 +983,32 @@ static int net_handle_udp(unsigned char *pkt, int len)
 	return -EINVAL;
 }
 
+static int net_handle_tcp(unsigned char *pkt, int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	struct net_connection *con;
+	int tcp_len = ntohs(ip->tot_len) - sizeof(struct iphdr);
+
+	if (tcp_len < (int)sizeof(struct tcphdr))
+		return -EINVAL;
+
+	if (net_tcp_checksum(ip, tcp, tcp_len) != 0xffff)
+		return -EINVAL;
+
+	list_for_each_entry(con, &connection_list, list) {
+		if (con->proto == IPPROTO_TCP &&
+		    tcp->dest == con->tcp->source &&
+		    tcp->source == con->tcp->dest &&
+		    ip->saddr == con->ip->daddr) {
+			con->handler(con->priv, pkt, len);
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
 static int ping_reply(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct ethernet *et = (struct ethernet *)pkt;
@@ -633,11 +1037,11 @@ static int ping_reply(struct eth_device *edev, unsigned char *pkt, int len)
 	if (!packet)
 		return 0;
 
-	memcpy(packet, pkt, ETHER_HDR_SIZE + len);
+	memcpy(packet, pkt, len);
 
-	ret = eth_send(edev, packet, ETHER_HDR_SIZE + len);
+	ret = eth_send(edev, packet, len);
 
-	free(packet);
+	net_free_packet(packet);
 
 	return ret;
 }
@@ -650,7 +1054,7 @@ static int net_handle_icmp(struct eth_device *edev, unsigned char *pkt, int len)
 	pr_debug("%s\n", __func__);
 
 	icmp = net_eth_to_icmphdr(pkt);
-	if (icmp->type == ICMP_ECHO_REQUEST)
+	if (icmp->type == ICMP_ECHO_REQUEST && len <= PKTSIZE)
 		ping_reply(edev, pkt, len);
 
 	list_for_each_entry(con, &connection_list, list) {
@@ -664,6 +1068,7 @@ static int net_handle_icmp(struct eth_device *edev, unsigned char *pkt, int len)
 
 static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 {
+	struct ethernet *et = (struct ethernet *)pkt;
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	IPaddr_t tmp;
 
@@ -678,20 +1083,39 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
 
-	if (ip->frag_off & htons(0x1fff)) /* Can't deal w/ fragments */
-		goto bad;
 	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
 		goto bad;
 
 	tmp = net_read_ip(&ip->daddr);
-	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
+	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST &&
+	    !(net_ip_is_multicast(tmp) && net_find_group(edev, tmp)))
 		return 0;
 
+	if (ip->frag_off & htons(IP_MF | IP_OFFSET)) {
+		pkt = net_ip_defrag(pkt, &len);
+		if (!pkt)
+			return 0;
+
+		et = (struct ethernet *)pkt;
+		ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	}
+
+	/*
+	 * Packets from hosts on our network carry their ethernet address,
+	 * remember it. For other hosts it's the gateway's address.
+	 */
+	tmp = net_read_ip(&ip->saddr);
+	if (edev->ipaddr &&
+	    (tmp & edev->netmask) == (edev->ipaddr & edev->netmask))
+		net_neigh_update(edev, tmp, et->et_src, true);
+
 	switch (ip->protocol) {
 	case IPPROTO_ICMP:
 		return net_handle_icmp(edev, pkt, len);
 	case IPPROTO_UDP:
 		return net_handle_udp(pkt, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(pkt, len);
 	}
 
 	return 0;
@@ -750,7 +1174,12 @@ static int net_init(void)
 	for (i = 0; i < PKTBUFSRX; i++)
 		NetRxPackets[i] = net_alloc_packet();
 
-	globalvar_add_simple_ip("net.nameserver", &net_nameserver);
+	globalvar_add_ip("net.nameserver", net_nameserver_set,
+			 &net_nameservers[0], NULL);
+	globalvar_add_ip("net.nameserver2", net_nameserver_set,
+			 &net_nameservers[1], NULL);
+	globalvar_add_ip("net.nameserver3", net_nameserver_set,
+			 &net_nameservers[2], NULL);
 	globalvar_add_simple_string("net.domainname", &net_domainname);
 	globalvar_add_simple_string("net.server", &net_server);
 	globalvar_add_simple_ip("net.gateway", &net_gateway);
@@ -761,5 +1190,7 @@ static int net_init(void)
 postcore_initcall(net_init);
 
 BAREBOX_MAGICVAR(global.net.nameserver, "The DNS server used for resolving host names");
+BAREBOX_MAGICVAR(global.net.nameserver2, "Additional DNS server, queried in parallel");
+BAREBOX_MAGICVAR(global.net.nameserver3, "Additional DNS server, queried in parallel");
 BAREBOX_MAGICVAR(global.net.domainname, "Domain name used for DNS requests");
 BAREBOX_MAGICVAR(global.net.server, "Standard server used for NFS/TFTP");
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * pktbuf.c - pool of packet buffers
+ *
+ * All buffers are allocated in one DMA capable chunk when the pool is
+ * first used, so taking a buffer from the pool and giving it back is
+ * cheap enough to do for every packet.
+ *
+ * The buffers are reference counted. A driver passes a received frame up
+ * with net_receive_pktbuf(); a protocol which wants to keep the frame
+ * beyond its rx handler takes a reference with net_pktbuf_keep() instead
+ * of copying it, and the driver continues with a fresh buffer.
+ *
+ * Only frames passed up this way can be kept. Other pool buffers, like
+ * the NetRxPackets[] many drivers use as their receive ring, are reused
+ * by their owner behind the keeper's back.
+ */
+
+#define pr_fmt(fmt) "pktbuf: " fmt
+
+#include <common.h>
+#include <dma.h>
+#include <net.h>
+#include <linux/list.h>
+
+/* each buffer starts on a cache line */
+#define PKTBUF_SIZE		ALIGN(PKTSIZE, 64)
+#define PKTBUF_COUNT		CONFIG_NET_PKTBUF_POOL_SIZE
+
+/*
+ * Buffers which are not handed out to keepers, so that the driver of a
+ * kept frame always finds a replacement.
+ */
+#define PKTBUF_RESERVE		4
+
+static struct net_pktbuf *pktbufs;
+static unsigned char *pktbuf_data;
+static LIST_HEAD(pktbuf_free);
+static unsigned int pktbuf_nfree;
+
+static int net_pktbuf_pool_init(void)
+{
+	int i;
+
+	if (pktbufs)
+		return 0;
+
+	pktbuf_data = dma_alloc(PKTBUF_COUNT * PKTBUF_SIZE);
+	if (!pktbuf_data)
+		return -ENOMEM;
+
+	pktbufs = xzalloc(PKTBUF_COUNT * sizeof(*pktbufs));
+
+	for (i = 0; i < PKTBUF_COUNT; i++) {
+		pktbufs[i].data = pktbuf_data + i * PKTBUF_SIZE;
+		list_add_tail(&pktbufs[i].list, &pktbuf_free);
+	}
+
+	pktbuf_nfree = PKTBUF_COUNT;
+
+	return 0;
+}
+
+static struct net_pktbuf *__net_pktbuf_alloc(struct eth_device *edev,
+					     unsigned int reserve)
+{
+	struct net_pktbuf *pb;
+
+	if (net_pktbuf_pool_init() || pktbuf_nfree <= reserve) {
+		if (edev)
+			edev->pool_exhausted++;
+		return NULL;
+	}
+
+	/* most recently freed first, its cache lines may still be warm */
+	pb = list_first_entry(&pktbuf_free, struct net_pktbuf, list);
+	list_del_init(&pb->list);
+	pktbuf_nfree--;
+
+	pb->refcount = 1;
+	pb->len = 0;
+	pb->edev = edev;
+	pb->keepable = false;
+
+	return pb;
+}
+
+/**
+ * net_pktbuf_alloc - take a receive buffer from the pool
+ * @edev: the device the buffer is used for, may be NULL
+ *
+ * Return: a buffer with a reference count of one, or NULL when the pool is
+ * exhausted. This is counted in the pool_exhausted parameter of @edev.
+ */
+struct net_pktbuf *net_pktbuf_alloc(struct eth_device *edev)
+{
+	return __net_pktbuf_alloc(edev, 0);
+}
+
+/**
+ * net_pktbuf_alloc_tx - take a buffer for an outgoing packet from the pool
+ * @edev: the device the buffer is used for, may be NULL
+ *
+ * Like net_pktbuf_alloc(), but the reserve for replacing kept receive
+ * buffers is left alone.
+ */
+struct net_pktbuf *net_pktbuf_alloc_tx(struct eth_device *edev)
+{
+	return __net_pktbuf_alloc(edev, PKTBUF_RESERVE);
+}
+
+struct net_pktbuf *net_pktbuf_get(struct net_pktbuf *pb)
+{
+	pb->refcount++;
+
+	return pb;
+}
+
+void net_pktbuf_put(struct net_pktbuf *pb)
+{
+	if (WARN_ON(!pb->refcount))
+		return;
+
+	if (--pb->refcount)
+		return;
+
+	list_add(&pb->list, &pktbuf_free);
+	pktbuf_nfree++;
+}
+
+/**
+ * net_pktbuf_from_data - find the buffer a packet lives in
+ * @data: pointer to the start of the packet
+ *
+ * Return: the buffer or NULL if @data has not been allocated from the pool
+ */
+struct net_pktbuf *net_pktbuf_from_data(const void *data)
+{
+	const unsigned char *p = data;
+
+	if (!pktbufs || p < pktbuf_data ||
+	    p >= pktbuf_data + PKTBUF_COUNT * PKTBUF_SIZE)
+		return NULL;
+
+	return &pktbufs[(p - pktbuf_data) / PKTBUF_SIZE];
+}
+
+/**
+ * net_pktbuf_keep - keep a received packet beyond the rx handler
+ * @pkt: the packet as passed to the rx handler
+ *
+ * Return: a reference to the buffer holding @pkt, or NULL if the packet
+ * must be copied instead because it has not been passed up with
+ * net_receive_pktbuf() or the pool is running low.
+ */
+struct net_pktbuf *net_pktbuf_keep(const void *pkt)
+{
+	struct net_pktbuf *pb = net_pktbuf_from_data(pkt);
+
+	if (!pb || !pb->refcount || !pb->keepable ||
+	    pktbuf_nfree <= PKTBUF_RESERVE)
+		return NULL;
+
+	return net_pktbuf_get(pb);
+}
+
+/**
+ * net_receive_pktbuf - pass a received packet in a pool buffer to the stack
+ * @edev: the device the packet was received on
+ * @pb: the buffer, @pb->len bytes of it are valid
+ *
+ * Return: the buffer the driver should receive the next packet into. This
+ * is @pb unless the stack kept the packet, in which case the driver's
+ * reference to @pb is dropped and a new buffer is returned.
+ */
+struct net_pktbuf *net_receive_pktbuf(struct eth_device *edev,
+				      struct net_pktbuf *pb)
+{
+	struct net_pktbuf *new;
+
+	/*
+	 * The replacement is taken up front, a kept buffer must never be
+	 * handed back to the driver. Without one the packet can't be kept.
+	 */
+	new = net_pktbuf_alloc(edev);
+
+	pb->keepable = !!new;
+	net_receive(edev, pb->data, pb->len);
+	pb->keepable = false;
+
+	if (pb->refcount == 1) {
+		if (new)
+			net_pktbuf_put(new);
+		return pb;
+	}
+
+	net_pktbuf_put(pb);
+
+	return new;
+}
+
+/**
+ * net_alloc_packet - allocate a buffer for a packet
+ *
+ * Buffers are taken from the pool and allocated separately only when it
+ * is exhausted. Free them with net_free_packet().
+ */
+void *net_alloc_packet(void)
+{
+	struct net_pktbuf *pb = net_pktbuf_alloc_tx(NULL);
+
+	if (pb)
+		return pb->data;
+
+	return dma_alloc(PKTSIZE);
+}
+
+void net_free_packet(void *packet)
+{
+	struct net_pktbuf *pb;
+
+	if (!packet)
+		return;
+
+	pb = net_pktbuf_from_data(packet);
+	if (pb)
+		net_pktbuf_put(pb);
+	else
+		dma_free(packet);
+}
@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * tcp.c - minimal TCP client
+ *
+ * This implements just enough TCP to download files: active open only,
+ * one unacknowledged segment in flight in the send direction, a large
+ * receive window using window scaling and delayed ACKs in the receive
+ * direction. Out of order segments are dropped and answered with a
+ * duplicate ACK, so that the peer retransmits them.
+ *
+ * Like everything else in the network stack, the connection makes
+ * progress only while its user polls it in tcp_send() or tcp_recv().
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <errno.h>
+#include <kfifo.h>
+#include <malloc.h>
+#include <net.h>
+#include <stdlib.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+
+#define TCP_MSS			1460
+#define TCP_RCVBUF		(CONFIG_NET_TCP_RCVBUF * SZ_1K)
+#define TCP_RTO_INITIAL		(500 * MSECOND)
+#define TCP_RTO_MAX		(4 * SECOND)
+#define TCP_MAX_RETRIES		8
+#define TCP_DELACK_TIMEOUT	(40 * MSECOND)
+#define TCP_TIMEOUT		(30 * SECOND)
+#define TCP_CONNECT_TIMEOUT	(15 * SECOND)
+
+#define TCPOPT_EOL		0
+#define TCPOPT_NOP		1
+#define TCPOPT_MSS		2
+#define TCPOPT_WINDOW		3
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSE_WAIT,
+	TCP_LAST_ACK,
+};
+
+struct tcp_connection {
+	struct net_connection *con;
+	enum tcp_state state;
+	int err;
+
+	/* send direction */
+	uint32_t snd_una;
+	uint32_t snd_nxt;
+	uint8_t snd_wscale;
+	unsigned int mss;
+
+	/* the unacknowledged segment, kept for retransmission */
+	void *tx_buf;
+	unsigned int tx_len;
+	uint32_t tx_seq;
+	uint8_t tx_flags;
+	uint64_t rto_start;
+	uint64_t rto;
+	int retries;
+
+	/* receive direction */
+	uint32_t rcv_nxt;
+	uint32_t rcv_adv;	/* right edge of the window we advertised */
+	uint8_t rcv_wscale;
+	struct kfifo *rx;
+	unsigned int unacked;	/* segments received but not acknowledged */
+	uint64_t delack_start;
+	bool fin_received;
+};
+
+static inline bool seq_after(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) > 0;
+}
+
+static unsigned int tcp_rcv_space(struct tcp_connection *tcp)
+{
+	return tcp->rx->size - kfifo_len(tcp->rx);
+}
+
+static int tcp_xmit(struct tcp_connection *tcp, uint32_t seq, uint8_t flags,
+		    const void *data, unsigned int len)
+{
+	struct tcphdr *th = tcp->con->tcp;
+	unsigned char *opt = (unsigned char *)(th + 1);
+	unsigned int space = tcp_rcv_space(tcp);
+	int optlen = 0;
+
+	if (flags & TCP_SYN) {
+		/* window scale option, padded to a word */
+		opt[0] = TCPOPT_NOP;
+		opt[1] = TCPOPT_WINDOW;
+		opt[2] = 3;
+		opt[3] = tcp->rcv_wscale;
+		/* maximum segment size option */
+		opt[4] = TCPOPT_MSS;
+		opt[5] = 4;
+		opt[6] = TCP_MSS >> 8;
+		opt[7] = TCP_MSS & 0xff;
+		optlen = 8;
+		/* the window in a SYN is never scaled */
+		th->window = htons(min(space, 0xffffU));
+	} else {
+		th->window = htons(min(space >> tcp->rcv_wscale, 0xffffU));
+	}
+
+	th->seq = htonl(seq);
+	th->ack_seq = (flags & TCP_ACK) ? htonl(tcp->rcv_nxt) : 0;
+	th->doff = ((sizeof(*th) + optlen) / 4) << 4;
+	th->flags = flags;
+	th->urg_ptr = 0;
+
+	if (len)
+		memcpy(opt + optlen, data, len);
+
+	if (flags & TCP_ACK) {
+		tcp->rcv_adv = tcp->rcv_nxt + space;
+		tcp->unacked = 0;
+	}
+
+	return net_tcp_send(tcp->con, sizeof(*th) + optlen + len);
+}
+
+static void tcp_send_ack(struct tcp_connection *tcp)
+{
+	tcp_xmit(tcp, tcp->snd_nxt, TCP_ACK, NULL, 0);
+}
+
+/* send a segment which occupies sequence space and has to be acknowledged */
+static int tcp_send_segment(struct tcp_connection *tcp, uint8_t flags,
+			    const void *data, unsigned int len)
+{
+	if (len)
+		memcpy(tcp->tx_buf, data, len);
+	tcp->tx_len = len;
+	tcp->tx_seq = tcp->snd_nxt;
+	tcp->tx_flags = flags;
+
+	tcp->snd_nxt += len;
+	if (flags & (TCP_SYN | TCP_FIN))
+		tcp->snd_nxt++;
+
+	tcp->rto = TCP_RTO_INITIAL;
+	tcp->rto_start = get_time_ns();
+	tcp->retries = 0;
+
+	return tcp_xmit(tcp, tcp->tx_seq, flags, data, len);
+}
+
+static void tcp_parse_options(struct tcp_connection *tcp, unsigned char *opt,
+			      int len)
+{
+	bool wscale = false;
+
+	while (len > 0) {
+		if (opt[0] == TCPOPT_EOL)
+			break;
+		if (opt[0] == TCPOPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+
+		if (opt[0] == TCPOPT_MSS && opt[1] == 4)
+			tcp->mss = min_t(unsigned int, TCP_MSS,
+					 (opt[2] << 8) | opt[3]);
+
+		if (opt[0] == TCPOPT_WINDOW && opt[1] == 3) {
+			tcp->snd_wscale = min_t(uint8_t, opt[2], 14);
+			wscale = true;
+		}
+
+		len -= opt[1];
+		opt += opt[1];
+	}
+
+	/* window scaling is only used when both sides offer it */
+	if (!wscale)
+		tcp->rcv_wscale = 0;
+}
+
+static void tcp_handler(void *ctx, char *pkt, unsigned int len)
+{
+	struct tcp_connection *tcp = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(pkt);
+	struct tcphdr *th = net_eth_to_tcphdr(pkt);
+	unsigned int hlen = (th->doff >> 4) * 4;
+	uint32_t seq = ntohl(th->seq);
+	uint32_t ack = ntohl(th->ack_seq);
+	unsigned char *data = (unsigned char *)th + hlen;
+	int plen = ntohs(ip->tot_len) - sizeof(*ip) - hlen;
+	unsigned int n;
+
+	if (hlen < sizeof(*th) || plen < 0)
+		return;
+
+	if (th->flags & TCP_RST) {
+		if (tcp->state == TCP_SYN_SENT) {
+			if (!(th->flags & TCP_ACK) || ack != tcp->snd_nxt)
+				return;
+			tcp->err = -ECONNREFUSED;
+		} else {
+			if (seq != tcp->rcv_nxt)
+				return;
+			tcp->err = -ECONNRESET;
+		}
+		tcp->state = TCP_CLOSED;
+		return;
+	}
+
+	if (tcp->state == TCP_SYN_SENT) {
+		/*
+		 * An ACK for something else, e.g. from a stale connection
+		 * with the same ports still in TIME-WAIT on the peer. Reset
+		 * it so that our retransmitted SYN gets through.
+		 */
+		if ((th->flags & TCP_ACK) && ack != tcp->snd_nxt) {
+			tcp_xmit(tcp, ack, TCP_RST, NULL, 0);
+			return;
+		}
+
+		if ((th->flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK))
+			return;
+
+		tcp_parse_options(tcp, (unsigned char *)(th + 1),
+				  hlen - sizeof(*th));
+
+		tcp->rcv_nxt = seq + 1;
+		tcp->snd_una = ack;
+		tcp->state = TCP_ESTABLISHED;
+		tcp_send_ack(tcp);
+
+		return;
+	}
+
+	if (tcp->state == TCP_CLOSED)
+		return;
+
+	/* our ACK of the SYN-ACK got lost, the peer sends it again */
+	if (th->flags & TCP_SYN) {
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	if ((th->flags & TCP_ACK) && seq_after(ack, tcp->snd_una) &&
+	    !seq_after(ack, tcp->snd_nxt)) {
+		tcp->snd_una = ack;
+		if (tcp->state == TCP_LAST_ACK && ack == tcp->snd_nxt)
+			tcp->state = TCP_CLOSED;
+	}
+
+	if (!plen && !(th->flags & TCP_FIN))
+		return;
+
+	if (seq != tcp->rcv_nxt || tcp->fin_received) {
+		/* out of order or duplicate, tell the peer what we expect */
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	if (plen) {
+		n = kfifo_put(tcp->rx, data, plen);
+		tcp->rcv_nxt += n;
+
+		if (n < plen) {
+			/* more than we advertised, the rest will come again */
+			tcp_send_ack(tcp);
+			return;
+		}
+
+		if (!tcp->unacked++)
+			tcp->delack_start = get_time_ns();
+	}
+
+	if (th->flags & TCP_FIN) {
+		tcp->rcv_nxt++;
+		tcp->fin_received = true;
+		if (tcp->state == TCP_ESTABLISHED)
+			tcp->state = TCP_CLOSE_WAIT;
+	}
+
+	/* acknowledge every second segment, and the FIN immediately */
+	if (tcp->unacked >= 2 || (th->flags & TCP_FIN))
+		tcp_send_ack(tcp);
+}
+
+static void tcp_poll(struct tcp_connection *tcp)
+{
+	net_poll();
+
+	if (tcp->state == TCP_CLOSED)
+		return;
+
+	if (tcp->unacked && is_timeout(tcp->delack_start, TCP_DELACK_TIMEOUT))
+		tcp_send_ack(tcp);
+
+	if (tcp->snd_una != tcp->snd_nxt &&
+	    is_timeout(tcp->rto_start, tcp->rto)) {
+		if (++tcp->retries > TCP_MAX_RETRIES) {
+			tcp->err = -ETIMEDOUT;
+			tcp->state = TCP_CLOSED;
+			return;
+		}
+
+		pr_debug("retransmitting seq %u\n", tcp->tx_seq);
+
+		tcp->rto = min_t(uint64_t, tcp->rto * 2, TCP_RTO_MAX);
+		tcp->rto_start = get_time_ns();
+		tcp_xmit(tcp, tcp->tx_seq, tcp->tx_flags, tcp->tx_buf,
+			 tcp->tx_len);
+	}
+}
+
+static void tcp_free(struct tcp_connection *tcp)
+{
+	if (tcp->con)
+		net_unregister(tcp->con);
+	if (tcp->rx)
+		kfifo_free(tcp->rx);
+	free(tcp->tx_buf);
+	free(tcp);
+}
+
+/**
+ * tcp_connect - open a TCP connection
+ * @dest: the server's IP address
+ * @dport: the server's port
+ *
+ * Return: the connection once it is established or an ERR_PTR()
+ */
+struct tcp_connection *tcp_connect(IPaddr_t dest, uint16_t dport)
+{
+	struct tcp_connection *tcp;
+	uint64_t start;
+	uint32_t iss;
+	int ret;
+
+	tcp = xzalloc(sizeof(*tcp));
+	tcp->tx_buf = xmalloc(TCP_MSS);
+	tcp->mss = 536;	/* RFC 1122 default until the peer tells us */
+
+	tcp->rx = kfifo_alloc(TCP_RCVBUF);
+	if (!tcp->rx) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* the smallest shift which makes the whole buffer advertisable */
+	while ((tcp->rx->size >> tcp->rcv_wscale) > 0xffff)
+		tcp->rcv_wscale++;
+
+	tcp->con = net_tcp_new(dest, dport, tcp_handler, tcp);
+	if (IS_ERR(tcp->con)) {
+		ret = PTR_ERR(tcp->con);
+		tcp->con = NULL;
+		goto err;
+	}
+
+	iss = random32() ^ (uint32_t)get_time_ns();
+	tcp->snd_una = iss;
+	tcp->snd_nxt = iss;
+	tcp->state = TCP_SYN_SENT;
+
+	tcp_send_segment(tcp, TCP_SYN, NULL, 0);
+	start = get_time_ns();
+
+	while (tcp->state == TCP_SYN_SENT) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto err;
+		}
+
+		if (is_timeout(start, TCP_CONNECT_TIMEOUT)) {
+			ret = -ETIMEDOUT;
+			goto err;
+		}
+
+		tcp_poll(tcp);
+	}
+
+	if (tcp->state != TCP_ESTABLISHED) {
+		ret = tcp->err;
+		goto err;
+	}
+
+	return tcp;
+err:
+	tcp_free(tcp);
+
+	return ERR_PTR(ret);
+}
+
+/**
+ * tcp_send - send data over a TCP connection
+ * @tcp: the connection
+ * @buf: the data
+ * @len: length of the data
+ *
+ * Return: @len once all data has been acknowledged or a negative error code
+ */
+int tcp_send(struct tcp_connection *tcp, const void *buf, size_t len)
+{
+	size_t done = 0, now;
+
+	while (1) {
+		while (tcp->snd_una != tcp->snd_nxt) {
+			if (tcp->state == TCP_CLOSED)
+				return tcp->err ?: -ECONNRESET;
+			if (ctrlc())
+				return -EINTR;
+
+			tcp_poll(tcp);
+		}
+
+		if (done == len)
+			return len;
+
+		if (tcp->state != TCP_ESTABLISHED)
+			return tcp->err ?: -EPIPE;
+
+		now = min_t(size_t, len - done, tcp->mss);
+
+		tcp_send_segment(tcp, TCP_ACK | TCP_PSH, buf + done, now);
+
+		done += now;
+	}
+}
+
+/**
+ * tcp_recv - receive data from a TCP connection
+ * @tcp: the connection
+ * @buf: buffer for the data
+ * @len: size of the buffer
+ *
+ * Waits until data is available.
+ *
+ * Return: the number of bytes received, 0 when the peer closed the
+ * connection, or a negative error code
+ */
+int tcp_recv(struct tcp_connection *tcp, void *buf, size_t len)
+{
+	uint64_t start = get_time_ns();
+	unsigned int n;
+
+	while (!kfifo_len(tcp->rx)) {
+		if (tcp->fin_received)
+			return 0;
+		if (tcp->state == TCP_CLOSED)
+			return tcp->err ?: -ECONNRESET;
+		if (ctrlc())
+			return -EINTR;
+		if (is_timeout(start, TCP_TIMEOUT))
+			return -ETIMEDOUT;
+
+		tcp_poll(tcp);
+	}
+
+	n = kfifo_get(tcp->rx, buf, len);
+
+	/*
+	 * Tell the peer when the window has opened considerably since our
+	 * last ACK, it may be waiting for it.
+	 */
+	if (tcp->state == TCP_ESTABLISHED &&
+	    tcp->rcv_nxt + tcp_rcv_space(tcp) - tcp->rcv_adv >= tcp->rx->size / 2)
+		tcp_send_ack(tcp);
+
+	return n;
+}
+
+/**
+ * tcp_close - close a TCP connection and free it
+ * @tcp: the connection
+ *
+ * A connection the peer has not finished sending on yet is reset.
+ */
+void tcp_close(struct tcp_connection *tcp)
+{
+	uint64_t start;
+
+	switch (tcp->state) {
+	case TCP_ESTABLISHED:
+		tcp_xmit(tcp, tcp->snd_nxt, TCP_RST | TCP_ACK, NULL, 0);
+		break;
+	case TCP_CLOSE_WAIT:
+		tcp_send_segment(tcp, TCP_FIN | TCP_ACK, NULL, 0);
+		tcp->state = TCP_LAST_ACK;
+
+		start = get_time_ns();
+		while (tcp->state == TCP_LAST_ACK &&
+		       !is_timeout(start, 2 * SECOND))
+			tcp_poll(tcp);
+		break;
+	default:
+		break;
+	}
+
+	tcp_free(tcp);
+}
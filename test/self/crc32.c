@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <crc.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+BSELFTEST_GLOBALS();
+
+#define CRC32_TEST_SIZE	4096
+
+static void __expect(uint32_t got, uint32_t expect, const char *impl,
+		     unsigned int offset, unsigned int len)
+{
+	total_tests++;
+
+	if (got != expect) {
+		failed_tests++;
+		printf("%s: offset %u len %u: got 0x%08x, expected 0x%08x\n",
+		       impl, offset, len, got, expect);
+	}
+}
+
+static void test_crc32_variants(const u8 *buf, unsigned int offset,
+				unsigned int len)
+{
+	uint32_t seed = offset * 0x01010101;
+	uint32_t expect = crc32_le_bytewise(seed, buf + offset, len);
+
+	if (IS_ENABLED(CONFIG_CRC32_SLICEBY8))
+		__expect(crc32_le_sliceby8(seed, buf + offset, len), expect,
+			 "slicing-by-8", offset, len);
+
+	if (IS_ENABLED(CONFIG_HAVE_ARCH_CRC32) && arch_crc32_le_supported())
+		__expect(arch_crc32_le(seed, buf + offset, len), expect,
+			 "arch", offset, len);
+
+	__expect(crc32_no_comp(seed, buf + offset, len), expect,
+		 "crc32_no_comp", offset, len);
+}
+
+static void test_crc32(void)
+{
+	unsigned int offset, len, split;
+	u8 *buf;
+
+	/* the standard check value for CRC-32 */
+	__expect(crc32(0, "123456789", 9), 0xcbf43926, "crc32", 0, 9);
+
+	if (!IS_ENABLED(CONFIG_CRC32_SLICEBY8))
+		skipped_tests++;
+	if (!IS_ENABLED(CONFIG_HAVE_ARCH_CRC32) || !arch_crc32_le_supported())
+		skipped_tests++;
+
+	buf = malloc(CRC32_TEST_SIZE);
+	if (!buf) {
+		failed_tests++;
+		return;
+	}
+
+	srand(0x12345678);
+	for (len = 0; len < CRC32_TEST_SIZE; len++)
+		buf[len] = rand();
+
+	/* all alignments with short and odd lengths */
+	for (offset = 0; offset < 8; offset++)
+		for (len = 0; len <= 64; len++)
+			test_crc32_variants(buf, offset, len);
+
+	for (offset = 0; offset < 8; offset++)
+		test_crc32_variants(buf, offset, CRC32_TEST_SIZE - 8);
+
+	/* calculating the crc in pieces must give the same result */
+	for (split = 1; split < 16; split++) {
+		uint32_t crc = crc32(0, buf, split);
+
+		crc = crc32(crc, buf + split, CRC32_TEST_SIZE - split);
+		__expect(crc, crc32(0, buf, CRC32_TEST_SIZE), "crc32 split",
+			 split, CRC32_TEST_SIZE);
+	}
+
+	free(buf);
+}
+bselftest(core, test_crc32);
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <bselftest.h>
+#include <driver.h>
+#include <image-fit.h>
+#include <malloc.h>
+#include <of.h>
+
+BSELFTEST_GLOBALS();
+
+#define FIT_TEST_DATA_SIZE	4096
+
+/*
+ * The FIT is served from a device without memmap support, so fit_open()
+ * has to read its structure instead of using it in place.
+ */
+static ssize_t fit_test_read(struct cdev *cdev, void *buf, size_t count,
+			     loff_t offset, ulong flags)
+{
+	if (offset >= cdev->size)
+		return 0;
+
+	count = min_t(size_t, count, cdev->size - offset);
+	memcpy(buf, cdev->priv + offset, count);
+
+	return count;
+}
+
+static struct cdev_operations fit_test_ops = {
+	.read = fit_test_read,
+};
+
+static void expect_image(struct fit_handle *handle, void *conf,
+			 const char *name, const void *expect, size_t len)
+{
+	const void *data;
+	unsigned long size;
+	int ret;
+
+	total_tests++;
+
+	ret = fit_open_image(handle, conf, name, &data, &size);
+	if (ret) {
+		failed_tests++;
+		printf("%s: cannot open: %pe\n", name, ERR_PTR(ret));
+		return;
+	}
+
+	if (size != len || memcmp(data, expect, len)) {
+		failed_tests++;
+		printf("%s: data mismatch, size %lu, expected %zu\n",
+		       name, size, len);
+	}
+}
+
+static void __init test_fit_external(void)
+{
+	extern char __dtb_fit_start[], __dtb_fit_end[];
+	static const u8 fdt_data[] = { 0xde, 0xad, 0xbe, 0xef };
+	size_t dtb_size = __dtb_fit_end - __dtb_fit_start;
+	size_t data_base = ALIGN(dtb_size, 4);
+	struct cdev cdev = {
+		.name = "selftest-fit",
+		.ops = &fit_test_ops,
+	};
+	struct fit_handle *handle;
+	void *conf;
+	u8 *image;
+	int i, ret;
+
+	image = calloc(data_base + FIT_TEST_DATA_SIZE, 1);
+	if (WARN_ON(!image))
+		return;
+
+	memcpy(image, __dtb_fit_start, dtb_size);
+	for (i = 0; i < FIT_TEST_DATA_SIZE; i++)
+		image[data_base + i] = i * 7;
+
+	cdev.priv = image;
+	cdev.size = data_base + FIT_TEST_DATA_SIZE;
+
+	ret = devfs_create(&cdev);
+	if (WARN_ON(ret))
+		goto out;
+
+	total_tests++;
+
+	handle = fit_open("/dev/selftest-fit", false, BOOTM_VERIFY_NONE);
+	if (IS_ERR(handle)) {
+		failed_tests++;
+		printf("cannot open FIT: %pe\n", handle);
+		goto out_remove;
+	}
+
+	conf = fit_open_configuration(handle, "conf");
+	if (IS_ERR(conf)) {
+		total_tests++;
+		failed_tests++;
+		printf("cannot open configuration: %pe\n", conf);
+	} else {
+		expect_image(handle, conf, "kernel", image + data_base,
+			     FIT_TEST_DATA_SIZE);
+		expect_image(handle, conf, "fdt", fdt_data, sizeof(fdt_data));
+	}
+
+	fit_close(handle);
+out_remove:
+	devfs_remove(&cdev);
+out:
+	free(image);
+}
+bselftest(core, test_fit_external);